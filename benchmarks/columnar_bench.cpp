@@ -0,0 +1,194 @@
+// Size and scan speed of columnar segments against NDJSON records.
+// Usage: columnar_bench [records] [directory]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include "traffic_processor/columnar.hpp"
+#include "traffic_processor/record_view.hpp"
+
+using namespace traffic_processor;
+
+static std::vector<std::string> buildRecords(size_t count, std::mt19937_64 &rng)
+{
+    static const char *methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+    static const char *hosts[] = {"api.example.com", "shop.example.com", "auth.example.com"};
+    static const char *routes[] = {"/users/{id}", "/orders/{id}/items", "/cart", "/login", "/products/{id}"};
+    static const int statuses[] = {200, 200, 200, 200, 201, 204, 304, 404, 500};
+
+    std::vector<std::string> records;
+    records.reserve(count);
+    int64_t ts = 1760000000;
+    for (size_t i = 0; i < count; ++i)
+    {
+        ts += static_cast<int64_t>(rng() % 2);
+        std::string route = routes[rng() % 5];
+        std::string path = route;
+        size_t brace = path.find("{id}");
+        if (brace != std::string::npos)
+            path.replace(brace, 4, std::to_string(rng() % 100000));
+        nlohmann::json req = {
+            {"method", methods[rng() % 6]},
+            {"scheme", "https"},
+            {"host", hosts[rng() % 3]},
+            {"path", path},
+            {"query", rng() % 4 == 0 ? "page=" + std::to_string(rng() % 20) : ""},
+            {"route_template", route},
+            {"headers", {{"user-agent", "bench/1.0"}, {"accept", "application/json"}}},
+            {"body", ""},
+            {"ip", "10.0." + std::to_string(rng() % 4) + "." + std::to_string(rng() % 250)},
+        };
+        nlohmann::json res = {
+            {"status", statuses[rng() % 9]},
+            {"headers", {{"content-type", "application/json"}}},
+            {"body", "{\"id\":" + std::to_string(rng() % 100000) + ",\"ok\":true}"},
+        };
+        records.push_back(nlohmann::json{{"account_id", "acct-bench"},
+                                         {"timestamp", ts},
+                                         {"request", std::move(req)},
+                                         {"response", std::move(res)},
+                                         {"latency_ms", static_cast<int>(rng() % 250)}}
+                              .dump());
+    }
+    return records;
+}
+
+static size_t fileSize(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return in ? static_cast<size_t>(in.tellg()) : 0;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static size_t writeSegment(const std::vector<std::string> &records, const std::string &path, ColumnCompression compression)
+{
+    ColumnarConfig cfg;
+    cfg.path = path;
+    cfg.compression = compression;
+    ColumnarWriter writer(cfg);
+    RecordView view;
+    for (const auto &r : records)
+    {
+        view.reset(r);
+        writer.append(view);
+    }
+    writer.close();
+    return fileSize(path);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500000;
+    std::string dir = argc > 2 ? argv[2] : ".";
+
+    std::mt19937_64 rng(42);
+    auto records = buildRecords(count, rng);
+
+    std::string ndjsonPath = dir + "/columnar_bench.ndjson";
+    {
+        std::ofstream out(ndjsonPath, std::ios::binary | std::ios::trunc);
+        for (const auto &r : records)
+            out << r << '\n';
+    }
+    std::string rawPath = dir + "/columnar_bench_raw.tpcol";
+    std::string zlibPath = dir + "/columnar_bench_zlib.tpcol";
+
+    std::cout << "=== Columnar segments (" << count << " records) ===" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    size_t rawSize = writeSegment(records, rawPath, ColumnCompression::None);
+    double rawWrite = seconds(start);
+    start = std::chrono::steady_clock::now();
+    size_t zlibSize = writeSegment(records, zlibPath, ColumnCompression::Zlib);
+    double zlibWrite = seconds(start);
+
+    size_t ndjsonSize = fileSize(ndjsonPath);
+    std::cout << "ndjson:             " << ndjsonSize << " bytes" << std::endl;
+    std::cout << "columnar, encoded:  " << rawSize << " bytes (" << static_cast<double>(ndjsonSize) / rawSize
+              << "x), written in " << rawWrite << " s" << std::endl;
+    std::cout << "columnar, zlib:     " << zlibSize << " bytes (" << static_cast<double>(ndjsonSize) / zlibSize
+              << "x), written in " << zlibWrite << " s" << std::endl;
+
+    // Scan: mean latency of 5xx responses
+    auto report = [&](const char *label, double secs, double sum, uint64_t n)
+    {
+        std::cout << label << secs * 1000 << " ms (" << count / secs / 1e6 << " M rec/s, mean 5xx latency "
+                  << (n ? sum / n : 0) << ")" << std::endl;
+    };
+
+    start = std::chrono::steady_clock::now();
+    {
+        std::ifstream in(ndjsonPath, std::ios::binary);
+        std::string line;
+        double sum = 0;
+        uint64_t n = 0;
+        while (std::getline(in, line))
+        {
+            auto j = nlohmann::json::parse(line);
+            if (j["response"]["status"].get<int>() >= 500)
+            {
+                sum += j.value("latency_ms", 0);
+                ++n;
+            }
+        }
+        report("scan ndjson, parsed:      ", seconds(start), sum, n);
+    }
+
+    start = std::chrono::steady_clock::now();
+    {
+        std::ifstream in(ndjsonPath, std::ios::binary);
+        std::string line;
+        RecordView view;
+        double sum = 0;
+        uint64_t n = 0;
+        while (std::getline(in, line))
+        {
+            view.reset(line);
+            if (view.response().status() >= 500)
+            {
+                sum += static_cast<double>(view.latencyMs());
+                ++n;
+            }
+        }
+        report("scan ndjson, RecordView:  ", seconds(start), sum, n);
+    }
+
+    for (const auto &[label, path] : {std::pair<const char *, std::string>{"scan columnar, encoded:   ", rawPath},
+                                      std::pair<const char *, std::string>{"scan columnar, zlib:      ", zlibPath}})
+    {
+        start = std::chrono::steady_clock::now();
+        ColumnarReader reader(path);
+        std::vector<ColumnarRow> rows;
+        double sum = 0;
+        uint64_t n = 0;
+        for (size_t g = 0; g < reader.rowGroups(); ++g)
+        {
+            rows.clear();
+            reader.read(g, {Column::Status, Column::LatencyMs}, rows);
+            for (const auto &r : rows)
+            {
+                if (r.status >= 500)
+                {
+                    sum += static_cast<double>(r.latencyMs);
+                    ++n;
+                }
+            }
+        }
+        report(label, seconds(start), sum, n);
+    }
+
+    std::remove(ndjsonPath.c_str());
+    std::remove(rawPath.c_str());
+    std::remove(zlibPath.c_str());
+    return 0;
+}
@@ -0,0 +1,375 @@
+// End-to-end throughput of the echo demo against librdkafka's mock cluster.
+// The server runs in-process twice, without and with the traffic middleware,
+// driven by a built-in keep-alive HTTP load client; no Docker or Kafka needed.
+// Broker round-trip time and produce errors can be injected to measure
+// backpressure. Usage: e2e_bench [--option=value ...], see --help.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <librdkafka/rdkafka.h>
+#include <librdkafka/rdkafka_mock.h>
+
+#include "echo_app.hpp"
+
+using namespace traffic_processor;
+
+struct Options
+{
+    int seconds{10};      // measured window per phase
+    int warmupSeconds{1}; // served but not measured
+    int connections{32};  // load client threads, one keep-alive connection each
+    int serverThreads{static_cast<int>(std::max(2u, std::thread::hardware_concurrency()))};
+    size_t bodyBytes{512};
+    int port{18080};
+    int brokers{3};
+    int partitions{6};
+    int rttMs{0};             // injected broker round-trip time
+    double errorsPerSec{0.0}; // produce requests failed on purpose
+    int errorCode{RD_KAFKA_RESP_ERR_REQUEST_TIMED_OUT};
+    int drainMs{5000}; // shutdown deadline after the capture phase
+    bool baseline{true};
+};
+
+static bool parseOptions(int argc, char **argv, Options &o)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        try
+        {
+            if (key == "--seconds")
+                o.seconds = std::stoi(value);
+            else if (key == "--warmup")
+                o.warmupSeconds = std::stoi(value);
+            else if (key == "--connections")
+                o.connections = std::stoi(value);
+            else if (key == "--server-threads")
+                o.serverThreads = std::stoi(value);
+            else if (key == "--body-bytes")
+                o.bodyBytes = std::stoul(value);
+            else if (key == "--port")
+                o.port = std::stoi(value);
+            else if (key == "--brokers")
+                o.brokers = std::stoi(value);
+            else if (key == "--partitions")
+                o.partitions = std::stoi(value);
+            else if (key == "--rtt-ms")
+                o.rttMs = std::stoi(value);
+            else if (key == "--errors-per-sec")
+                o.errorsPerSec = std::stod(value);
+            else if (key == "--error-code")
+                o.errorCode = std::stoi(value);
+            else if (key == "--drain-ms")
+                o.drainMs = std::stoi(value);
+            else if (key == "--no-baseline")
+                o.baseline = false;
+            else
+                return false;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+    return o.seconds > 0 && o.connections > 0 && o.brokers > 0 && o.partitions > 0;
+}
+
+static void usage()
+{
+    std::cout << "Usage: e2e_bench [--seconds=10] [--warmup=1] [--connections=32] [--server-threads=N]\n"
+                 "                 [--body-bytes=512] [--port=18080] [--brokers=3] [--partitions=6]\n"
+                 "                 [--rtt-ms=0] [--errors-per-sec=0] [--error-code=7] [--drain-ms=5000]\n"
+                 "                 [--no-baseline]\n"
+                 "SdkConfig comes from the demo's environment variables (KAFKA_BATCH_TIMEOUT, ...);\n"
+                 "the bootstrap servers always point at the mock cluster.\n";
+}
+
+// ---------------------------------------------------------------- load client
+
+struct PhaseResult
+{
+    uint64_t served{0};   // responses received, warmup included
+    uint64_t measured{0}; // responses received in the measured window
+    uint64_t errors{0};   // failed round trips and non-200 responses
+    std::vector<uint32_t> latenciesUs;
+    double seconds{0};
+    double cpuSeconds{0}; // whole process, measured window
+};
+
+static double cpuSeconds()
+{
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+           static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static int connectLocal(int port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// One request and its response on a keep-alive connection; true on 200
+static bool roundTrip(int fd, const std::string &request, std::string &buf)
+{
+    for (size_t sent = 0; sent < request.size();)
+    {
+        ssize_t n = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += static_cast<size_t>(n);
+    }
+
+    buf.clear();
+    size_t headerEnd = std::string::npos;
+    size_t total = 0;
+    char chunk[16384];
+    while (headerEnd == std::string::npos || buf.size() < total)
+    {
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buf.append(chunk, static_cast<size_t>(n));
+        if (headerEnd == std::string::npos && (headerEnd = buf.find("\r\n\r\n")) != std::string::npos)
+        {
+            size_t length = 0;
+            for (size_t pos = buf.find("\r\n"); pos < headerEnd; pos = buf.find("\r\n", pos + 2))
+            {
+                static const char name[] = "content-length:";
+                if (strncasecmp(buf.c_str() + pos + 2, name, sizeof(name) - 1) == 0)
+                    length = std::strtoul(buf.c_str() + pos + 2 + sizeof(name) - 1, nullptr, 10);
+            }
+            total = headerEnd + 4 + length;
+        }
+    }
+    return buf.compare(0, 12, "HTTP/1.1 200") == 0;
+}
+
+// Closed loop: every connection sends its next request once the previous
+// response arrived, so latency and throughput are measured together
+static PhaseResult runLoad(const Options &o)
+{
+    std::string body = "{\"payload\":\"" + std::string(o.bodyBytes, 'x') + "\"}";
+    std::string request = "POST /echo HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\nContent-Length: " +
+                          std::to_string(body.size()) + "\r\n\r\n" + body;
+
+    std::atomic<bool> measuring{false};
+    std::atomic<bool> stop{false};
+    std::vector<PhaseResult> perThread(static_cast<size_t>(o.connections));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < o.connections; ++t)
+    {
+        threads.emplace_back([&, t]
+                             {
+            PhaseResult &r = perThread[static_cast<size_t>(t)];
+            r.latenciesUs.reserve(1 << 16);
+            std::string buf;
+            int fd = connectLocal(o.port);
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (fd < 0)
+                {
+                    ++r.errors;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    fd = connectLocal(o.port);
+                    continue;
+                }
+                bool inWindow = measuring.load(std::memory_order_relaxed);
+                auto start = std::chrono::steady_clock::now();
+                bool ok = roundTrip(fd, request, buf);
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+                if (!ok)
+                {
+                    ++r.errors;
+                    ::close(fd);
+                    fd = connectLocal(o.port);
+                    continue;
+                }
+                ++r.served;
+                if (inWindow && measuring.load(std::memory_order_relaxed))
+                {
+                    ++r.measured;
+                    r.latenciesUs.push_back(static_cast<uint32_t>(us));
+                }
+            }
+            if (fd >= 0)
+                ::close(fd); });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(o.warmupSeconds));
+    double cpuStart = cpuSeconds();
+    auto start = std::chrono::steady_clock::now();
+    measuring.store(true);
+    std::this_thread::sleep_for(std::chrono::seconds(o.seconds));
+    measuring.store(false);
+    PhaseResult total;
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    total.cpuSeconds = cpuSeconds() - cpuStart;
+    stop.store(true);
+    for (auto &th : threads)
+        th.join();
+
+    for (auto &r : perThread)
+    {
+        total.served += r.served;
+        total.measured += r.measured;
+        total.errors += r.errors;
+        total.latenciesUs.insert(total.latenciesUs.end(), r.latenciesUs.begin(), r.latenciesUs.end());
+    }
+    std::sort(total.latenciesUs.begin(), total.latenciesUs.end());
+    return total;
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double q)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())))];
+}
+
+static void report(const char *label, const PhaseResult &r)
+{
+    std::cout << label << r.measured / r.seconds << " req/s, p50 " << percentile(r.latenciesUs, 0.50)
+              << " us, p99 " << percentile(r.latenciesUs, 0.99) << " us, p999 " << percentile(r.latenciesUs, 0.999)
+              << " us, " << (r.measured ? r.cpuSeconds / r.measured * 1e6 : 0) << " cpu-us/req, " << r.errors
+              << " errors" << std::endl;
+}
+
+// Starts the app, drives it for one phase and stops it
+template <typename App>
+static PhaseResult servePhase(App &app, const Options &o, int port)
+{
+    Options phase = o;
+    phase.port = port;
+    app.loglevel(crow::LogLevel::Warning);
+    auto server = app.bindaddr("127.0.0.1").port(static_cast<uint16_t>(port)).concurrency(static_cast<uint16_t>(o.serverThreads)).run_async();
+    app.wait_for_server_start();
+    PhaseResult r = runLoad(phase);
+    app.stop();
+    server.get();
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    Options o;
+    if (!parseOptions(argc, argv, o))
+    {
+        usage();
+        return 1;
+    }
+
+    char errstr[512];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    if (!admin)
+    {
+        std::cerr << "Failed to create mock cluster handle: " << errstr << std::endl;
+        return 1;
+    }
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, o.brokers);
+
+    SdkConfig cfg = echo_demo::buildConfigFromEnv();
+    cfg.kafka.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cfg.shutdownTimeoutMs = o.drainMs;
+    rd_kafka_mock_topic_create(cluster, cfg.kafka.topic.c_str(), o.partitions, std::min(o.brokers, 3));
+    for (int broker = 1; broker <= o.brokers; ++broker)
+        rd_kafka_mock_broker_set_rtt(cluster, broker, o.rttMs);
+
+    std::cout << "=== End-to-end echo server (" << o.connections << " connections, " << o.serverThreads
+              << " server threads, " << o.bodyBytes << " B bodies, " << o.seconds << " s) ===" << std::endl;
+    std::cout << "mock cluster: " << o.brokers << " brokers, " << o.partitions << " partitions, rtt " << o.rttMs
+              << " ms, " << o.errorsPerSec << " produce errors/s (code " << o.errorCode << ")" << std::endl;
+
+    PhaseResult baseline;
+    if (o.baseline)
+    {
+        crow::SimpleApp plain;
+        echo_demo::registerEchoRoutes(plain);
+        baseline = servePhase(plain, o, o.port);
+        report("without capture:  ", baseline);
+    }
+
+    TrafficProcessorSdk &sdk = TrafficProcessorSdk::instance();
+    sdk.initialize(cfg);
+
+    // Each injected error fails one produce request, i.e. a whole batch
+    std::atomic<bool> injecting{o.errorsPerSec > 0};
+    std::thread injector([&]
+                         {
+        auto interval = std::chrono::duration<double>(o.errorsPerSec > 0 ? 1.0 / o.errorsPerSec : 0);
+        auto next = std::chrono::steady_clock::now();
+        while (injecting.load())
+        {
+            rd_kafka_mock_push_request_errors(cluster, 0 /* ApiKey Produce */, 1, static_cast<rd_kafka_resp_err_t>(o.errorCode));
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+            std::this_thread::sleep_until(next);
+        } });
+
+    auto captureStart = std::chrono::steady_clock::now();
+    PhaseResult captured;
+    {
+        crow_integration::TrafficApp app;
+        echo_demo::registerEchoRoutes(app);
+        captured = servePhase(app, o, o.port + 1);
+    }
+    injecting.store(false);
+    injector.join();
+    ShutdownReport shutdown = sdk.shutdown();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - captureStart).count();
+    report("with capture:     ", captured);
+
+    uint64_t accounted = shutdown.delivered + shutdown.spilled + shutdown.dropped;
+    std::cout << "records:          " << captured.served << " captured, " << shutdown.delivered << " delivered, "
+              << shutdown.spilled << " spilled, " << shutdown.dropped << " dropped";
+    if (captured.served > accounted)
+        std::cout << ", " << captured.served - accounted << " unaccounted";
+    std::cout << std::endl;
+    std::cout << "sustained:        " << shutdown.delivered / wall << " delivered records/s (drain "
+              << shutdown.elapsed.count() << " ms" << (shutdown.deadlineExceeded ? ", deadline exceeded" : "") << ")"
+              << std::endl;
+    if (o.baseline && baseline.measured && captured.measured)
+    {
+        // Process CPU includes the load client in both phases, so the share
+        // is a lower bound on what the SDK adds to the server alone
+        double base = baseline.cpuSeconds / baseline.measured;
+        double with = captured.cpuSeconds / captured.measured;
+        std::cout << "SDK CPU share:    " << std::max(0.0, (with - base) / with) * 100 << " % of process CPU per request"
+                  << std::endl;
+    }
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+    return 0;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+// Configuration and routes of the echo demo, shared by main.cpp and the
+// end-to-end benchmark (benchmarks/e2e_bench.cpp)
+
+#include <crow.h>
+#include <nlohmann/json.hpp>
+
+#include "traffic_processor/sdk.hpp"
+#include "traffic_processor/crow_middleware.hpp"
+
+#include <cstdlib>
+#include <string>
+
+namespace echo_demo
+{
+    using namespace traffic_processor;
+
+    inline SdkConfig buildConfigFromEnv()
+    {
+        SdkConfig cfg;
+
+        if (const char *url = std::getenv("KAFKA_URL"))
+        {
+            cfg.kafka.bootstrapServers = url;
+        }
+        if (const char *topic = std::getenv("KAFKA_TOPIC"))
+        {
+            cfg.kafka.topic = topic;
+        }
+        if (const char *comp = std::getenv("KAFKA_COMPRESSION"))
+        {
+            cfg.kafka.compression = comp;
+        }
+        if (const char *acks = std::getenv("KAFKA_ACKS"))
+        {
+            cfg.kafka.acks = acks;
+        }
+
+        if (const char *linger = std::getenv("KAFKA_BATCH_TIMEOUT"))
+        {
+            try
+            {
+                cfg.kafka.lingerMs = std::stoi(linger);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *bnm = std::getenv("KAFKA_BATCH_SIZE"))
+        {
+            try
+            {
+                cfg.kafka.batchNumMessages = std::stoi(bnm);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *bs = std::getenv("KAFKA_BATCH_SIZE_BYTES"))
+        {
+            try
+            {
+                cfg.kafka.batchSizeBytes = std::stoi(bs);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *rq = std::getenv("KAFKA_REQUEST_TIMEOUT_MS"))
+        {
+            try
+            {
+                cfg.kafka.requestTimeoutMs = std::stoi(rq);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *rb = std::getenv("KAFKA_BUFFER_MAX_MESSAGES"))
+        {
+            try
+            {
+                cfg.kafka.queueBufferingMaxMessages = std::stoi(rb);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *rk = std::getenv("KAFKA_BUFFER_MAX_KBYTES"))
+        {
+            try
+            {
+                cfg.kafka.queueBufferingMaxKbytes = std::stoi(rk);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        if (const char *adaptive = std::getenv("TRAFFIC_ADAPTIVE_BATCHING"))
+        {
+            cfg.adaptiveBatching.enabled = std::string(adaptive) == "true";
+        }
+        if (const char *slo = std::getenv("TRAFFIC_LATENCY_SLO_MS"))
+        {
+            try
+            {
+                cfg.adaptiveBatching.latencySloMs = std::stoi(slo);
+            }
+            catch (...)
+            {
+            }
+        }
+        if (const char *analytics = std::getenv("TRAFFIC_ANALYTICS"))
+        {
+            cfg.analytics.enabled = std::string(analytics) == "true";
+        }
+        if (const char *columnar = std::getenv("TRAFFIC_COLUMNAR_PATH"))
+        {
+            cfg.columnar.path = columnar;
+        }
+        if (const char *dedup = std::getenv("TRAFFIC_BODY_DEDUP"))
+        {
+            cfg.bodyDedup.enabled = std::string(dedup) == "true";
+        }
+        if (const char *topic = std::getenv("TRAFFIC_BODY_TOPIC"))
+        {
+            cfg.bodyDedup.topic = topic;
+        }
+        if (const char *split = std::getenv("TRAFFIC_SPLIT_BODIES"))
+        {
+            cfg.routing.splitBodies = std::string(split) == "true";
+        }
+        if (const char *payloads = std::getenv("TRAFFIC_PAYLOAD_TOPIC"))
+        {
+            cfg.routing.bodyTopic = payloads;
+        }
+        if (const char *errors = std::getenv("TRAFFIC_ERROR_TOPIC"))
+        {
+            TopicRule rule;
+            rule.topic = errors;
+            rule.minStatus = 500;
+            cfg.routing.rules.push_back(rule);
+        }
+        if (const char *path = std::getenv("TRAFFIC_RUNTIME_CONFIG"))
+        {
+            cfg.runtimeConfigPath = path;
+        }
+        if (const char *spill = std::getenv("TRAFFIC_SPILL_PATH"))
+        {
+            cfg.spillPath = spill;
+        }
+        if (const char *timeout = std::getenv("TRAFFIC_SHUTDOWN_TIMEOUT_MS"))
+        {
+            try
+            {
+                cfg.shutdownTimeoutMs = std::stoi(timeout);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        return cfg;
+    }
+
+    // /echo and the catch-all 404; App is any crow::App, with or without
+    // the traffic middleware
+    template <typename App>
+    void registerEchoRoutes(App &app)
+    {
+        // Main echo route - supports GET and POST only
+        TRAFFIC_CROW_ROUTE(app, "/echo").methods(crow::HTTPMethod::GET, crow::HTTPMethod::POST)([](const crow::request &req)
+                                                                                                        {
+            crow::response resp;
+            nlohmann::json j;
+            j["method"] = crow::method_name(req.method);
+            j["body"] = req.body;
+            j["url"] = req.url;
+            resp.set_header("content-type", "application/json");
+            resp.code = 200;
+            resp.body = j.dump();
+            return resp; });
+
+        // Catch-all route for unsupported methods on /echo
+        TRAFFIC_CROW_ROUTE(app, "/echo").methods(crow::HTTPMethod::PUT, crow::HTTPMethod::DELETE, crow::HTTPMethod::PATCH, crow::HTTPMethod::HEAD, crow::HTTPMethod::OPTIONS)([](const crow::request &req)
+                                                                                                                                                                                      {
+            crow::response resp;
+            resp.code = 405;
+            resp.set_header("content-type", "application/json");
+            resp.body = "{\"error\":\"Method Not Allowed\",\"message\":\"Only GET and POST are supported on /echo\"}";
+            return resp; });
+
+        // Catch-all route for any other path (404 errors).
+        // Left unregistered so unknown paths get heuristic route templates.
+        CROW_ROUTE(app, "/<path>")([](const crow::request &req, const std::string &path)
+                                                   {
+            crow::response resp;
+            resp.code = 404;
+            resp.set_header("content-type", "application/json");
+            resp.body = "{\"error\":\"Not Found\",\"path\":\"/" + path + "\",\"message\":\"Endpoint not found\"}";
+            return resp; });
+    }
+
+} // namespace echo_demo
@@ -1,8 +1,4 @@
-#include <crow.h>
-#include <nlohmann/json.hpp>
-
-#include "traffic_processor/sdk.hpp"
-#include "traffic_processor/crow_middleware.hpp"
+#include "echo_app.hpp"
 
 #include <chrono>
 #include <iostream>
@@ -10,91 +6,6 @@
 
 using namespace traffic_processor;
 
-static SdkConfig buildConfigFromEnv()
-{
-    SdkConfig cfg;
-
-    if (const char *url = std::getenv("KAFKA_URL"))
-    {
-        cfg.kafka.bootstrapServers = url;
-    }
-    if (const char *topic = std::getenv("KAFKA_TOPIC"))
-    {
-        cfg.kafka.topic = topic;
-    }
-    if (const char *comp = std::getenv("KAFKA_COMPRESSION"))
-    {
-        cfg.kafka.compression = comp;
-    }
-    if (const char *acks = std::getenv("KAFKA_ACKS"))
-    {
-        cfg.kafka.acks = acks;
-    }
-
-    if (const char *linger = std::getenv("KAFKA_BATCH_TIMEOUT"))
-    {
-        try
-        {
-            cfg.kafka.lingerMs = std::stoi(linger);
-        }
-        catch (...)
-        {
-        }
-    }
-    if (const char *bnm = std::getenv("KAFKA_BATCH_SIZE"))
-    {
-        try
-        {
-            cfg.kafka.batchNumMessages = std::stoi(bnm);
-        }
-        catch (...)
-        {
-        }
-    }
-    if (const char *bs = std::getenv("KAFKA_BATCH_SIZE_BYTES"))
-    {
-        try
-        {
-            cfg.kafka.batchSizeBytes = std::stoi(bs);
-        }
-        catch (...)
-        {
-        }
-    }
-    if (const char *rq = std::getenv("KAFKA_REQUEST_TIMEOUT_MS"))
-    {
-        try
-        {
-            cfg.kafka.requestTimeoutMs = std::stoi(rq);
-        }
-        catch (...)
-        {
-        }
-    }
-    if (const char *rb = std::getenv("KAFKA_BUFFER_MAX_MESSAGES"))
-    {
-        try
-        {
-            cfg.kafka.queueBufferingMaxMessages = std::stoi(rb);
-        }
-        catch (...)
-        {
-        }
-    }
-    if (const char *rk = std::getenv("KAFKA_BUFFER_MAX_KBYTES"))
-    {
-        try
-        {
-            cfg.kafka.queueBufferingMaxKbytes = std::stoi(rk);
-        }
-        catch (...)
-        {
-        }
-    }
-
-    return cfg;
-}
-
 // removed: local maybe_base64; provided by reusable middleware header
 
 int main(int argc, char **argv)
@@ -104,42 +15,79 @@ int main(int argc, char **argv)
 
     std::cout << "Starting Traffic Processor SDK Demo Server..." << std::endl;
     // Build a single object with all parameters (object-based config)
-    SdkConfig cfg = buildConfigFromEnv();
+    SdkConfig cfg = echo_demo::buildConfigFromEnv();
     TrafficProcessorSdk::instance().initialize(cfg);
     std::cout << "SDK initialized successfully" << std::endl;
 
     traffic_processor::crow_integration::TrafficApp app_with_middleware;
-
-    // Main echo route - supports GET and POST only
-    CROW_ROUTE(app_with_middleware, "/echo").methods(crow::HTTPMethod::GET, crow::HTTPMethod::POST)([](const crow::request &req)
-                                                                                                    {
-        crow::response resp;
-        nlohmann::json j;
-        j["method"] = crow::method_name(req.method);
-        j["body"] = req.body;
-        j["url"] = req.url;
-        resp.set_header("content-type", "application/json");
-        resp.code = 200;
-        resp.body = j.dump();
-        return resp; });
-
-    // Catch-all route for unsupported methods on /echo
-    CROW_ROUTE(app_with_middleware, "/echo").methods(crow::HTTPMethod::PUT, crow::HTTPMethod::DELETE, crow::HTTPMethod::PATCH, crow::HTTPMethod::HEAD, crow::HTTPMethod::OPTIONS)([](const crow::request &req)
-                                                                                                                                                                                  {
-        crow::response resp;
-        resp.code = 405;
-        resp.set_header("content-type", "application/json");
-        resp.body = "{\"error\":\"Method Not Allowed\",\"message\":\"Only GET and POST are supported on /echo\"}";
-        return resp; });
-
-    // Catch-all route for any other path (404 errors)
-    CROW_ROUTE(app_with_middleware, "/<path>")([](const crow::request &req, const std::string &path)
-                                               {
-        crow::response resp;
-        resp.code = 404;
-        resp.set_header("content-type", "application/json");
-        resp.body = "{\"error\":\"Not Found\",\"path\":\"/" + path + "\",\"message\":\"Endpoint not found\"}";
-        return resp; });
+    // /audit captures its own record below; the middleware would add a second
+    app_with_middleware.get_middleware<crow_integration::TrafficMiddleware>().sdk_for =
+        [](const crow::request &req) -> TrafficProcessorSdk *
+    { return req.url == "/audit" ? nullptr : &TrafficProcessorSdk::instance(); };
+
+    echo_demo::registerEchoRoutes(app_with_middleware);
+
+    // Confirmed capture: answers only once the audit record is in Kafka,
+    // without holding a worker thread while waiting
+    CROW_ROUTE(app_with_middleware, "/audit").methods(crow::HTTPMethod::POST)([](const crow::request &req, crow::response &res)
+                                                                               {
+        RequestData r;
+        r.method = "POST";
+        r.path = req.url;
+        r.bodyText = req.body;
+        r.ip = req.remote_ip_address;
+        ResponseData s;
+        s.status = 202;
+        res.code = 202;
+        res.set_header("content-type", "application/json");
+        res.body = "{\"status\":\"recorded\"}";
+        crow_integration::end_when_delivered(res, TrafficProcessorSdk::instance().captureAsync(r, s)); });
+
+    // Runtime tuning: GET returns the live settings, POST applies a partial
+    // document, e.g. {"sample_rate":0.1,"kafka":{"linger_ms":50}}.
+    // Only enabled when TRAFFIC_ADMIN_TOKEN is set; callers must send it as X-Admin-Token.
+    if (const char *adminToken = std::getenv("TRAFFIC_ADMIN_TOKEN"))
+    {
+        std::string token = adminToken;
+        CROW_ROUTE(app_with_middleware, "/admin/config").methods(crow::HTTPMethod::GET, crow::HTTPMethod::POST)([token](const crow::request &req)
+                                                                                                                {
+            crow::response resp;
+            resp.set_header("content-type", "application/json");
+            if (req.get_header_value("X-Admin-Token") != token)
+            {
+                resp.code = 403;
+                resp.body = "{\"error\":\"Forbidden\"}";
+                return resp;
+            }
+            try
+            {
+                if (req.method == crow::HTTPMethod::POST)
+                    TrafficProcessorSdk::instance().reconfigure(nlohmann::json::parse(req.body));
+                resp.code = 200;
+                resp.body = TrafficProcessorSdk::instance().runtimeConfig().dump();
+            }
+            catch (const std::exception &e)
+            {
+                resp.code = 400;
+                resp.body = nlohmann::json{{"error", e.what()}}.dump();
+            }
+            return resp; });
+
+        // Last closed analytics window (see TRAFFIC_ANALYTICS)
+        CROW_ROUTE(app_with_middleware, "/admin/analytics")([token](const crow::request &req)
+                                                            {
+            crow::response resp;
+            resp.set_header("content-type", "application/json");
+            if (req.get_header_value("X-Admin-Token") != token)
+            {
+                resp.code = 403;
+                resp.body = "{\"error\":\"Forbidden\"}";
+                return resp;
+            }
+            resp.code = 200;
+            resp.body = TrafficProcessorSdk::instance().analyticsSnapshot().dump();
+            return resp; });
+    }
 
     std::cout << "Server starting on http://0.0.0.0:8080" << std::endl;
     std::cout << "Supports: GET, POST on /echo endpoint only" << std::endl;
@@ -149,6 +97,7 @@ int main(int argc, char **argv)
     app_with_middleware.port(8080).multithreaded().run();
 
     std::cout << "Shutting down..." << std::endl;
-    TrafficProcessorSdk::instance().shutdown();
+    ShutdownReport report = TrafficProcessorSdk::instance().shutdown();
+    std::cout << "Shutdown report: " << report.toJson().dump() << std::endl;
     return 0;
 }
\ No newline at end of file
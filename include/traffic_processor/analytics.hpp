@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include "traffic_processor/sketches.hpp"
+
+namespace traffic_processor
+{
+
+    struct RequestData;
+    struct ResponseData;
+
+    struct AnalyticsConfig
+    {
+        bool enabled{false};
+
+        // Independent sketch sets updated without sharing; 0 means one per
+        // hardware thread. Merged when a window closes.
+        int shards{0};
+        // Window length; a snapshot is emitted when it closes. 0 disables the
+        // timer, windows then close only on snapshot()
+        int windowMs{10000};
+
+        size_t topK{20};          // routes reported per window
+        size_t sketchWidth{2048}; // Count-Min counters per row
+        size_t sketchDepth{4};
+        int hllPrecision{12};     // unique clients overall
+        int hostHllPrecision{10}; // unique clients per host
+        size_t maxHosts{256};     // hosts tracked individually, the rest fold into "(other)"
+        double digestCompression{100};
+
+        // 5xx bursts, per host and overall ("*")
+        double burstSmoothing{0.2};
+        double burstThreshold{4.0}; // deviations above baseline
+        uint64_t burstMinErrors{10};
+        int burstWarmupWindows{3};
+    };
+
+    struct LatencySummary
+    {
+        uint64_t count{0};
+        double p50{0};
+        double p90{0};
+        double p99{0};
+        double max{0};
+    };
+
+    struct ErrorBurst
+    {
+        std::string host; // "*" for all hosts
+        uint64_t errors{0};
+        double baseline{0};
+        double score{0};
+    };
+
+    struct AnalyticsSnapshot
+    {
+        int64_t windowStartMs{0}; // unix time
+        int64_t windowEndMs{0};
+        uint64_t records{0};
+        uint64_t serverErrors{0};
+        std::vector<HeavyHitter> topRoutes; // "METHOD route"
+        uint64_t uniqueClients{0};
+        std::map<std::string, uint64_t> uniqueClientsByHost;
+        std::map<int, LatencySummary> latencyByStatus;
+        std::vector<ErrorBurst> bursts;
+
+        nlohmann::json toJson() const;
+    };
+
+    // Streaming aggregates over captured traffic in bounded memory: top
+    // routes (Count-Min + heavy hitters), unique client IPs overall and per
+    // host (HyperLogLog), latency quantiles per status (t-digest) and 5xx
+    // bursts (EWMA). Usable inside the SDK (SdkConfig::analytics) or in a
+    // consumer handler.
+    //
+    // observe() picks a shard by the CPU it runs on and only takes that
+    // shard's lock, which is contended only if a thread migrates mid-update
+    // or a window is closing. Closing a window swaps every shard for an
+    // empty one and merges the old ones off the hot path.
+    class TrafficAnalytics
+    {
+    public:
+        using Sink = std::function<void(const AnalyticsSnapshot &)>;
+
+        explicit TrafficAnalytics(const AnalyticsConfig &config);
+        ~TrafficAnalytics();
+
+        // latencyMs < 0 when unknown
+        void observe(std::string_view method, std::string_view route, std::string_view host,
+                     std::string_view clientIp, int status, int64_t latencyMs);
+        // Route defaults to the request's template, else its path without query
+        void observe(const RequestData &req, const ResponseData &res, std::string_view route = {});
+
+        // Closes the current window and returns its snapshot
+        AnalyticsSnapshot snapshot();
+
+        // Most recently closed window
+        AnalyticsSnapshot latest() const;
+
+        // Starts closing windows every windowMs; each snapshot goes to sink
+        // (may be empty) and to latest(). stop() is also done on destruction.
+        void start(Sink sink = nullptr);
+        void stop();
+
+    private:
+        struct HostWindow;
+        struct Window;
+        struct Shard;
+
+        std::unique_ptr<Window> newWindow() const;
+        Shard &shardForThisThread();
+        void timerLoop();
+
+        AnalyticsConfig cfg_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<int64_t> windowStartMs_;
+
+        std::mutex closeMutex_; // one window close at a time; guards detectors
+        std::map<std::string, EwmaBurstDetector> detectors_;
+        mutable std::mutex latestMutex_;
+        AnalyticsSnapshot latest_;
+
+        Sink sink_;
+        std::thread timer_;
+        std::mutex timerMutex_;
+        std::condition_variable timerCv_;
+        bool timerStop_{false};
+
+        TrafficAnalytics(const TrafficAnalytics &) = delete;
+        TrafficAnalytics &operator=(const TrafficAnalytics &) = delete;
+    };
+
+} // namespace traffic_processor
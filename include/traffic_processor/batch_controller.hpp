@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    struct AdaptiveBatchingConfig
+    {
+        bool enabled{false};
+
+        // Operator bounds; the controller never leaves them
+        int minLingerMs{5};
+        int maxLingerMs{10000};
+        int minBatchNumMessages{10};
+        int maxBatchNumMessages{10000};
+
+        // End-to-end budget from capture() to broker ack
+        int latencySloMs{1000};
+
+        int evaluationIntervalMs{1000}; // also used as statistics.interval.ms
+
+        // Producer recreation (the only way to raise linger or resize batches)
+        // happens when the target differs from the running producer by this
+        // factor, and at most once per cooldown
+        double recreateRatio{2.0};
+        int recreateCooldownMs{30000};
+
+        double smoothing{0.3}; // EWMA weight of the newest sample
+    };
+
+    // One observation window, mostly derived from librdkafka statistics
+    struct BatchSample
+    {
+        double arrivalRate{0};       // messages/s handed to the producer
+        double avgBatchFill{0};      // messages per produced batch
+        double deliveryLatencyMs{0}; // queue wait (incl. linger) + broker round trip
+        double rttMs{0};             // broker round trip only
+    };
+
+    struct BatchDecision
+    {
+        int lingerMs{0};         // effective linger the SDK should enforce
+        int batchNumMessages{0}; // target batch size
+        bool flushEarly{false};  // expedite sends every lingerMs (target below producer linger)
+        bool recreateProducer{false};
+        const char *reason{""};
+    };
+
+    struct BatchControllerMetrics
+    {
+        double arrivalRate{0};
+        double avgBatchFill{0};
+        double deliveryLatencyMs{0};
+        int effectiveLingerMs{0};
+        int targetBatchNumMessages{0};
+        int producerLingerMs{0};
+        int producerBatchNumMessages{0};
+        bool flushingEarly{false};
+        uint64_t decisions{0};
+        uint64_t producerRecreations{0};
+        uint64_t sloViolations{0};
+        const char *lastReason{""};
+
+        nlohmann::json toJson() const;
+    };
+
+    // Feedback controller for producer batching. Pure logic: the caller feeds
+    // samples and applies decisions, which keeps it testable by replaying
+    // synthetic traffic. Not thread-safe; the SDK drives it from one thread.
+    //
+    // Policy: batch as much as the latency SLO allows. The target batch is what
+    // arrives within the SLO headroom (SLO minus broker RTT); linger is the
+    // time to fill it. When batching would not gather at least two messages,
+    // messages are sent immediately. Lowering linger is done cheaply by
+    // flushing early; raising linger or resizing batches needs a new producer.
+    class BatchController
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        BatchController(const AdaptiveBatchingConfig &config, int producerLingerMs, int producerBatchNumMessages);
+
+        BatchDecision update(const BatchSample &sample, Clock::time_point now);
+
+        // Report that a producer with these settings is now live
+        void producerRecreated(int lingerMs, int batchNumMessages, Clock::time_point now);
+
+        const BatchControllerMetrics &metrics() const { return metrics_; }
+
+    private:
+        AdaptiveBatchingConfig cfg_;
+        bool primed_{false};
+        double rate_{0};
+        double fill_{0};
+        double latency_{0};
+        double rtt_{0};
+        int producerLingerMs_;
+        int producerBatch_;
+        Clock::time_point lastRecreate_{};
+        bool recreatedOnce_{false};
+        BatchControllerMetrics metrics_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    // 128-bit content address of a body. Fast and stable across processes,
+    // not collision-resistant against crafted inputs.
+    struct BodyHash
+    {
+        uint64_t hi{0};
+        uint64_t lo{0};
+
+        std::string hex() const;                                 // 32 lowercase hex digits
+        static bool parse(std::string_view hex, BodyHash &out); // false unless 32 hex digits
+        bool operator==(const BodyHash &other) const { return hi == other.hi && lo == other.lo; }
+    };
+
+    BodyHash hashBody(std::string_view data);
+
+    // Receives a body message (see BodyDeduplicator::apply) and its key, the
+    // body reference
+    using BodySink = std::function<void(const std::string &ref, const std::string &message)>;
+
+    struct BodyDedupConfig
+    {
+        bool enabled{false};
+        size_t minBytes{512};   // smaller bodies always stay inline
+        size_t capacity{65536}; // body hashes remembered, least recently seen evicted first
+        int shards{16};
+        // A recurring body is shipped again this often, so a compacted topic
+        // or a consumer that joined late still gets it
+        int reshipIntervalMs{600000};
+        std::string topic{"http.traffic.bodies"}; // compacted topic, keyed by reference; empty disables body messages
+        BodySink sink;                            // replaces the topic when set
+    };
+
+    struct BodyDedupStats
+    {
+        uint64_t bodies{0};     // bodies large enough to be deduplicated
+        uint64_t referenced{0}; // replaced by their reference
+        uint64_t shipped{0};    // emitted as body messages
+        uint64_t bytesSaved{0}; // body text and base64 left out of records
+
+        nlohmann::json toJson() const;
+    };
+
+    // Replaces repeated bodies in capture records by a content reference.
+    // A body at least minBytes long gets "body_ref" (BodyHash::hex of its
+    // base64, or of its text when there is no base64) and "body" and
+    // "body_b64" are emptied. The first time it is seen, after it was evicted
+    // and once per reshipIntervalMs the body is shipped as a body message:
+    //
+    //   {"ref": "<hex>", "body": "...", "body_b64": "...", "timestamp": <unix s>}
+    //
+    // With neither a topic nor a sink there is nowhere to ship it, so bodies
+    // stay inline next to their reference. Thread-safe: the table of
+    // recently shipped hashes is split into independently locked LRU shards.
+    class BodyDeduplicator
+    {
+    public:
+        explicit BodyDeduplicator(const BodyDedupConfig &config);
+        ~BodyDeduplicator();
+
+        // Applies to one "request" or "response" object of a record. Returns
+        // true when `message` was filled with a body message to emit, before
+        // the record itself, keyed by the section's "body_ref".
+        bool apply(nlohmann::json &section, std::string &message);
+
+        // False when body messages have nowhere to go (no topic, no sink)
+        bool sideMessages() const { return cfg_.sink || !cfg_.topic.empty(); }
+
+        // True when the body must be shipped now; records the shipment
+        bool shouldShip(const BodyHash &hash);
+        // Makes the next shouldShip() of this hash return true, e.g. after
+        // its body message could not be delivered
+        void forget(const BodyHash &hash);
+
+        size_t size() const;
+        BodyDedupStats stats() const;
+        const BodyDedupConfig &config() const { return cfg_; }
+
+    private:
+        struct Shard;
+        Shard &shardFor(const BodyHash &hash) const;
+
+        BodyDedupConfig cfg_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<uint64_t> bodies_{0};
+        std::atomic<uint64_t> referenced_{0};
+        std::atomic<uint64_t> shipped_{0};
+        std::atomic<uint64_t> bytesSaved_{0};
+
+        BodyDeduplicator(const BodyDeduplicator &) = delete;
+        BodyDeduplicator &operator=(const BodyDeduplicator &) = delete;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    // Fields kept from the JSON bodies of one route. Paths are JSON pointers
+    // ("/order/id", "/items/0/sku") or dotted paths ("order.id", "$.items[0].sku").
+    // A pointer segment made of digits also matches that array index.
+    struct ExtractionRule
+    {
+        std::string route; // route template (path when the record has none), matched exactly
+        std::vector<std::string> requestFields;
+        std::vector<std::string> responseFields;
+        bool keepBody{false}; // also keep the full body next to the extracted fields
+    };
+
+    struct ExtractionConfig
+    {
+        std::vector<ExtractionRule> rules;
+    };
+
+    // A compiled list of field paths, at most 64
+    class JsonFieldSet
+    {
+    public:
+        JsonFieldSet() = default;
+        // Throws std::invalid_argument on an empty or malformed path
+        explicit JsonFieldSet(const std::vector<std::string> &paths);
+
+        bool empty() const { return paths_.empty(); }
+
+        // Adds each field found in `body` to `out`, keyed by its path as
+        // configured; fields not present are left out. Reads the body once,
+        // skipping subtrees no path leads into, and stops as soon as every
+        // field was found. Only the values found are parsed. False when the
+        // body is not a JSON object or array, or is malformed up to the point
+        // where scanning stopped.
+        bool extract(std::string_view body, nlohmann::json &out) const;
+
+    private:
+        struct Segment
+        {
+            std::string key;
+            int64_t index{-1}; // array index, -1 when the segment only names a key
+            bool matchesKey{true};
+        };
+        struct Path
+        {
+            std::string name;
+            std::vector<Segment> segments;
+        };
+        friend class JsonFieldScanner;
+
+        std::vector<Path> paths_;
+    };
+
+    // Replaces the bodies of records whose route has an ExtractionRule by an
+    // "extracted" object in the same section:
+    //
+    //   "request": {..., "extracted": {"/order/id": 42, "/order/total": 9.5}}
+    //
+    // "body", "body_b64" and "body_truncated" are removed unless keepBody.
+    // Bodies that are empty, not JSON or malformed stay as they are. Read-only
+    // once constructed, so it can be shared by capturing threads.
+    class BodyExtractor
+    {
+    public:
+        BodyExtractor() = default;
+        // Compiles every rule; throws std::invalid_argument on a bad path
+        explicit BodyExtractor(const ExtractionConfig &config);
+
+        bool enabled() const { return !rules_.empty(); }
+
+        // Returns true when a body of the record was replaced or extended
+        bool apply(nlohmann::json &record) const;
+
+    private:
+        struct Compiled
+        {
+            JsonFieldSet request;
+            JsonFieldSet response;
+            bool keepBody{false};
+        };
+
+        std::map<std::string, Compiled, std::less<>> rules_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "traffic_processor/body_dedup.hpp"
+#include "traffic_processor/record_view.hpp"
+
+namespace traffic_processor
+{
+
+    struct StoredBody
+    {
+        std::string text;
+        std::string base64;
+    };
+
+    // Consumer-side counterpart: remembers bodies from the body topic (and
+    // from records that carry one inline next to its reference) and resolves
+    // references. Bounded like the deduplicator; thread-safe.
+    class BodyResolver
+    {
+    public:
+        explicit BodyResolver(size_t capacity = 65536, int shards = 16);
+        ~BodyResolver();
+
+        // A body message payload; false if it is malformed
+        bool add(std::string_view bodyMessage);
+        void add(const BodyHash &hash, StoredBody body);
+
+        // nullptr when the reference is unknown (never seen or evicted)
+        std::shared_ptr<const StoredBody> find(std::string_view ref) const;
+
+        // Body of a record section: the inline body when there is one, else
+        // the referenced body; nullptr when it is referenced but not known
+        // yet, e.g. its message sits on a body topic partition not read so far
+        std::shared_ptr<const StoredBody> body(const RecordView::Section &section);
+
+        size_t size() const;
+
+    private:
+        struct Shard;
+        Shard &shardFor(const BodyHash &hash) const;
+
+        std::vector<std::unique_ptr<Shard>> shards_;
+
+        BodyResolver(const BodyResolver &) = delete;
+        BodyResolver &operator=(const BodyResolver &) = delete;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+#include <nlohmann/json.hpp>
+
+#include "traffic_processor/kafka_producer.hpp"
+
+namespace traffic_processor
+{
+
+    // Per-request capture decisions. The SDK publishes immutable snapshots of
+    // this struct and swaps them atomically at runtime, so every field here can
+    // be changed without a restart (see TrafficProcessorSdk::reconfigure).
+    struct CapturePolicy
+    {
+        double sampleRate{1.0};   // fraction of requests captured, 0..1
+        bool captureHeaders{true};
+        bool captureRequestBody{true};
+        bool captureResponseBody{true};
+        size_t maxBodyBytes{0};   // bodies longer than this are truncated; 0 = unlimited
+    };
+
+    // Runtime configuration documents use snake_case keys, e.g.
+    //   {"sample_rate": 0.1, "max_body_bytes": 4096,
+    //    "kafka": {"linger_ms": 50, "batch_num_messages": 1000}}
+    // Unknown keys are ignored; wrongly typed values throw std::invalid_argument.
+    // Returns true when any policy setting changed.
+    bool applyPolicyJson(CapturePolicy &policy, const nlohmann::json &doc);
+
+    // Applies the "kafka" object of a runtime configuration document.
+    // Returns true when any producer-level setting changed.
+    bool applyKafkaJson(KafkaConfig &kafka, const nlohmann::json &doc);
+
+    nlohmann::json policyToJson(const CapturePolicy &policy);
+
+} // namespace traffic_processor
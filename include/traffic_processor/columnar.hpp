@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace traffic_processor
+{
+
+    class RecordView;
+
+    // Columns of a segment, one per captured record field. Headers are kept
+    // as their JSON text.
+    enum class Column : uint8_t
+    {
+        Timestamp,
+        AccountId,
+        Method,
+        Scheme,
+        Host,
+        Path,
+        Query,
+        RouteTemplate,
+        ClientIp,
+        Status,
+        LatencyMs,
+        RequestHeaders,
+        RequestBody,
+        ResponseHeaders,
+        ResponseBody,
+        Count
+    };
+
+    const char *columnName(Column column);
+    Column columnFromName(std::string_view name); // throws std::invalid_argument
+
+    enum class ColumnCompression : uint8_t
+    {
+        None,
+        Zlib // needs a build with zlib (TRAFFIC_SDK_HAVE_ZLIB); stored uncompressed otherwise
+    };
+
+    struct ColumnarRow
+    {
+        int64_t timestamp{0};
+        std::string accountId;
+        std::string method;
+        std::string scheme;
+        std::string host;
+        std::string path;
+        std::string query;
+        std::string routeTemplate;
+        std::string clientIp;
+        int status{0};
+        int64_t latencyMs{-1};
+        std::string requestHeaders; // JSON object text
+        std::string requestBody;
+        std::string responseHeaders;
+        std::string responseBody;
+
+        static ColumnarRow fromRecord(const RecordView &record);
+    };
+
+    struct ColumnarConfig
+    {
+        std::string path; // segment file; empty disables the SDK export stage
+        size_t rowGroupRows{65536};
+        size_t rowGroupBytes{64 << 20}; // a group is also cut once its field data reaches this
+        ColumnCompression compression{ColumnCompression::Zlib};
+        std::map<Column, ColumnCompression> columnCompression; // per-column overrides
+        int zlibLevel{6};
+
+        // SDK export stage (ColumnarExporter): records waiting for the
+        // writer thread; records arriving while either bound is reached are
+        // dropped and counted
+        size_t queueRecords{16384};
+        size_t queueBytes{64 << 20};
+    };
+
+    // Writes captured records as a columnar segment ("TPCOL" format).
+    // Records are buffered into row groups; each row group stores every
+    // column as a separately encoded and compressed chunk:
+    //
+    //   file      := "TPCOL1\0\0" rowgroup* footer
+    //   rowgroup  := u32 rows, u8 chunks, chunk*
+    //   chunk     := u8 column, u8 encoding, u8 compression,
+    //                u32 rawSize, u32 storedSize, bytes[storedSize]
+    //   footer    := u32 groups, (u64 offset, u32 rows)*, u32 footerSize, "TPCOLEND"
+    //
+    // Integers are little-endian. Encodings: dictionary (method, scheme,
+    // host, route, account, client IP: distinct values then bit-packed
+    // indices), delta (timestamp: zigzag varint differences), bit-packed
+    // (status: offset from the chunk minimum at the narrowest width),
+    // zigzag varint (latency) and length-prefixed plain strings for the rest.
+    // A chunk is stored compressed only when that makes it smaller.
+    //
+    // Not thread-safe. The file is complete once close() returns. A row
+    // group whose chunk would not fit the u32 sizes is rejected before any
+    // of it is written, so a failed flush leaves a valid prefix.
+    class ColumnarWriter
+    {
+    public:
+        explicit ColumnarWriter(const ColumnarConfig &config); // throws std::runtime_error if the file cannot be created
+        ~ColumnarWriter();
+
+        void append(const ColumnarRow &row);
+        void append(ColumnarRow &&row);
+        void append(const RecordView &record);
+
+        void flushRowGroup();
+        void close();
+
+        uint64_t rows() const { return rows_; }
+        uint64_t bytesWritten() const { return offset_; }
+
+    private:
+        void writeChunk(Column column, uint8_t encoding, const std::string &raw);
+
+        ColumnarConfig cfg_;
+        std::ofstream out_;
+        std::vector<ColumnarRow> pending_;
+        size_t pendingBytes_{0};
+        std::vector<std::pair<uint64_t, uint32_t>> groups_; // offset, rows
+        uint64_t offset_{0};
+        uint64_t rows_{0};
+        bool closed_{false};
+        std::string scratch_;
+
+        ColumnarWriter(const ColumnarWriter &) = delete;
+        ColumnarWriter &operator=(const ColumnarWriter &) = delete;
+    };
+
+    // Writes serialized capture records to a segment from a thread of its
+    // own, so that capturing threads only enqueue: rows are decoded,
+    // encoded, compressed and written off the request path. The queue is
+    // bounded (ColumnarConfig::queueRecords / queueBytes); records offered
+    // while it is full, or after the writer failed, are dropped and counted.
+    class ColumnarExporter
+    {
+    public:
+        explicit ColumnarExporter(const ColumnarConfig &config); // throws like ColumnarWriter
+        ~ColumnarExporter();
+
+        // False when the record was dropped. Thread-safe.
+        bool offer(std::string record);
+
+        // Writes what is queued and completes the segment; throws
+        // std::runtime_error when the segment could not be written
+        void close();
+
+        uint64_t exported() const { return exported_.load(std::memory_order_relaxed); }
+        uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+        void run();
+
+        ColumnarWriter writer_;
+        size_t maxRecords_;
+        size_t maxBytes_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::string> queue_;
+        size_t queuedBytes_{0};
+        bool stop_{false};
+        bool failed_{false};
+        std::string error_;
+        std::atomic<uint64_t> exported_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::thread thread_;
+    };
+
+    // Reads a segment. Only the requested columns are read from disk and
+    // decoded; the other fields of returned rows keep their defaults.
+    class ColumnarReader
+    {
+    public:
+        explicit ColumnarReader(const std::string &path); // throws std::runtime_error on a malformed file
+
+        size_t rowGroups() const { return groups_.size(); }
+        uint64_t rows() const;
+
+        // Appends the rows of one row group
+        void read(size_t group, const std::vector<Column> &columns, std::vector<ColumnarRow> &out);
+        std::vector<ColumnarRow> readAll(const std::vector<Column> &columns);
+
+    private:
+        std::ifstream in_;
+        std::vector<std::pair<uint64_t, uint32_t>> groups_;
+        std::string chunk_;
+        std::string raw_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <librdkafka/rdkafka.h>
+#include <nlohmann/json.hpp>
+#include "traffic_processor/record_headers.hpp"
+#include "traffic_processor/record_view.hpp"
+
+namespace traffic_processor
+{
+
+    class BodyResolver;
+
+    struct ConsumerConfig
+    {
+        std::string bootstrapServers{"localhost:9092"};
+        std::string groupId{"traffic-processor-consumer"};
+        std::vector<std::string> topics{"http.traffic"};
+        std::string autoOffsetReset{"earliest"};
+
+        // Each assigned partition is routed to exactly one worker, so records
+        // of a partition are handled in order while partitions run in parallel
+        int workers{4};
+        size_t batchSize{1000}; // messages taken from a worker queue at once
+
+        // Processed offsets are committed together once this many messages
+        // were handled or the interval elapsed, whichever comes first
+        size_t commitEveryMessages{10000};
+        int commitIntervalMs{1000};
+
+        // When set, bodyTopic is subscribed as well and its body messages
+        // fill this resolver instead of reaching the handler (see
+        // BodyDedupConfig). Not owned; must outlive the consumer.
+        BodyResolver *bodies{nullptr};
+        std::string bodyTopic{"http.traffic.bodies"};
+
+        // Decides from a message's Kafka headers whether its records reach
+        // the handler; the payload of a rejected message is never read. Also
+        // asked for messages without headers (RecordHeaders::present()).
+        // Called concurrently from worker threads.
+        std::function<bool(const RecordHeaders &headers)> filter;
+
+        // Extra librdkafka consumer properties (e.g. security settings);
+        // applied last, so they override the fields above
+        std::map<std::string, std::string> extraProperties;
+    };
+
+    // Where a record came from
+    struct RecordMeta
+    {
+        std::string_view topic;
+        int32_t partition{0};
+        int64_t offset{0};
+        std::string_view key;
+        size_t indexInMessage{0}; // position within a multi-record message
+        RecordHeaders headers;    // Kafka headers of the message
+    };
+
+    struct ConsumerStats
+    {
+        uint64_t messages{0};
+        uint64_t records{0};
+        uint64_t bytes{0};
+        uint64_t malformed{0};     // payloads or records that are not valid record JSON
+        uint64_t bodies{0};        // body messages added to ConsumerConfig::bodies
+        uint64_t filtered{0};      // messages rejected by ConsumerConfig::filter
+        uint64_t handlerErrors{0}; // exceptions thrown by the handler or filter
+        uint64_t commits{0};
+        uint64_t commitErrors{0};
+        uint64_t rebalances{0};
+
+        nlohmann::json toJson() const;
+    };
+
+    // Consumer for the records written by TrafficProcessorSdk::capture().
+    // Messages are decoded lazily through RecordView, so handlers that read a
+    // few fields never pay for parsing whole bodies. Delivery is
+    // at-least-once: offsets are stored after the handler returns and
+    // committed in batches, and on shutdown or partition revocation.
+    class TrafficConsumer
+    {
+    public:
+        // Called concurrently from worker threads; the view and meta are only
+        // valid during the call
+        using Handler = std::function<void(const RecordView &record, const RecordMeta &meta)>;
+
+        // Throws std::runtime_error if the consumer cannot be created
+        TrafficConsumer(const ConsumerConfig &config, Handler handler);
+        ~TrafficConsumer();
+
+        // Blocks until stop(); serves rebalances and commits on this thread
+        void run();
+
+        // Async-signal-safe
+        void stop() noexcept { stop_.store(true, std::memory_order_relaxed); }
+
+        // Synchronously commits everything processed so far
+        void commit();
+
+        ConsumerStats stats() const;
+
+    private:
+        static void rebalanceCallback(rd_kafka_t *rk, rd_kafka_resp_err_t err,
+                                      rd_kafka_topic_partition_list_t *partitions, void *opaque);
+        void workerLoop(size_t worker);
+        void process(rd_kafka_message_t **messages, size_t count, RecordView &view,
+                     std::vector<std::string_view> &records, rd_kafka_topic_partition_list_t *offsets);
+        size_t workerFor(const char *topic, int32_t partition) const;
+        bool accepted(const RecordHeaders &headers);
+        bool commitStored(bool async);
+
+        ConsumerConfig config_;
+        Handler handler_;
+        rd_kafka_t *consumer_{nullptr};
+        std::vector<rd_kafka_queue_t *> queues_; // one per worker
+        std::vector<std::thread> threads_;
+        std::atomic<bool> stop_{false};
+
+        std::atomic<uint64_t> messages_{0};
+        std::atomic<uint64_t> records_{0};
+        std::atomic<uint64_t> bytes_{0};
+        std::atomic<uint64_t> malformed_{0};
+        std::atomic<uint64_t> bodies_{0};
+        std::atomic<uint64_t> filtered_{0};
+        std::atomic<uint64_t> handlerErrors_{0};
+        std::atomic<uint64_t> commits_{0};
+        std::atomic<uint64_t> commitErrors_{0};
+        std::atomic<uint64_t> rebalances_{0};
+        std::atomic<uint64_t> uncommitted_{0};
+
+        TrafficConsumer(const TrafficConsumer &) = delete;
+        TrafficConsumer &operator=(const TrafficConsumer &) = delete;
+    };
+
+} // namespace traffic_processor
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <functional>
 #include <string>
 
 #include <crow.h>
@@ -14,63 +15,138 @@ namespace traffic_processor
     {
 
         // Reusable Crow middleware that captures every request/response
-        // and forwards it to the Traffic Processor SDK.
-        struct TrafficMiddleware
+        // and forwards it to the Traffic Processor SDK. Mask selects the
+        // record fields at compile time (record_schema.hpp): fields outside
+        // it are neither copied out of Crow nor encoded. Requests go to
+        // TrafficProcessorSdk::instance() unless sdk_for picks an instance.
+        template <FieldMask Mask>
+        struct BasicTrafficMiddleware
         {
+            using Schema = RecordSchema<Mask>;
+
             struct context
             {
                 std::chrono::steady_clock::duration start_time;
             };
 
+            // Optional: the SDK instance capturing a request, e.g. by tenant
+            // header; nullptr leaves the request uncaptured. Set once before
+            // the app runs, via app.get_middleware<TrafficMiddleware>().
+            std::function<TrafficProcessorSdk *(const crow::request &)> sdk_for;
+
             static std::string maybe_base64(const std::string &body)
             {
                 return crow::utility::base64encode(body, body.size());
             }
 
-            void before_handle(crow::request & /*req*/, crow::response & /*res*/, context &ctx)
+            template <typename Headers>
+            static nlohmann::json headers_json(const Headers &headers)
+            {
+                nlohmann::json out = nlohmann::json::object();
+                for (const auto &[k, v] : headers)
+                    out[k] = v;
+                return out;
+            }
+
+            void before_handle(crow::request & /*req*/, crow::response & /*res*/, [[maybe_unused]] context &ctx)
             {
-                ctx.start_time = std::chrono::steady_clock::now().time_since_epoch();
+                if constexpr (Schema::has(fields::Latency))
+                    ctx.start_time = std::chrono::steady_clock::now().time_since_epoch();
             }
 
-            void after_handle(crow::request &req, crow::response &res, context &ctx)
+            void after_handle(crow::request &req, crow::response &res, [[maybe_unused]] context &ctx)
             {
-                auto start = ctx.start_time;
-                uint64_t startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start).count();
+                TrafficProcessorSdk *sdk = sdk_for ? sdk_for(req) : &TrafficProcessorSdk::instance();
+                if (!sdk)
+                    return;
 
                 RequestData r;
-                r.method = crow::method_name(req.method);
-                r.scheme = req.get_header_value("X-Forwarded-Proto");
-                if (r.scheme.empty())
-                    r.scheme = "http";
-                r.host = req.get_header_value("Host");
-                r.path = req.url;
-                r.query = "";
-                nlohmann::json hreq = nlohmann::json::object();
-                for (const auto &[k, v] : req.headers)
-                    hreq[k] = v;
-                r.headers = hreq;
-                r.bodyText = req.body;
-                r.bodyBase64 = maybe_base64(req.body);
-                r.ip = req.remote_ip_address;
-                r.startNs = startNs;
+                if constexpr (Schema::has(fields::Method))
+                    r.method = crow::method_name(req.method);
+                if constexpr (Schema::has(fields::Scheme))
+                {
+                    r.scheme = req.get_header_value("X-Forwarded-Proto");
+                    if (r.scheme.empty())
+                        r.scheme = "http";
+                }
+                if constexpr (Schema::has(fields::Host))
+                    r.host = req.get_header_value("Host");
+                if constexpr (Schema::any(fields::Path | fields::RouteTemplate))
+                    r.path = req.url;
+                if constexpr (Schema::has(fields::Query))
+                {
+                    // Crow strips the query from url; recover it from raw_url
+                    auto q = req.raw_url.find('?');
+                    if (q != std::string::npos)
+                        r.query = req.raw_url.substr(q + 1);
+                }
+                if constexpr (Schema::has(fields::RequestHeaders))
+                    r.headers = headers_json(req.headers);
+                if constexpr (Schema::has(fields::RequestBody))
+                {
+                    r.bodyText = req.body;
+                    r.bodyBase64 = maybe_base64(req.body);
+                }
+                if constexpr (Schema::has(fields::ClientIp))
+                    r.ip = req.remote_ip_address;
 
                 ResponseData s;
                 s.status = res.code;
-                nlohmann::json hres = nlohmann::json::object();
-                for (const auto &[k, v] : res.headers)
-                    hres[k] = v;
-                s.headers = hres;
-                s.bodyText = res.body;
-                s.bodyBase64 = crow::utility::base64encode(res.body, res.body.size());
-                auto end = std::chrono::steady_clock::now().time_since_epoch();
-                s.endNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end).count();
-
-                TrafficProcessorSdk::instance().capture(r, s);
+                if constexpr (Schema::has(fields::ResponseHeaders))
+                    s.headers = headers_json(res.headers);
+                if constexpr (Schema::has(fields::ResponseBody))
+                {
+                    s.bodyText = res.body;
+                    s.bodyBase64 = maybe_base64(res.body);
+                }
+                if constexpr (Schema::has(fields::Latency))
+                {
+                    r.startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(ctx.start_time).count();
+                    auto end = std::chrono::steady_clock::now().time_since_epoch();
+                    s.endNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end).count();
+                }
+
+                sdk->capture<Mask>(r, s);
             }
         };
 
+        // Every field; the policy decides at runtime what is kept
+        using TrafficMiddleware = BasicTrafficMiddleware<fields::All>;
+        // Method, path, status and latency only
+        using MetadataTrafficMiddleware = BasicTrafficMiddleware<fields::Metadata>;
+
         // Convenience alias to create an app with the middleware baked in
         using TrafficApp = crow::App<TrafficMiddleware>;
 
+        // Ends an asynchronous Crow response once `future` completes: as
+        // prepared when delivered, failureCode otherwise. For handlers taking
+        // (const crow::request &, crow::response &) that must not answer
+        // before their record is durable; no worker thread waits meanwhile.
+        inline void end_when_delivered(crow::response &res, DeliveryFuture future, int failureCode = 503)
+        {
+            future.then([&res, failureCode](DeliveryStatus status)
+                        {
+                if (status != DeliveryStatus::Delivered)
+                {
+                    res.code = failureCode;
+                    res.body = nlohmann::json{{"error", "capture not confirmed"}, {"delivery", toString(status)}}.dump();
+                }
+                res.end(); });
+        }
+
+        // Registers with the default instance; other instances take their
+        // templates from SdkConfig::routes or registerRoute()
+        template <typename Rule>
+        Rule &registered_route(const char *url, Rule &rule)
+        {
+            TrafficProcessorSdk::instance().registerRoute(url);
+            return rule;
+        }
+
     } // namespace crow_integration
 } // namespace traffic_processor
+
+// Drop-in replacement for CROW_ROUTE that also registers the route template
+// with the SDK, so records carry e.g. route_template "/users/<int>".
+#define TRAFFIC_CROW_ROUTE(app, url) \
+    ::traffic_processor::crow_integration::registered_route(url, CROW_ROUTE(app, url))
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+
+namespace traffic_processor
+{
+
+    // Outcome of a confirmed capture, worst first among several messages
+    enum class DeliveryStatus : uint8_t
+    {
+        Pending,
+        Delivered, // acknowledged by Kafka
+        Spilled,   // not acknowledged; written to the spill file at shutdown
+        Failed,    // delivery error reported by Kafka
+        Dropped,   // never enqueued, or purged without a spill file
+        Skipped    // not captured (sampled out, filtered, SDK shut down)
+    };
+
+    const char *toString(DeliveryStatus status);
+
+    using DeliveryCallback = std::function<void(DeliveryStatus)>;
+
+    // Completion state shared by a DeliveryFuture and the messages it waits
+    // for, passed to librdkafka as the message opaque. States are pooled and
+    // reference counted: the future holds one reference, messages in flight
+    // another, and the state returns to the pool when both are gone.
+    class DeliveryState
+    {
+    public:
+        static DeliveryState *acquire(); // one reference, for the future
+        void release();
+
+        // Announces `messages` more messages before any of them is sent
+        void expect(int messages);
+        // One message settled; the last one completes the state
+        void settle(DeliveryStatus status);
+
+        DeliveryStatus status() const { return status_.load(std::memory_order_acquire); }
+
+        // Registers the continuation; false when already complete (not run)
+        bool suspend(std::coroutine_handle<> coroutine);
+        bool then(DeliveryCallback &callback);
+        void wait() const;
+
+        // Runs continuations of states completed on this thread, e.g. by the
+        // delivery reports of one rd_kafka_poll() call, as one batch
+        static void runCompleted();
+        static size_t pooled(); // states allocated so far, free or in use
+
+    private:
+        DeliveryState() = default;
+        friend struct DeliveryPool;
+
+        enum Waiter : uint8_t
+        {
+            NoWaiter,
+            Waiting,
+            Done
+        };
+
+        std::atomic<DeliveryStatus> status_{DeliveryStatus::Pending};
+        std::atomic<DeliveryStatus> worst_{DeliveryStatus::Delivered};
+        std::atomic<int> outstanding_{0};
+        std::atomic<int> refs_{0};
+        std::atomic<uint8_t> waiter_{NoWaiter};
+        std::coroutine_handle<> coroutine_;
+        DeliveryCallback callback_;
+        DeliveryState *nextFree_{nullptr};
+    };
+
+    // Move-only handle on the delivery of one capture. Wait for it, attach a
+    // callback, or co_await it from a coroutine:
+    //
+    //   DeliveryStatus s = co_await sdk.captureAsync(req, res);
+    //
+    // Continuations run on the thread serving delivery reports (the
+    // producer's poll thread), so they must not block.
+    class DeliveryFuture
+    {
+    public:
+        DeliveryFuture() = default; // complete, Skipped
+        explicit DeliveryFuture(DeliveryStatus status) : status_(status) {}
+        static DeliveryFuture pending(); // backed by a pooled state
+        DeliveryFuture(DeliveryFuture &&other) noexcept;
+        DeliveryFuture &operator=(DeliveryFuture &&other) noexcept;
+        ~DeliveryFuture();
+
+        bool ready() const { return status() != DeliveryStatus::Pending; }
+        DeliveryStatus status() const { return state_ ? state_->status() : status_; }
+        bool delivered() const { return status() == DeliveryStatus::Delivered; }
+
+        DeliveryStatus wait() const;
+        // Pending when the timeout expired first
+        DeliveryStatus waitFor(std::chrono::milliseconds timeout) const;
+        // Runs `callback` once complete; immediately when already complete
+        void then(DeliveryCallback callback);
+
+        // Awaitable
+        bool await_ready() const { return ready(); }
+        bool await_suspend(std::coroutine_handle<> coroutine) { return state_ && state_->suspend(coroutine); }
+        DeliveryStatus await_resume() const { return status(); }
+
+        DeliveryState *state() const { return state_; } // for producers
+
+    private:
+        DeliveryState *state_{nullptr};
+        DeliveryStatus status_{DeliveryStatus::Skipped};
+
+        DeliveryFuture(const DeliveryFuture &) = delete;
+        DeliveryFuture &operator=(const DeliveryFuture &) = delete;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace traffic_processor
+{
+
+    // Minimal epoch/RCU domain for objects that are swapped rarely but read on
+    // every request. Readers bump a counter in a per-thread cache line (no
+    // shared writes); a writer publishes the replacement and then calls
+    // synchronize(), which returns once every reader that might still hold
+    // the old pointer has left its critical section.
+    //
+    // Readers count themselves under one of two phases. synchronize() moves
+    // new readers to the other phase and waits only for the old one to
+    // drain, so readers arriving after the swap (or a thread that keeps
+    // re-entering) never hold a writer up. Readers must load the protected
+    // pointers with seq_cst.
+    class EpochDomain
+    {
+        struct Slot;
+
+    public:
+        static constexpr size_t kSlots = 128;
+
+        class Guard
+        {
+        public:
+            explicit Guard(EpochDomain &domain) : slot_(domain.slot())
+            {
+                // A writer flipping after this load waits for the count below,
+                // and one that already scanned it is ordered before our reads
+                phase_ = domain.phase_.load(std::memory_order_seq_cst);
+                slot_.active[phase_].fetch_add(1, std::memory_order_seq_cst);
+            }
+            ~Guard()
+            {
+                slot_.active[phase_].fetch_sub(1, std::memory_order_release);
+            }
+
+        private:
+            Slot &slot_;
+            uint32_t phase_;
+
+            Guard(const Guard &) = delete;
+            Guard &operator=(const Guard &) = delete;
+        };
+
+        // Returns false if the deadline passed first; the caller must then
+        // keep the old object alive. Concurrent calls are serialized.
+        bool synchronize(std::chrono::milliseconds timeout) const
+        {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            std::unique_lock<std::timed_mutex> lock(writers_, deadline);
+            if (!lock.owns_lock())
+                return false;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint32_t old = phase_.load(std::memory_order_relaxed);
+            // Readers still counted under the next phase entered before an
+            // earlier grace period that timed out; they must go first
+            if (!drained(old ^ 1, deadline))
+                return false;
+            phase_.store(old ^ 1, std::memory_order_seq_cst);
+            return drained(old, deadline);
+        }
+
+    private:
+        struct alignas(64) Slot
+        {
+            std::atomic<uint32_t> active[2]{};
+        };
+
+        bool drained(uint32_t phase, std::chrono::steady_clock::time_point deadline) const
+        {
+            for (const auto &s : slots_)
+            {
+                while (s.active[phase].load(std::memory_order_seq_cst) != 0)
+                {
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        return false;
+                    std::this_thread::yield();
+                }
+            }
+            return true;
+        }
+
+        Slot &slot()
+        {
+            static std::atomic<size_t> nextThread{0};
+            thread_local size_t index = nextThread.fetch_add(1, std::memory_order_relaxed) % kSlots;
+            return slots_[index];
+        }
+
+        Slot slots_[kSlots];
+        mutable std::atomic<uint32_t> phase_{0};
+        mutable std::timed_mutex writers_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include "traffic_processor/http_parser.hpp"
+#include "traffic_processor/sdk.hpp"
+
+namespace traffic_processor
+{
+
+    // Link-layer header types (pcap LINKTYPE_* values)
+    enum LinkType : int
+    {
+        LinkNull = 0,      // BSD loopback
+        LinkEthernet = 1,  // also what AF_PACKET delivers on Ethernet devices
+        LinkRaw = 101,     // bare IPv4/IPv6
+        LinkLinuxSll = 113 // "any" device cooked capture
+    };
+
+    // A TCP segment decoded from a captured frame. Payload points into the
+    // frame and is only valid until the frame is released.
+    struct TcpSegment
+    {
+        std::array<uint8_t, 16> srcIp{};
+        std::array<uint8_t, 16> dstIp{};
+        bool ipv6{false};
+        uint16_t srcPort{0};
+        uint16_t dstPort{0};
+        uint32_t seq{0};
+        uint8_t flags{0};
+        const uint8_t *payload{nullptr};
+        size_t payloadLen{0};
+        uint64_t tsNs{0};
+
+        static constexpr uint8_t Fin = 0x01;
+        static constexpr uint8_t Syn = 0x02;
+        static constexpr uint8_t Rst = 0x04;
+        static constexpr uint8_t Ack = 0x10;
+    };
+
+    // Decodes Ethernet (with VLAN tags), Linux cooked, BSD loopback or raw
+    // IP frames down to TCP. Returns false for anything else, including IP
+    // fragments (live capture reassembles them in the kernel).
+    bool decodeTcpSegment(int linkType, const uint8_t *frame, size_t len, uint64_t tsNs, TcpSegment &out);
+
+    struct FlowTrackerConfig
+    {
+        // Server ports; traffic to them is requests, from them responses.
+        // When empty, the direction is learned from the SYN and connections
+        // whose handshake was not seen are ignored.
+        std::vector<uint16_t> ports{80, 8080};
+        size_t maxFlows{65536};
+        size_t maxBodyBytes{1 << 20};
+        size_t maxOutOfOrderBytes{1 << 20}; // per direction, beyond that the gap is considered lost
+        size_t maxPipelinedRequests{64};
+        uint64_t idleTimeoutNs{60'000'000'000ULL};
+    };
+
+    struct FlowTrackerStats
+    {
+        uint64_t segments{0};
+        uint64_t flows{0};        // connections tracked so far
+        uint64_t pairs{0};        // request/response pairs emitted
+        uint64_t outOfOrder{0};   // segments buffered ahead of a gap
+        uint64_t retransmits{0};  // segments (partly) already seen
+        uint64_t gaps{0};         // connections abandoned on missing bytes
+        uint64_t parseErrors{0};  // connections abandoned as non-HTTP/1.1
+        uint64_t unmatched{0};    // responses without a request, requests never answered
+        uint64_t flowsDropped{0}; // new connections refused at maxFlows
+        uint64_t expired{0};      // idle connections evicted
+
+        FlowTrackerStats &operator+=(const FlowTrackerStats &o);
+        nlohmann::json toJson() const;
+    };
+
+    // Reassembles TCP byte streams per connection, parses both directions
+    // as HTTP/1.1 and pairs each response with its request in order.
+    // Latency comes from packet timestamps: startNs is the first request
+    // byte, endNs the last response byte. Single-threaded; run one tracker
+    // per capture worker (fanout keeps both directions of a connection on
+    // the same worker).
+    class HttpFlowTracker
+    {
+    public:
+        using Sink = std::function<void(const RequestData &, const ResponseData &)>;
+
+        HttpFlowTracker(const FlowTrackerConfig &config, Sink sink);
+
+        void process(const TcpSegment &segment);
+
+        // Evicts connections idle since before now - idleTimeoutNs
+        void expire(uint64_t nowNs);
+
+        // End of input: completes close-delimited responses, drops the rest
+        void flush();
+
+        const FlowTrackerStats &stats() const { return stats_; }
+        size_t activeFlows() const { return flows_.size(); }
+
+    private:
+        struct Endpoint
+        {
+            std::array<uint8_t, 16> ip{};
+            uint16_t port{0};
+            bool operator==(const Endpoint &o) const { return port == o.port && ip == o.ip; }
+        };
+
+        struct FlowKey
+        {
+            Endpoint client;
+            Endpoint server;
+            bool operator==(const FlowKey &o) const { return client == o.client && server == o.server; }
+        };
+
+        struct FlowKeyHash
+        {
+            size_t operator()(const FlowKey &k) const;
+        };
+
+        struct PendingSegment
+        {
+            uint32_t seq;
+            std::string data;
+            uint64_t tsNs;
+        };
+
+        struct Direction
+        {
+            bool synced{false};
+            uint32_t nextSeq{0};
+            bool finSeen{false};
+            uint32_t finSeq{0};
+            bool closed{false};
+            std::vector<PendingSegment> pending;
+            size_t pendingBytes{0};
+        };
+
+        struct Flow
+        {
+            explicit Flow(size_t maxBodyBytes)
+                : requestParser(HttpStreamParser::Kind::Request, maxBodyBytes),
+                  responseParser(HttpStreamParser::Kind::Response, maxBodyBytes) {}
+
+            Direction toServer;
+            Direction toClient;
+            HttpStreamParser requestParser;
+            HttpStreamParser responseParser;
+            std::deque<HttpMessage> requests;
+            std::vector<HttpMessage> scratch;
+            bool ipv6{false};
+            bool dead{false};
+            uint64_t lastSeenNs{0};
+        };
+
+        bool isServerPort(uint16_t port) const;
+        void deliver(const FlowKey &key, Flow &flow, bool toServer, const uint8_t *data, size_t len, uint64_t tsNs);
+        void accept(const FlowKey &key, Flow &flow, bool toServer, const TcpSegment &seg);
+        void closeDirection(const FlowKey &key, Flow &flow, bool toServer, uint64_t tsNs);
+        void emit(const FlowKey &key, Flow &flow, HttpMessage &&response);
+
+        FlowTrackerConfig cfg_;
+        Sink sink_;
+        std::unordered_map<FlowKey, Flow, FlowKeyHash> flows_;
+        FlowTrackerStats stats_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace traffic_processor
+{
+
+    // One HTTP/1.1 message recovered from a byte stream
+    struct HttpMessage
+    {
+        std::string method; // requests only
+        std::string target; // requests only, path plus optional query
+        int status{0};      // responses only
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;           // de-chunked, capped at maxBodyBytes
+        bool bodyTruncated{false};
+        uint64_t firstByteNs{0}; // timestamp of the packet carrying the first byte
+        uint64_t lastByteNs{0};  // timestamp of the packet completing the message
+
+        // Case-insensitive lookup; empty when absent
+        std::string_view header(std::string_view name) const;
+    };
+
+    // Incremental HTTP/1.1 parser for one direction of a connection. Bytes
+    // are fed in stream order as they are reassembled; complete messages are
+    // appended to `out`. Handles pipelining, Content-Length, chunked transfer
+    // coding and, for responses, bodies delimited by connection close as well
+    // as the no-body cases (HEAD, 1xx, 204, 304). Interim 1xx responses are
+    // skipped. Once a stream cannot be parsed it stays failed.
+    class HttpStreamParser
+    {
+    public:
+        enum class Kind
+        {
+            Request,
+            Response
+        };
+
+        explicit HttpStreamParser(Kind kind, size_t maxBodyBytes = 1 << 20, size_t maxHeaderBytes = 64 << 10);
+
+        // Returns false once the stream is unparseable
+        bool feed(const char *data, size_t len, uint64_t tsNs, std::vector<HttpMessage> &out);
+
+        // End of stream: completes a body that runs until connection close
+        void finish(uint64_t tsNs, std::vector<HttpMessage> &out);
+
+        // Responses: announce the method of the next request on the
+        // connection, needed to know that a HEAD response carries no body
+        void expectResponseTo(std::string_view method);
+
+        bool failed() const { return state_ == State::Failed; }
+
+        // A 101 response or a successful CONNECT switched protocols: the
+        // rest of the connection is not HTTP/1.1
+        bool upgraded() const { return state_ == State::Upgraded; }
+
+    private:
+        enum class State
+        {
+            Headers,
+            Body,
+            ChunkSize,
+            ChunkData,
+            ChunkDataEnd,
+            ChunkTrailer,
+            UntilClose,
+            Failed,
+            Upgraded
+        };
+
+        bool plausibleStart(std::string_view in) const;
+        bool parseHead(std::string_view head);
+        void appendBody(const char *p, size_t n);
+        void complete(uint64_t tsNs, std::vector<HttpMessage> &out);
+
+        Kind kind_;
+        size_t maxBodyBytes_;
+        size_t maxHeaderBytes_;
+        State state_{State::Headers};
+        std::string buf_;
+        size_t scanned_{0}; // header bytes already searched for the blank line
+        bool started_{false};
+        uint64_t remaining_{0};
+        HttpMessage cur_;
+        std::deque<std::string> pendingMethods_;
+        bool headRequest_{false};
+        bool connectRequest_{false};
+    };
+
+} // namespace traffic_processor
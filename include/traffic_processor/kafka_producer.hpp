@@ -1,14 +1,37 @@
 #pragma once
 
 #include <librdkafka/rdkafka.h>
+#include "traffic_processor/delivery.hpp"
+#include "traffic_processor/record_headers.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
 #include <cstdlib>
 
 namespace traffic_processor
 {
 
+    // Settings of one topic that differ from the producer's. Compression
+    // and acks are per-topic settings in librdkafka; linger and batch sizes
+    // are per connection, so a topic overriding them gets its own connection.
+    struct TopicConfig
+    {
+        std::string compression; // empty: KafkaConfig::compression
+        std::string acks;        // empty: KafkaConfig::acks
+        int lingerMs{-1};        // -1: KafkaConfig value
+        int batchSizeBytes{-1};
+        int batchNumMessages{-1};
+    };
+
     struct KafkaConfig
     {
         std::string bootstrapServers;
@@ -27,12 +50,21 @@ namespace traffic_processor
         int retries{3};
         int requestTimeoutMs{5000};
 
+        // librdkafka statistics (statistics.interval.ms); 0 disables them
+        int statisticsIntervalMs{0};
+
+        // Flush budget when a producer is destroyed without drain()
+        int closeFlushTimeoutMs{2000};
+
         // Optional: arbitrary librdkafka properties passed as a map/object.
         // Any keys provided here override the typed fields or add new ones.
         // Example usage (object-style):
         //   cfg.kafka.extraProperties["enable.idempotence"] = "true";
         std::map<std::string, std::string> extraProperties;
 
+        // Per-topic overrides, for `topic` and any topic passed to send()
+        std::map<std::string, TopicConfig> topics;
+
         KafkaConfig()
         {
             // Auto-detect if running in Docker
@@ -126,28 +158,144 @@ namespace traffic_processor
         }
     };
 
+    // Subset of librdkafka's periodic statistics used for tuning
+    struct ProducerStats
+    {
+        int64_t timestampUs{0}; // "ts": monotonic microseconds
+        int64_t txMessages{0};  // "txmsgs": total messages transmitted
+        int64_t queuedMessages{0};
+        double avgBatchCount{0};  // messages per batch (topics.*.batchcnt.avg)
+        double avgBatchBytes{0};  // bytes per batch (topics.*.batchsize.avg)
+        double intLatencyMs{0};   // produce() to request (brokers.*.int_latency.avg)
+        double rttMs{0};          // broker round trip (brokers.*.rtt.avg)
+    };
+
+    // Lifetime delivery accounting, updated from delivery reports
+    struct DeliveryCounters
+    {
+        uint64_t delivered{0};     // acknowledged by the broker
+        uint64_t failed{0};        // delivery reported an error (not purged)
+        uint64_t enqueueFailed{0}; // rejected by produce(), e.g. queue full
+        uint64_t spilled{0};       // purged during drain and written to the spill file
+        uint64_t purged{0};        // purged during drain with nowhere to spill
+    };
+
+    // Serves its own delivery reports, statistics and completed delivery
+    // continuations from a background thread for as long as it lives, so a
+    // pooled producer is polled once however many instances lease it, and a
+    // swapped-out one keeps settling its futures until it is destroyed.
     class KafkaProducer
     {
     public:
         explicit KafkaProducer(const KafkaConfig &config);
         ~KafkaProducer();
 
-        // Send a JSON record to Kafka (rdkafka auto-batching)
-        void send(const std::string &jsonRecord);
+        // Send a JSON record to Kafka (rdkafka auto-batching). A delivery
+        // state, announced with expect() beforehand, is settled with the
+        // outcome from the delivery report, or at once if the message could
+        // not be enqueued; continuations run after the poll serving it.
+        // `headers` become the message's Kafka headers; librdkafka copies
+        // them along with the payload, so views into the record suffice.
+        void send(const std::string &jsonRecord, DeliveryState *delivery = nullptr,
+                  const RecordHeaders *headers = nullptr);
+
+        // Send to any topic, optionally keyed. Topics listed in
+        // KafkaConfig::topics use their overrides; others the defaults.
+        // Side messages (e.g. deduplicated bodies, shipped again later) are
+        // not written to the spill file by drain() and count as purged; they
+        // cannot carry a delivery state.
+        enum class MessageKind
+        {
+            Record,
+            Side
+        };
+        void send(const std::string &payload, const std::string &topic, std::string_view key = {},
+                  MessageKind kind = MessageKind::Record, DeliveryState *delivery = nullptr,
+                  const RecordHeaders *headers = nullptr);
+
+        // A side message that runs `lost` if it is not delivered (delivery
+        // error, purge, or rejected by produce()), e.g. so that its content
+        // is sent again later. `lost` runs on the thread that learns of it.
+        void sendSide(const std::string &payload, const std::string &topic, std::string_view key,
+                      std::function<void()> lost);
 
-        // Poll for delivery reports
+        // Poll for delivery reports (the producer also polls from its own thread)
         void poll(int timeoutMs = 0);
 
         // Force immediate flush of all pending messages
         void flush(int timeoutMs = 1000);
 
+        // Ask broker threads to send queued messages now regardless of
+        // linger.ms, waiting at most waitMs; no error if messages remain
+        void expedite(int waitMs = 1);
+
+        // Latest statistics snapshot of the default connection (requires
+        // statisticsIntervalMs > 0)
+        ProducerStats stats() const;
+
+        // Flush until the deadline, then purge whatever is still queued or in
+        // flight. Purged records are appended to `spill` (one JSON record per
+        // line) when given, otherwise counted as purged. Returns the number of
+        // messages that could not be delivered.
+        int drain(std::chrono::steady_clock::time_point deadline, std::FILE *spill);
+
+        DeliveryCounters counters() const;
+
+        // Messages queued or in flight
+        int queueLength() const;
+
+        const KafkaConfig &config() const { return config_; }
+
         // Get current queue statistics
         void printStats() const;
 
     private:
+        // One librdkafka producer per distinct connection setting;
+        // connections_[0] uses the KafkaConfig values
+        struct Connection
+        {
+            rd_kafka_t *rk{nullptr};
+            int lingerMs{0};
+            int batchSizeBytes{0};
+            int batchNumMessages{0};
+        };
+        struct TopicHandle
+        {
+            rd_kafka_t *rk{nullptr};
+            rd_kafka_topic_t *topic{nullptr};
+        };
+
+        // Enqueues on the connection of `topic`; logs and counts a rejection
+        rd_kafka_resp_err_t produce(const std::string &payload, const std::string &topic, std::string_view key,
+                                    void *opaque, const RecordHeaders *headers);
+        rd_kafka_t *createConnection(int lingerMs, int batchSizeBytes, int batchNumMessages, bool withStats);
+        rd_kafka_topic_t *createTopic(rd_kafka_t *rk, const std::string &name, const TopicConfig *overrides);
+        void destroy();
+
         KafkaConfig config_;
-        rd_kafka_t *producer_;
-        rd_kafka_topic_t *topic_;
+        rd_kafka_t *producer_{nullptr}; // connections_[0]
+        rd_kafka_topic_t *topic_{nullptr};
+        rd_kafka_t *topicConnection_{nullptr}; // connection of topic_
+        std::vector<Connection> connections_;
+        std::map<std::string, TopicHandle, std::less<>> topics_; // fixed after construction
+
+        mutable std::mutex statsMutex_;
+        ProducerStats stats_;
+
+        std::atomic<uint64_t> delivered_{0};
+        std::atomic<uint64_t> failed_{0};
+        std::atomic<uint64_t> enqueueFailed_{0};
+        std::atomic<uint64_t> spilled_{0};
+        std::atomic<uint64_t> purged_{0};
+        std::mutex spillMutex_;
+        std::FILE *spill_{nullptr}; // only set while drain() runs
+
+        void pollLoop();
+        std::thread poller_;
+        std::atomic<bool> pollStop_{false};
+
+        static int statsCallback(rd_kafka_t *rk, char *json, size_t len, void *opaque);
+        static void deliveryCallback(rd_kafka_t *rk, const rd_kafka_message_t *rkmessage, void *opaque);
 
         KafkaProducer(const KafkaProducer &) = delete;
         KafkaProducer &operator=(const KafkaProducer &) = delete;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include "traffic_processor/flow_tracker.hpp"
+
+namespace traffic_processor
+{
+
+    // A captured frame; data stays valid until the next frame is read
+    struct CapturedFrame
+    {
+        const uint8_t *data{nullptr};
+        size_t len{0};
+        uint64_t tsNs{0}; // wall clock, nanoseconds since the epoch
+    };
+
+    // Reader for classic pcap files (either byte order, micro- or nanosecond
+    // timestamps). pcapng is rejected; convert with `editcap -F pcap`.
+    // Throws std::runtime_error when the file cannot be used.
+    class PcapReader
+    {
+    public:
+        explicit PcapReader(const std::string &path);
+
+        bool next(CapturedFrame &frame); // false at end of file
+        int linkType() const { return linkType_; }
+
+    private:
+        uint32_t field(const unsigned char *p) const;
+
+        std::ifstream in_;
+        bool swapped_{false};
+        bool nanos_{false};
+        int linkType_{0};
+        std::vector<uint8_t> buf_;
+    };
+
+    struct CaptureConfig
+    {
+        std::string interface; // live capture through AF_PACKET ("any" for all devices)
+        std::string pcapPath;  // offline input; used instead of the interface when set
+
+        // Live capture: one TPACKET_V3 ring and thread per worker, joined in a
+        // fanout group that hashes flows so each connection stays on one worker
+        int workers{1};
+        uint16_t fanoutGroup{0}; // 0 derives the group id from the process id
+        uint32_t ringBlockSize{1 << 22};
+        uint32_t ringBlockCount{64};
+        uint32_t ringFrameSize{1 << 11};
+        int blockTimeoutMs{10}; // hand partially filled blocks over after this long
+
+        FlowTrackerConfig tracker;
+    };
+
+    // Passive capture: reads frames from a pcap file or live AF_PACKET rings,
+    // reassembles HTTP/1.1 exchanges and hands each request/response pair to
+    // the sink. With several workers the sink is called concurrently.
+    class PacketCapture
+    {
+    public:
+        PacketCapture(const CaptureConfig &config, HttpFlowTracker::Sink sink);
+
+        // Blocks until stop() or the end of the pcap file. Throws
+        // std::runtime_error if the input cannot be opened.
+        void run();
+
+        // Async-signal-safe
+        void stop() noexcept { stop_.store(true, std::memory_order_relaxed); }
+
+        nlohmann::json stats() const;
+
+    private:
+        void runPcap();
+        void runRing(size_t worker, int fd);
+        void publish(size_t worker, const FlowTrackerStats &stats, uint64_t packets, uint64_t kernelDrops);
+
+        CaptureConfig cfg_;
+        HttpFlowTracker::Sink sink_;
+        std::atomic<bool> stop_{false};
+
+        mutable std::mutex statsMutex_;
+        struct WorkerStats
+        {
+            FlowTrackerStats tracker;
+            uint64_t packets{0};
+            uint64_t kernelDrops{0};
+        };
+        std::vector<WorkerStats> workerStats_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    // Watches a JSON runtime configuration file and invokes the callback with
+    // its parsed content whenever it is written or atomically replaced
+    // (inotify on Linux, mtime polling elsewhere). The file is also read once
+    // on start(). Parse errors are reported and the previous settings kept.
+    class PolicyWatcher
+    {
+    public:
+        using Callback = std::function<void(const nlohmann::json &)>;
+
+        PolicyWatcher(std::string path, Callback onChange);
+        ~PolicyWatcher();
+
+        void start();
+        void stop();
+
+    private:
+        void run();
+        void load();
+
+        std::string path_;
+        Callback onChange_;
+        std::atomic<bool> running_{false};
+        std::thread thread_;
+        int wakeFd_{-1};   // eventfd used to interrupt the blocking wait in stop()
+        int notifyFd_{-1}; // inotify instance, set up before start() returns
+        std::string fileName_;
+
+        PolicyWatcher(const PolicyWatcher &) = delete;
+        PolicyWatcher &operator=(const PolicyWatcher &) = delete;
+    };
+
+} // namespace traffic_processor
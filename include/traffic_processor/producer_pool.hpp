@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "traffic_processor/kafka_producer.hpp"
+
+namespace traffic_processor
+{
+
+    // Producers shared by SDK instances with equal Kafka settings, so a
+    // process hosting many accounts keeps one set of broker connections and
+    // librdkafka threads per distinct configuration rather than per account.
+    // A lease is a reference; the pool itself only remembers producers, so
+    // one is gone once its last lease is released. Thread-safe.
+    class ProducerPool
+    {
+    public:
+        ProducerPool() = default;
+
+        // Process-wide pool; never destroyed, so leases may outlive statics
+        static ProducerPool &shared();
+
+        // The producer for `config`, created on first use. Throws like the
+        // KafkaProducer constructor.
+        std::shared_ptr<KafkaProducer> acquire(const KafkaConfig &config);
+
+        // Gives a lease back. When it was the last one the producer leaves
+        // the pool and is returned, for the caller to drain and destroy;
+        // otherwise returns nullptr.
+        std::shared_ptr<KafkaProducer> release(std::shared_ptr<KafkaProducer> lease);
+
+        size_t size() const; // producers with at least one lease
+
+        // Identity of a configuration: every setting that reaches librdkafka
+        static std::string key(const KafkaConfig &config);
+
+    private:
+        mutable std::mutex mutex_;
+        std::map<std::string, std::weak_ptr<KafkaProducer>> producers_;
+
+        ProducerPool(const ProducerPool &) = delete;
+        ProducerPool &operator=(const ProducerPool &) = delete;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+
+namespace traffic_processor
+{
+
+    // Kafka record headers sent with every capture record (and its body
+    // record when split), so consumers can route and filter on them without
+    // reading the payload. Values are plain text; a field the record does
+    // not carry is sent as an empty header.
+    namespace record_headers
+    {
+        inline constexpr const char *AccountId = "account_id";
+        inline constexpr const char *Method = "method";
+        inline constexpr const char *Status = "status"; // decimal
+        inline constexpr const char *Host = "host";
+        inline constexpr const char *Route = "route"; // route template, else path
+        inline constexpr const char *SchemaVersion = "schema_version";
+        inline constexpr const char *ContentEncoding = "content_encoding";
+
+        // Bumped when the record layout changes incompatibly
+        inline constexpr std::string_view CurrentSchemaVersion = "1";
+        // Payload format: one JSON record per message
+        inline constexpr std::string_view Json = "json";
+    }
+
+    // Header values of one message. Views only: the producer points them
+    // into the record being sent, the consumer into the received message.
+    struct RecordHeaders
+    {
+        std::string_view accountId;
+        std::string_view method;
+        std::string_view status;
+        std::string_view host;
+        std::string_view route;
+        std::string_view schemaVersion;
+        std::string_view contentEncoding;
+
+        // False for messages written without headers, e.g. by older SDKs
+        bool present() const { return !schemaVersion.empty(); }
+
+        int statusCode() const // 0 when absent
+        {
+            int code = 0;
+            std::from_chars(status.data(), status.data() + status.size(), code);
+            return code;
+        }
+    };
+
+} // namespace traffic_processor
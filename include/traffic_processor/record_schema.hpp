@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace traffic_processor
+{
+
+    // Record fields selectable at compile time. A capture path instantiated
+    // with a mask (TrafficProcessorSdk::capture<Mask>, the Crow middleware)
+    // neither copies, encodes nor serializes the fields left out; a record
+    // always carries account_id and timestamp.
+    using FieldMask = uint32_t;
+
+    namespace fields
+    {
+        inline constexpr FieldMask Method = 1u << 0;
+        inline constexpr FieldMask Scheme = 1u << 1;
+        inline constexpr FieldMask Host = 1u << 2;
+        inline constexpr FieldMask Path = 1u << 3;
+        inline constexpr FieldMask Query = 1u << 4; // "query" and "query_params"
+        inline constexpr FieldMask RouteTemplate = 1u << 5;
+        inline constexpr FieldMask RequestHeaders = 1u << 6;
+        inline constexpr FieldMask RequestBody = 1u << 7; // "body", "body_b64", "body_truncated"
+        inline constexpr FieldMask ClientIp = 1u << 8;
+        inline constexpr FieldMask Status = 1u << 9;
+        inline constexpr FieldMask ResponseHeaders = 1u << 10;
+        inline constexpr FieldMask ResponseBody = 1u << 11;
+        inline constexpr FieldMask Latency = 1u << 12;
+
+        inline constexpr FieldMask Headers = RequestHeaders | ResponseHeaders;
+        inline constexpr FieldMask Bodies = RequestBody | ResponseBody;
+        inline constexpr FieldMask Metadata = Method | Path | Status | Latency;
+        inline constexpr FieldMask All = (1u << 13) - 1; // the dynamic default: every field, policy decides at runtime
+    }
+
+    template <FieldMask Mask>
+    struct RecordSchema
+    {
+        static constexpr FieldMask mask = Mask;
+
+        static constexpr bool has(FieldMask f) { return (Mask & f) == f; }
+        static constexpr bool any(FieldMask f) { return (Mask & f) != 0; }
+    };
+
+} // namespace traffic_processor
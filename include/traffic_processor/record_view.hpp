@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include "traffic_processor/sdk.hpp"
+
+namespace traffic_processor
+{
+
+    // Splits a Kafka message payload into the records it carries: a single
+    // JSON object, newline-delimited objects (NDJSON, also the spill file
+    // format) or a JSON array of objects. Returns false if the payload is
+    // malformed; records found before the error are still appended.
+    bool splitRecords(std::string_view payload, std::vector<std::string_view> &out);
+
+    // Read-only view of one serialized capture record, decoded on demand.
+    // Nothing is parsed up front: the first access to a section indexes its
+    // members with a structural scan that skips over values without decoding
+    // them, and only the strings actually read are unescaped. String results
+    // point into the payload (or into the view when unescaping was needed)
+    // and stay valid while both are alive. Not thread-safe.
+    class RecordView
+    {
+    public:
+        // One "request" or "response" object of the record
+        class Section
+        {
+        public:
+            // Request fields
+            std::string_view method() const { return string(Method); }
+            std::string_view scheme() const { return string(Scheme); }
+            std::string_view host() const { return string(Host); }
+            std::string_view path() const { return string(Path); }
+            std::string_view query() const { return string(Query); }
+            std::string_view routeTemplate() const { return string(RouteTemplate); }
+            std::string_view ip() const { return string(Ip); }
+
+            // Response fields
+            int status() const;
+
+            // Both
+            std::string_view header(std::string_view name) const; // case-insensitive, empty if absent
+            std::string_view bodyText() const { return string(Body); }
+            std::string_view bodyBase64() const { return string(BodyBase64); }
+            bool bodyTruncated() const;
+            std::string_view bodyRef() const { return string(BodyRef); } // set when the body was deduplicated (see BodyResolver)
+            // Raw JSON of a body field kept by BodyExtractor, by its configured
+            // path; empty when absent
+            std::string_view extracted(std::string_view path) const;
+            bool present() const { return begin_ != nullptr; }
+
+            // Full decode of composite members, for callers that need them all
+            nlohmann::json headers() const;
+            nlohmann::json queryParams() const;
+
+            // Raw JSON text of any member, including ones added after this
+            // view was written; empty when absent
+            std::string_view raw(std::string_view key) const;
+
+        private:
+            friend class RecordView;
+            enum Field
+            {
+                Method,
+                Scheme,
+                Host,
+                Path,
+                Query,
+                QueryParams,
+                RouteTemplate,
+                Headers,
+                Body,
+                BodyBase64,
+                BodyTruncated,
+                BodyRef,
+                Extracted,
+                Ip,
+                Status,
+                FieldCount
+            };
+
+            void index() const;
+            std::string_view string(Field f) const;
+
+            const RecordView *owner_{nullptr};
+            const char *begin_{nullptr};
+            const char *end_{nullptr};
+            mutable bool indexed_{false};
+            mutable std::string_view fields_[FieldCount];
+        };
+
+        RecordView() = default;
+        explicit RecordView(std::string_view json);
+        RecordView(const RecordView &) = delete;
+        RecordView &operator=(const RecordView &) = delete;
+
+        // Rebinds the view to another record, keeping allocated buffers
+        void reset(std::string_view json);
+
+        // The payload is a JSON object (its members are checked lazily)
+        bool valid() const;
+        std::string_view json() const { return json_; }
+
+        std::string_view accountId() const;
+        std::string_view recordId() const; // links split metadata and body records (see RoutingConfig)
+        int64_t timestamp() const;
+        int64_t latencyMs() const; // -1 when the record has no latency
+
+        const Section &request() const;
+        const Section &response() const;
+
+        std::string_view raw(std::string_view key) const;
+
+        // Materialize the structures the producer was fed
+        RequestData toRequestData() const;
+        ResponseData toResponseData() const;
+
+    private:
+        enum Field
+        {
+            AccountId,
+            RecordId,
+            Timestamp,
+            LatencyMs,
+            Request,
+            Response,
+            FieldCount
+        };
+
+        void index() const;
+        std::string_view decode(std::string_view rawString) const;
+
+        std::string_view json_;
+        mutable bool indexed_{false};
+        mutable bool valid_{false};
+        mutable std::string_view fields_[FieldCount];
+        mutable Section request_;
+        mutable Section response_;
+        mutable std::deque<std::string> decoded_; // unescaped strings handed out
+        mutable size_t decodedUsed_{0};
+    };
+
+} // namespace traffic_processor
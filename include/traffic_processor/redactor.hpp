@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    struct RedactionConfig
+    {
+        bool enabled{true};
+
+        // Header names are matched case-insensitively.
+        // Deny-listed headers are removed from the record entirely,
+        // mask-listed headers keep their name but the value is replaced.
+        std::vector<std::string> headerDenyList;
+        std::vector<std::string> headerMaskList{"authorization", "proxy-authorization", "cookie", "set-cookie"};
+        std::string headerMaskValue{"[REDACTED]"};
+
+        // Literal secret markers searched in bodies (e.g. "sk_live_", "AKIA", "Bearer ").
+        // The marker and the token that immediately follows it are masked.
+        std::vector<std::string> bodyPatterns;
+
+        // Mask 13-19 digit sequences that pass the Luhn check (last 4 digits kept)
+        bool maskCardNumbers{true};
+
+        // Fields masked in JSON bodies. A plain name ("password") matches that
+        // key at any depth; a "$."-prefixed path ("$.card.number") matches from
+        // the root. "*" matches any single key, arrays are transparent.
+        // At most 64 rooted paths.
+        std::vector<std::string> jsonFields;
+
+        char maskChar{'*'};
+    };
+
+    // Redaction stage compiled once from RedactionConfig. All masking happens
+    // in place and never changes buffer length, so it can run directly on the
+    // strings already owned by the outgoing record. Thread-safe for concurrent
+    // use once constructed (the compiled tables are read-only).
+    class Redactor
+    {
+    public:
+        Redactor() = default;
+        // Throws std::invalid_argument on more than 64 rooted JSON paths
+        explicit Redactor(const RedactionConfig &config);
+
+        bool enabled() const { return enabled_; }
+
+        // Remove deny-listed and mask mask-listed entries of a header object
+        void redactHeaders(nlohmann::json &headers) const;
+
+        // Returns true when any byte of the body was masked
+        bool redactBody(std::string &body) const;
+        bool redactBody(char *data, size_t len) const;
+
+    private:
+        struct JsonPath
+        {
+            std::vector<std::string> segments;
+        };
+
+        bool maskPatterns(unsigned char *data, size_t len) const;
+        bool maskCardNumbers(unsigned char *data, size_t len) const;
+        bool maskJsonFields(unsigned char *data, size_t len) const;
+        bool headerListed(const std::vector<std::string> &list, std::string_view name) const;
+
+        bool enabled_{false};
+        RedactionConfig cfg_;
+        std::vector<std::string> denyLower_;
+        std::vector<std::string> maskLower_;
+
+        // Aho-Corasick automaton as a dense DFA: delta_[state * 256 + byte]
+        std::vector<int32_t> delta_;
+        std::vector<uint16_t> matchLen_; // longest pattern ending in state, 0 if none
+        std::vector<unsigned char> firstBytes_;
+        bool firstByteSet_[256]{};
+        // Distinct leading byte pairs; used by the SIMD prefilter when every
+        // pattern has at least two bytes, which cuts false candidates sharply
+        std::vector<std::pair<unsigned char, unsigned char>> firstPairs_;
+
+        std::vector<std::string> jsonAnyDepth_;
+        std::vector<JsonPath> jsonRooted_;
+    };
+
+} // namespace traffic_processor
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace traffic_processor
+{
+
+    struct RouteConfig
+    {
+        bool enabled{true};
+
+        // Known route templates. Crow syntax ("/users/<int>/orders/<int>",
+        // "/files/<path>") as well as "{name}" and ":name" placeholders are accepted.
+        std::vector<std::string> routes;
+
+        // Paths that match no registered route are templated heuristically
+        // (numeric ids, UUIDs, hex hashes and long opaque tokens become
+        // placeholders) and remembered, up to maxLearnedRoutes distinct templates.
+        bool autoLearn{true};
+        size_t maxLearnedRoutes{1024};
+
+        // Reported once the learned set is full, so cardinality stays bounded
+        std::string overflowTemplate{"/{other}"};
+    };
+
+    // Splits "a=1&b=2&a=3" into {"a":["1","3"],"b":"2"} with percent-decoding
+    nlohmann::json parseQueryString(std::string_view query);
+
+    // Maps raw request paths to low-cardinality route templates.
+    // Lookups never take a lock: registered routes live in an immutable trie
+    // that is republished (copy-on-write) when a route is added, and learned
+    // templates sit in a fixed-capacity open-addressing table filled by CAS.
+    class RouteNormalizer
+    {
+    public:
+        RouteNormalizer();
+        explicit RouteNormalizer(const RouteConfig &config);
+        ~RouteNormalizer();
+
+        // Safe to call while other threads normalize (e.g. routes declared after initialize())
+        void addRoute(std::string_view pattern);
+
+        std::string normalize(std::string_view path) const;
+
+        bool enabled() const { return cfg_.enabled; }
+        size_t learnedCount() const { return learnedCount_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Trie;
+
+        const std::string *learn(std::string &&tmpl) const;
+
+        RouteConfig cfg_;
+
+        std::atomic<const Trie *> trie_{nullptr};
+        std::mutex writeMutex_;                         // serializes addRoute() only
+        std::vector<std::unique_ptr<const Trie>> tries_; // current + retired snapshots
+
+        size_t learnedMask_{0};
+        std::unique_ptr<std::atomic<const std::string *>[]> learned_;
+        mutable std::atomic<size_t> learnedCount_{0};
+
+        RouteNormalizer(const RouteNormalizer &) = delete;
+        RouteNormalizer &operator=(const RouteNormalizer &) = delete;
+    };
+
+} // namespace traffic_processor
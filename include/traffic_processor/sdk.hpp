@@ -1,18 +1,103 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <nlohmann/json.hpp>
+#include "traffic_processor/analytics.hpp"
+#include "traffic_processor/batch_controller.hpp"
+#include "traffic_processor/body_extractor.hpp"
+#include "traffic_processor/body_dedup.hpp"
+#include "traffic_processor/capture_policy.hpp"
+#include "traffic_processor/columnar.hpp"
+#include "traffic_processor/delivery.hpp"
+#include "traffic_processor/epoch.hpp"
 #include "traffic_processor/kafka_producer.hpp"
+#include "traffic_processor/policy_watcher.hpp"
+#include "traffic_processor/producer_pool.hpp"
+#include "traffic_processor/record_schema.hpp"
+#include "traffic_processor/redactor.hpp"
+#include "traffic_processor/route_normalizer.hpp"
 
 namespace traffic_processor
 {
 
+    // Records matching every criterion set go to `topic` instead of
+    // KafkaConfig::topic, e.g. errors to a priority topic
+    struct TopicRule
+    {
+        std::string topic;
+        int minStatus{0};
+        int maxStatus{999};
+        std::string routePrefix;          // prefix of the route template (path when absent); empty matches all
+        std::vector<std::string> methods; // empty matches all
+    };
+
+    // Tiered topics. The first matching rule picks the topic of a record.
+    // With splitBodies each capture becomes a compact metadata record, routed
+    // by the rules, and a body record on bodyTopic:
+    //
+    //   {"record_id": "<hex>", "account_id": ..., "timestamp": ...,
+    //    "request": {"body", "body_b64", ...}, "response": {...}}
+    //
+    // The metadata record carries the same "record_id" and, when there was a
+    // body, "body_topic"; both are keyed by record id. Producer tuning per
+    // topic (linger, compression, acks) goes in KafkaConfig::topics.
+    struct RoutingConfig
+    {
+        std::vector<TopicRule> rules;
+        bool splitBodies{false};
+        std::string bodyTopic{"http.traffic.payloads"};
+    };
+
     struct SdkConfig
     {
         std::string accountId{"local-traffic-processor"};
         KafkaConfig kafka; // Uses default localhost:9092
+        RedactionConfig redaction;
+        RouteConfig routes;
+        CapturePolicy policy; // initial snapshot; swappable at runtime
+        AdaptiveBatchingConfig adaptiveBatching;
+        AnalyticsConfig analytics;   // in-process sketches over every captured pair
+        ColumnarConfig columnar;     // also export sent records to a columnar segment when path is set
+        BodyDedupConfig bodyDedup;   // repeated bodies sent once to a side topic, referenced by hash
+        RoutingConfig routing;       // topics by status or route; bodies split off to a cold topic
+        ExtractionConfig extraction; // per-route JSON body fields sent instead of the whole body
+
+        // Lease the producer from this pool instead of owning one, sharing it
+        // with every instance of equal Kafka settings (e.g. one instance per
+        // account, all on ProducerPool::shared()). Its settings are then fixed:
+        // no producer-level reconfigure() and no adaptive batching.
+        ProducerPool *producerPool{nullptr};
+
+        // Optional JSON file watched for runtime changes (see reconfigure())
+        std::string runtimeConfigPath;
+
+        // Deadline used by shutdown() without arguments
+        int shutdownTimeoutMs{2000};
+        // Records still queued when the shutdown deadline hits are appended
+        // here as newline-delimited JSON; empty means they are dropped
+        std::string spillPath;
+    };
+
+    // Outcome of shutdown(), covering the whole session since initialize()
+    struct ShutdownReport
+    {
+        uint64_t delivered{0}; // acknowledged by Kafka
+        uint64_t spilled{0};   // written to SdkConfig::spillPath
+        uint64_t dropped{0};   // lost: delivery errors, full queues, purged without spill
+        uint64_t columnarDropped{0}; // not exported to the columnar segment: queue full or write failed
+        std::chrono::milliseconds elapsed{0};
+        bool deadlineExceeded{false}; // the flush did not finish before the deadline
+
+        nlohmann::json toJson() const;
     };
 
     struct RequestData
@@ -21,10 +106,11 @@ namespace traffic_processor
         std::string scheme;
         std::string host;
         std::string path;
-        std::string query;
+        std::string query;         // raw query string; split from path when left empty
+        std::string routeTemplate; // optional; derived from path by the SDK when empty
         nlohmann::json headers;
         std::string bodyText;
-        std::string bodyBase64;
+        std::string bodyBase64; // optional; encoded from bodyText by the SDK when empty
         std::string ip;
         uint64_t startNs{0};
     };
@@ -34,28 +120,270 @@ namespace traffic_processor
         int status{0};
         nlohmann::json headers;
         std::string bodyText;
-        std::string bodyBase64;
+        std::string bodyBase64; // optional; encoded from bodyText by the SDK when empty
         uint64_t endNs{0};
     };
 
+    // First rule matching a record, or nullptr
+    const TopicRule *matchTopicRule(const std::vector<TopicRule> &rules, const nlohmann::json &record);
+    // Kafka headers of a record (record_headers.hpp), viewing into it; the
+    // status is formatted into statusBuffer
+    RecordHeaders recordHeaders(const nlohmann::json &record, char (&statusBuffer)[12]);
+    // Moves the body fields of both sections into a body record (see
+    // RoutingConfig); null when neither section has a body
+    nlohmann::json splitRecordBodies(nlohmann::json &record, const std::string &recordId);
+
+    // Sets "body", "body_b64" and, when cut at maxBytes, "body_truncated"
+    void setRecordBody(nlohmann::json &section, const std::string &text, const std::string &b64,
+                       bool captured, size_t maxBytes);
+
+    // The capture record with the fields of Mask; fields outside it are not
+    // read from req/res at all. `route` is the normalized route template,
+    // recorded when req.routeTemplate is empty. Defined below.
+    template <FieldMask Mask>
+    nlohmann::json buildRecord(const std::string &accountId, const RequestData &req, const ResponseData &res,
+                               const CapturePolicy &policy, std::string_view route);
+    // Same, normalizing the path with `routes` when given
+    template <FieldMask Mask>
+    nlohmann::json buildRecord(const std::string &accountId, const RequestData &req, const ResponseData &res,
+                               const CapturePolicy &policy, const RouteNormalizer *routes);
+
+    // One capture pipeline: account id, policies, stages and producer.
+    // instance() is a process-wide default; hosts serving several accounts
+    // construct one instance per account, usually sharing producers through
+    // SdkConfig::producerPool. An instance is shut down when destroyed.
     class TrafficProcessorSdk
     {
     public:
+        TrafficProcessorSdk() = default; // initialize() before capturing
+        explicit TrafficProcessorSdk(const SdkConfig &config) { initialize(config); }
+        ~TrafficProcessorSdk();
+
         static TrafficProcessorSdk &instance();
         void initialize();                        // Simple initialization with defaults
         void initialize(const SdkConfig &config); // Initialize with custom config
+        void capture(const RequestData &req, const ResponseData &res); // every field, capture<fields::All>
+        // Records only the fields of Mask (see record_schema.hpp), e.g.
+        // capture<fields::Metadata>(req, res); the rest is never serialized
+        template <FieldMask Mask>
         void capture(const RequestData &req, const ResponseData &res);
-        void shutdown();
+        // Opt-in confirmed capture: the future completes once Kafka
+        // acknowledged the record (and its body record when split), or with
+        // the reason it was not; Skipped when it was not captured at all.
+        // Completed in batches by the producer's poll thread, see delivery.hpp.
+        DeliveryFuture captureAsync(const RequestData &req, const ResponseData &res);
+        template <FieldMask Mask>
+        DeliveryFuture captureAsync(const RequestData &req, const ResponseData &res);
+        void registerRoute(std::string_view pattern); // route template, e.g. "/users/<int>"
+
+        // Runtime tuning without restart. reconfigure() accepts the document
+        // format described in capture_policy.hpp; policy changes are published
+        // as a new immutable snapshot, producer-level ("kafka") changes build a
+        // new producer, swap it in and drain the old one.
+        void reconfigure(const nlohmann::json &changes);
+        void updatePolicy(const CapturePolicy &policy);
+        void reconfigureProducer(const KafkaConfig &kafka);
+        CapturePolicy currentPolicy() const;
+        nlohmann::json runtimeConfig() const;
+
+        // Adaptive batching controller state and decisions (empty if disabled)
+        nlohmann::json batchingMetrics() const;
+
+        // In-process analytics (nullptr unless SdkConfig::analytics.enabled).
+        // Sees every pair that reaches capture(), before sampling.
+        TrafficAnalytics *analytics() { return analytics_.get(); }
+        nlohmann::json analyticsSnapshot() const; // last closed window, empty if disabled
+
+        // Body deduplication stage (nullptr unless SdkConfig::bodyDedup.enabled)
+        BodyDeduplicator *bodyDedup() { return bodyDedup_.get(); }
+
+        // Stops intake, drains producers in parallel until the deadline,
+        // spills or drops what is left and reports the loss. Idempotent and
+        // thread-safe: concurrent or repeated calls return the same report.
+        // A pooled producer still leased by other instances is only flushed
+        // until the deadline; the last instance releasing it drains it. Its
+        // counts cover all traffic on it since this instance leased it.
+        ShutdownReport shutdown();
+        ShutdownReport shutdown(std::chrono::milliseconds deadline);
+
+        // Async-signal-safe: only stops intake (one lock-free atomic store).
+        // Call from a signal handler, then run shutdown() from a normal thread.
+        void requestShutdown() noexcept;
+
         void printKafkaStats(); // Print current Kafka producer statistics
 
     private:
-        TrafficProcessorSdk() = default;
-        ~TrafficProcessorSdk();
+        // capture() stages that do not depend on the field set: intake,
+        // analytics and sampling (nullptr: not recorded), then redaction,
+        // export stages and delivery. admit() normalizes the path at most
+        // once, and stores the template in `route` when that is given.
+        const CapturePolicy *admit(const RequestData &req, const ResponseData &res, std::string *route);
+        void emit(nlohmann::json &record, DeliveryState *delivery = nullptr);
         TrafficProcessorSdk(const TrafficProcessorSdk &) = delete;
         TrafficProcessorSdk &operator=(const TrafficProcessorSdk &) = delete;
 
         SdkConfig cfg_{};
-        std::unique_ptr<KafkaProducer> producer_;
+        Redactor redactor_;
+        BodyExtractor extractor_;
+        std::unique_ptr<RouteNormalizer> routes_;
+        std::vector<std::string> registeredRoutes_;
+
+        // Hot path reads the policy with a single acquire load inside an
+        // epoch guard. A replaced snapshot is freed once the epoch advances;
+        // the list keeps the current one and any still awaiting that.
+        std::atomic<const CapturePolicy *> policy_{nullptr};
+        std::vector<std::unique_ptr<const CapturePolicy>> policies_;
+
+        // Producer users hold an epoch guard so a swapped-out producer is only
+        // drained and destroyed once no capture can still reference it.
+        std::atomic<KafkaProducer *> producer_{nullptr};
+        std::unique_ptr<KafkaProducer> ownedProducer_;
+        std::vector<std::unique_ptr<KafkaProducer>> retiredProducers_;
+        // Instead of ownedProducer_ when pooled; counters at the time of leasing
+        ProducerPool *pool_{nullptr};
+        std::shared_ptr<KafkaProducer> leasedProducer_;
+        DeliveryCounters leaseBaseline_;
+        EpochDomain epochs_;
+
+        mutable std::mutex reconfigMutex_; // serializes writers only
+        std::mutex producerSwapMutex_;     // taken before reconfigMutex_
+        std::unique_ptr<PolicyWatcher> watcher_;
+        std::unique_ptr<TrafficAnalytics> analytics_;
+        std::shared_ptr<BodyDeduplicator> bodyDedup_; // body messages in flight hold weak references
+
+        // Export stage; closed (footer written) by shutdown()
+        std::unique_ptr<ColumnarExporter> columnar_;
+        std::mutex columnarMutex_;
+
+        std::atomic<bool> accepting_{false};
+        std::mutex shutdownMutex_;
+        bool shutdownDone_{false};
+        ShutdownReport lastReport_;
+        DeliveryCounters retiredCounters_; // producers swapped out at runtime
+
+        // Background thread: drives adaptive batching
+        void maintenanceLoop();
+        std::unique_ptr<BatchController> batching_;
+        mutable std::mutex batchingMutex_;
+        std::thread maintenance_;
+        std::mutex maintenanceMutex_;
+        std::condition_variable maintenanceCv_;
+        bool maintenanceStop_{false};
     };
 
+    template <FieldMask Mask>
+    nlohmann::json buildRecord(const std::string &accountId, const RequestData &req, const ResponseData &res,
+                               const CapturePolicy &policy, std::string_view route)
+    {
+        using Schema = RecordSchema<Mask>;
+        using nlohmann::json;
+        json j;
+        j["account_id"] = accountId;
+        j["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+
+        json r = json::object();
+        if constexpr (Schema::has(fields::Method))
+            r["method"] = req.method;
+        if constexpr (Schema::has(fields::Scheme))
+            r["scheme"] = req.scheme;
+        if constexpr (Schema::has(fields::Host))
+            r["host"] = req.host;
+        if constexpr (Schema::any(fields::Path | fields::Query | fields::RouteTemplate))
+        {
+            std::string_view path = req.path;
+            std::string_view query = req.query;
+            if (query.empty())
+            {
+                size_t q = path.find('?');
+                if (q != std::string_view::npos)
+                {
+                    query = path.substr(q + 1);
+                    path = path.substr(0, q);
+                }
+            }
+            if constexpr (Schema::has(fields::Path))
+                r["path"] = path;
+            if constexpr (Schema::has(fields::Query))
+            {
+                r["query"] = query;
+                r["query_params"] = parseQueryString(query);
+            }
+            if constexpr (Schema::has(fields::RouteTemplate))
+            {
+                if (!req.routeTemplate.empty())
+                    r["route_template"] = req.routeTemplate;
+                else if (!route.empty())
+                    r["route_template"] = route;
+            }
+        }
+        if constexpr (Schema::has(fields::RequestHeaders))
+            r["headers"] = policy.captureHeaders ? req.headers : json::object();
+        if constexpr (Schema::has(fields::RequestBody))
+            setRecordBody(r, req.bodyText, req.bodyBase64, policy.captureRequestBody, policy.maxBodyBytes);
+        if constexpr (Schema::has(fields::ClientIp))
+            r["ip"] = req.ip;
+
+        json s = json::object();
+        if constexpr (Schema::has(fields::Status))
+            s["status"] = res.status;
+        if constexpr (Schema::has(fields::ResponseHeaders))
+            s["headers"] = policy.captureHeaders ? res.headers : json::object();
+        if constexpr (Schema::has(fields::ResponseBody))
+            setRecordBody(s, res.bodyText, res.bodyBase64, policy.captureResponseBody, policy.maxBodyBytes);
+
+        j["request"] = std::move(r);
+        j["response"] = std::move(s);
+
+        if constexpr (Schema::has(fields::Latency))
+        {
+            if (req.startNs != 0 && res.endNs != 0 && res.endNs > req.startNs)
+            {
+                uint64_t deltaNs = res.endNs - req.startNs;
+                j["latency_ms"] = static_cast<int>(deltaNs / 1'000'000);
+            }
+        }
+        return j;
+    }
+
+    template <FieldMask Mask>
+    nlohmann::json buildRecord(const std::string &accountId, const RequestData &req, const ResponseData &res,
+                               const CapturePolicy &policy, const RouteNormalizer *routes)
+    {
+        std::string route;
+        if constexpr (RecordSchema<Mask>::has(fields::RouteTemplate))
+        {
+            if (req.routeTemplate.empty() && routes)
+                route = routes->normalize(std::string_view(req.path).substr(0, req.path.find('?')));
+        }
+        return buildRecord<Mask>(accountId, req, res, policy, std::string_view(route));
+    }
+
+    template <FieldMask Mask>
+    void TrafficProcessorSdk::capture(const RequestData &req, const ResponseData &res)
+    {
+        EpochDomain::Guard guard(epochs_);
+        std::string route;
+        if (const CapturePolicy *policy = admit(req, res, RecordSchema<Mask>::has(fields::RouteTemplate) ? &route : nullptr))
+        {
+            nlohmann::json record = buildRecord<Mask>(cfg_.accountId, req, res, *policy, std::string_view(route));
+            emit(record);
+        }
+    }
+
+    template <FieldMask Mask>
+    DeliveryFuture TrafficProcessorSdk::captureAsync(const RequestData &req, const ResponseData &res)
+    {
+        EpochDomain::Guard guard(epochs_);
+        std::string route;
+        const CapturePolicy *policy = admit(req, res, RecordSchema<Mask>::has(fields::RouteTemplate) ? &route : nullptr);
+        if (!policy)
+            return DeliveryFuture(DeliveryStatus::Skipped);
+        nlohmann::json record = buildRecord<Mask>(cfg_.accountId, req, res, *policy, std::string_view(route));
+        DeliveryFuture future = DeliveryFuture::pending();
+        emit(record, future.state());
+        return future;
+    }
+
 } // namespace traffic_processor
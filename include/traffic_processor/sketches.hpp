@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace traffic_processor
+{
+
+    // 64-bit hash used by all sketches; stable across processes so sketches
+    // built on different hosts can be merged
+    uint64_t hash64(std::string_view data, uint64_t seed = 0);
+
+    // Count-Min sketch with conservative update. Estimates never undercount;
+    // overcount is at most e/width of the total with probability 1-e^-depth.
+    // Sketches of equal dimensions merge by adding counters.
+    class CountMinSketch
+    {
+    public:
+        CountMinSketch(size_t width = 2048, size_t depth = 4); // width rounded up to a power of two
+
+        void add(uint64_t hash, uint64_t count = 1);
+        uint64_t estimate(uint64_t hash) const;
+        void merge(const CountMinSketch &other); // throws std::invalid_argument on mismatched dimensions
+        uint64_t total() const { return total_; }
+
+    private:
+        size_t slot(uint64_t hash, size_t row) const;
+
+        size_t width_;
+        size_t depth_;
+        std::vector<uint64_t> counters_; // depth_ rows of width_
+        uint64_t total_{0};
+    };
+
+    struct HeavyHitter
+    {
+        std::string key;
+        uint64_t count{0}; // Count-Min estimate, an upper bound
+    };
+
+    // Top-k keys: a Count-Min sketch counts every key and a bounded candidate
+    // set keeps the keys with the largest estimates. Merging re-ranks the
+    // union of both candidate sets against the merged sketch.
+    class HeavyHitters
+    {
+    public:
+        HeavyHitters(size_t capacity = 20, size_t width = 2048, size_t depth = 4);
+
+        void add(std::string_view key, uint64_t count = 1);
+        void merge(const HeavyHitters &other);
+        std::vector<HeavyHitter> top(size_t n) const; // largest first
+        const CountMinSketch &sketch() const { return sketch_; }
+
+    private:
+        struct KeyHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        void evictMin();
+
+        CountMinSketch sketch_;
+        size_t capacity_;
+        std::unordered_map<std::string, uint64_t, KeyHash, std::equal_to<>> candidates_;
+        uint64_t minCount_{0}; // smallest candidate estimate once full
+    };
+
+    // HyperLogLog distinct counter with 2^precision one-byte registers;
+    // standard error is about 1.04/sqrt(2^precision). Merging takes the
+    // register-wise maximum and requires equal precision.
+    class HyperLogLog
+    {
+    public:
+        explicit HyperLogLog(int precision = 12); // 4..18
+
+        void add(uint64_t hash);
+        uint64_t estimate() const;
+        void merge(const HyperLogLog &other); // throws std::invalid_argument on mismatched precision
+        int precision() const { return precision_; }
+
+    private:
+        int precision_;
+        std::vector<uint8_t> registers_;
+    };
+
+    // Merging t-digest for quantiles. Keeps at most about `compression`
+    // centroids, sized by the arcsine scale function so the tails stay
+    // accurate; inserts are buffered and folded in batches.
+    class TDigest
+    {
+    public:
+        explicit TDigest(double compression = 100);
+
+        void add(double value, double weight = 1);
+        void merge(const TDigest &other);
+        double quantile(double q) const; // 0 when empty
+        double count() const;
+        double min() const { return min_; }
+        double max() const { return max_; }
+
+    private:
+        struct Centroid
+        {
+            double mean;
+            double weight;
+        };
+
+        void compress() const;
+
+        double compression_;
+        mutable std::vector<Centroid> centroids_; // sorted by mean
+        mutable std::vector<Centroid> buffer_;
+        mutable double weight_{0}; // in centroids_
+        double min_{0};
+        double max_{0};
+    };
+
+    // Flags windows whose count jumps above an exponentially weighted
+    // baseline. The spread is taken as the larger of the EWMA standard
+    // deviation and the Poisson deviation sqrt(mean), so steady low-volume
+    // series do not alarm on their first non-zero window.
+    class EwmaBurstDetector
+    {
+    public:
+        EwmaBurstDetector(double smoothing = 0.2, double threshold = 4.0, double minCount = 10, int warmupWindows = 3);
+
+        // Feeds one window; returns true if it is a burst against the
+        // baseline of the previous windows
+        bool update(double value);
+
+        double mean() const { return mean_; }
+        double stddev() const;
+        double score() const { return score_; } // deviations above baseline of the last window
+
+    private:
+        double smoothing_;
+        double threshold_;
+        double minCount_;
+        int warmupWindows_;
+        int windows_{0};
+        double mean_{0};
+        double variance_{0};
+        double score_{0};
+    };
+
+} // namespace traffic_processor
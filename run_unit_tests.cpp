@@ -1,7 +1,41 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+#include <librdkafka/rdkafka_mock.h>
 #include <nlohmann/json.hpp>
 #include "traffic_processor/sdk.hpp"
+#include "traffic_processor/analytics.hpp"
+#include "traffic_processor/batch_controller.hpp"
+#include "traffic_processor/body_dedup.hpp"
+#include "traffic_processor/body_extractor.hpp"
+#include "traffic_processor/body_resolver.hpp"
+#include "traffic_processor/capture_policy.hpp"
+#include "traffic_processor/columnar.hpp"
+#include "traffic_processor/consumer.hpp"
+#include "traffic_processor/delivery.hpp"
+#include "traffic_processor/epoch.hpp"
+#include "traffic_processor/flow_tracker.hpp"
+#include "traffic_processor/http_parser.hpp"
+#include "traffic_processor/packet_capture.hpp"
+#include "traffic_processor/policy_watcher.hpp"
+#include "traffic_processor/producer_pool.hpp"
+#include "traffic_processor/record_headers.hpp"
+#include "traffic_processor/record_view.hpp"
+#include "traffic_processor/redactor.hpp"
+#include "traffic_processor/route_normalizer.hpp"
+#include "traffic_processor/sketches.hpp"
 
 using namespace traffic_processor;
 using json = nlohmann::json;
@@ -276,6 +310,1762 @@ void test_edge_cases(TestRunner &t)
     t.assert_true("Special characters preserved", body.find("àáâãäåæçèéêë") != std::string::npos);
 }
 
+void test_redaction(TestRunner &t)
+{
+    std::cout << "\n🔒 Testing Redaction..." << std::endl;
+
+    RedactionConfig rc;
+    rc.headerDenyList = {"X-Internal-Token"};
+    rc.bodyPatterns = {"sk_live_", "Bearer "};
+    rc.jsonFields = {"password", "$.card.cvv"};
+    Redactor redactor(rc);
+
+    json headers = json{{"Authorization", "Bearer abc"}, {"x-internal-token", "t"}, {"Accept", "*/*"}};
+    redactor.redactHeaders(headers);
+    t.assert_eq("Authorization masked", std::string("[REDACTED]"), headers["Authorization"].get<std::string>());
+    t.assert_true("Deny-listed header removed", !headers.contains("x-internal-token"));
+    t.assert_eq("Other headers untouched", std::string("*/*"), headers["Accept"].get<std::string>());
+
+    std::string text = "key=sk_live_abc123&auth=Bearer xyz.789 card 4111 1111 1111 1111 end";
+    size_t len = text.size();
+    t.assert_true("Text body reported changed", redactor.redactBody(text));
+    t.assert_eq("Body length preserved", static_cast<int>(len), static_cast<int>(text.size()));
+    t.assert_true("Secret token masked", text.find("abc123") == std::string::npos);
+    t.assert_true("Bearer token masked", text.find("xyz.789") == std::string::npos);
+    t.assert_true("Card number masked", text.find("**** **** **** 1111") != std::string::npos);
+
+    std::string order = "order 1234567890123 ok";
+    t.assert_true("Non-Luhn digits kept", !redactor.redactBody(order));
+
+    std::string body = R"({"user":{"name":"bob","password":"hunter2"},"card":{"cvv":123,"number":"4111111111111111"},"cvv":"keep"})";
+    redactor.redactBody(body);
+    json parsed = json::parse(body);
+    t.assert_eq("Nested password masked", std::string("*******"), parsed["user"]["password"].get<std::string>());
+    t.assert_eq("Rooted numeric path masked", 999, parsed["card"]["cvv"].get<int>());
+    t.assert_eq("Card in JSON string masked", std::string("************1111"), parsed["card"]["number"].get<std::string>());
+    t.assert_eq("Unrooted key with same name kept", std::string("keep"), parsed["cvv"].get<std::string>());
+    t.assert_eq("Unmatched field kept", std::string("bob"), parsed["user"]["name"].get<std::string>());
+
+    RedactionConfig off;
+    off.enabled = false;
+    std::string untouched = "Bearer abc";
+    t.assert_true("Disabled redactor is a no-op", !Redactor(off).redactBody(untouched));
+
+    RedactionConfig tooMany;
+    for (int i = 0; i <= 64; ++i)
+        tooMany.jsonFields.push_back("$.field" + std::to_string(i));
+    bool rejected = false;
+    try
+    {
+        Redactor overflow(tooMany);
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    t.assert_true("Rooted paths beyond the limit rejected", rejected);
+}
+
+void test_route_normalization(TestRunner &t)
+{
+    std::cout << "\n🧭 Testing Route Normalization..." << std::endl;
+
+    json q = parseQueryString("page=1&tag=a&tag=b%20c&flag&name=J+Doe");
+    t.assert_eq("Query single value", std::string("1"), q["page"].get<std::string>());
+    t.assert_eq("Query repeated key becomes array", 2, static_cast<int>(q["tag"].size()));
+    t.assert_eq("Query percent-decoded", std::string("b c"), q["tag"][1].get<std::string>());
+    t.assert_eq("Query key without value", std::string(""), q["flag"].get<std::string>());
+    t.assert_eq("Query plus decoded", std::string("J Doe"), q["name"].get<std::string>());
+
+    RouteConfig rc;
+    rc.routes = {"/users/<int>/orders/<int>", "/users/me", "/files/<path>", "/items/{sku}"};
+    rc.maxLearnedRoutes = 2;
+    RouteNormalizer routes(rc);
+
+    t.assert_eq("Registered Crow route", std::string("/users/<int>/orders/<int>"), routes.normalize("/users/12345/orders/987"));
+    t.assert_eq("Static segment preferred", std::string("/users/me"), routes.normalize("/users/me"));
+    t.assert_eq("Path wildcard", std::string("/files/<path>"), routes.normalize("/files/a/b/c.txt"));
+    t.assert_eq("Brace placeholder", std::string("/items/{sku}"), routes.normalize("/items/AB-1?x=1"));
+
+    t.assert_eq("Heuristic numeric id", std::string("/accounts/{id}"), routes.normalize("/accounts/42"));
+    t.assert_eq("Heuristic uuid and hash", std::string("/blobs/{uuid}/{hash}"),
+                routes.normalize("/blobs/123e4567-e89b-12d3-a456-426614174000/9f86d081884c7d659a2feaa0c55ad015"));
+    t.assert_eq("Learned set bounded", 2, static_cast<int>(routes.learnedCount()));
+    t.assert_eq("Known template still served", std::string("/accounts/{id}"), routes.normalize("/accounts/7"));
+    t.assert_eq("Overflow template once full", std::string("/{other}"), routes.normalize("/brand/new"));
+
+    routes.addRoute("/brand/<string>");
+    t.assert_eq("Route added after construction", std::string("/brand/<string>"), routes.normalize("/brand/new"));
+}
+
+void test_runtime_config(TestRunner &t)
+{
+    std::cout << "\n🎛️ Testing Runtime Configuration..." << std::endl;
+
+    CapturePolicy policy;
+    applyPolicyJson(policy, json{{"sample_rate", 0.25}, {"max_body_bytes", 1024}, {"capture_headers", false}});
+    t.assert_true("Sample rate applied", policy.sampleRate == 0.25);
+    t.assert_eq("Max body bytes applied", 1024, static_cast<int>(policy.maxBodyBytes));
+    t.assert_true("Capture headers applied", !policy.captureHeaders);
+    t.assert_true("Untouched field keeps value", policy.captureRequestBody);
+    t.assert_true("Kafka-only document leaves policy unchanged",
+                  !applyPolicyJson(policy, json{{"kafka", {{"linger_ms", 20}}}, {"sample_rate", 0.25}}));
+
+    bool rejected = false;
+    try
+    {
+        applyPolicyJson(policy, json{{"sample_rate", 2.0}});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    t.assert_true("Out-of-range sample rate rejected", rejected);
+    t.assert_true("Rejected document leaves policy unchanged", policy.sampleRate == 0.25);
+
+    KafkaConfig kafka;
+    t.assert_true("No kafka section means no producer change", !applyKafkaJson(kafka, json{{"sample_rate", 1.0}}));
+    t.assert_true("Same value is not a change", !applyKafkaJson(kafka, json{{"kafka", {{"linger_ms", kafka.lingerMs}}}}));
+    t.assert_true("Linger change detected", applyKafkaJson(kafka, json{{"kafka", {{"linger_ms", 25}}}}));
+    t.assert_eq("Linger applied", 25, kafka.lingerMs);
+
+    EpochDomain epochs;
+    t.assert_true("Grace period with no readers", epochs.synchronize(std::chrono::milliseconds(10)));
+    {
+        EpochDomain::Guard guard(epochs);
+        t.assert_true("Grace period waits for active reader", !epochs.synchronize(std::chrono::milliseconds(10)));
+    }
+    t.assert_true("Grace period after a timed-out one", epochs.synchronize(std::chrono::milliseconds(10)));
+    {
+        // Overlapping guards keep this thread's slot busy throughout; each
+        // grace period only waits for the guard that predates it
+        std::atomic<bool> stop{false};
+        std::atomic<bool> reading{false};
+        std::thread reader([&]
+                           {
+            auto held = std::make_unique<EpochDomain::Guard>(epochs);
+            reading = true;
+            while (!stop.load())
+            {
+                auto next = std::make_unique<EpochDomain::Guard>(epochs);
+                held = std::move(next);
+            } });
+        while (!reading.load())
+            std::this_thread::yield();
+        bool passed = true;
+        for (int i = 0; i < 20; ++i)
+            passed = epochs.synchronize(std::chrono::milliseconds(500)) && passed;
+        stop = true;
+        reader.join();
+        t.assert_true("Grace period ignores readers that start after it", passed);
+    }
+
+    std::string path = "/tmp/traffic_sdk_runtime_test.json";
+    std::ofstream(path) << R"({"sample_rate": 0.5})";
+    std::atomic<int> applied{0};
+    std::atomic<double> lastRate{0.0};
+    PolicyWatcher watcher(path, [&](const json &doc)
+                          {
+        lastRate = doc.value("sample_rate", 0.0);
+        applied++; });
+    watcher.start();
+    std::ofstream(path) << R"({"sample_rate": 0.75})";
+    for (int i = 0; i < 200 && lastRate.load() != 0.75; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    watcher.stop();
+    t.assert_true("Watcher read file on start and after write", applied.load() >= 2 && lastRate.load() == 0.75);
+
+    // Through the SDK: the file is applied before initialize() returns
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    std::ofstream(path) << R"({"sample_rate": 0.25, "max_body_bytes": 2048})";
+    SdkConfig sdkConfig;
+    sdkConfig.kafka.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    sdkConfig.routes.enabled = false;
+    sdkConfig.runtimeConfigPath = path;
+    std::unique_ptr<TrafficProcessorSdk> sdk;
+    std::atomic<bool> returned{false};
+    std::thread starter([&]
+                        {
+        sdk = std::make_unique<TrafficProcessorSdk>(sdkConfig);
+        returned = true; });
+    for (int i = 0; i < 500 && !returned; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (returned)
+        starter.join();
+    else
+        starter.detach(); // deadlocked; leaked so the remaining tests still run
+    t.assert_true("SDK: initialize returns with a runtime config file", returned.load());
+    if (returned)
+    {
+        json live = sdk->runtimeConfig();
+        t.assert_true("SDK: runtime config file applied on start", live["sample_rate"] == 0.25 && live["max_body_bytes"] == 2048);
+        sdk->shutdown();
+    }
+    std::remove(path.c_str());
+    if (returned)
+    {
+        rd_kafka_mock_cluster_destroy(cluster);
+        rd_kafka_destroy(admin);
+    }
+}
+
+// Replays a synthetic arrival-rate curve (one sample per simulated second)
+// through the batching controller against a simple producer model.
+struct BatchingSimulation
+{
+    BatchingSimulation(int linger, int batch) : producerLinger(linger), producerBatch(batch) {}
+
+    int producerLinger;
+    int producerBatch;
+    int recreations = 0;
+    int sloMisses = 0;
+    bool withinBounds = true;
+    BatchDecision last;
+
+    void run(BatchController &c, const AdaptiveBatchingConfig &cfg, const std::vector<double> &rates)
+    {
+        auto t = BatchController::Clock::time_point{};
+        const double rttMs = 5.0;
+        for (double rate : rates)
+        {
+            double linger = last.flushEarly ? last.lingerMs : producerLinger;
+            double fillTimeMs = rate > 0 ? producerBatch / rate * 1000.0 : linger;
+            double waitMs = std::min(linger, fillTimeMs);
+            BatchSample s;
+            s.arrivalRate = rate;
+            s.avgBatchFill = std::clamp(rate * waitMs / 1000.0, 1.0, static_cast<double>(producerBatch));
+            s.deliveryLatencyMs = waitMs + rttMs;
+            s.rttMs = rttMs;
+            if (s.deliveryLatencyMs > cfg.latencySloMs)
+                sloMisses++;
+
+            last = c.update(s, t);
+            withinBounds &= last.lingerMs >= cfg.minLingerMs && last.lingerMs <= cfg.maxLingerMs &&
+                            last.batchNumMessages >= cfg.minBatchNumMessages && last.batchNumMessages <= cfg.maxBatchNumMessages;
+            if (last.recreateProducer)
+            {
+                producerLinger = last.lingerMs;
+                producerBatch = last.batchNumMessages;
+                c.producerRecreated(producerLinger, producerBatch, t);
+                recreations++;
+            }
+            t += std::chrono::seconds(1);
+        }
+    }
+};
+
+void test_adaptive_batching(TestRunner &t)
+{
+    std::cout << "\n📈 Testing Adaptive Batching (simulation)..." << std::endl;
+
+    AdaptiveBatchingConfig cfg;
+    cfg.enabled = true;
+    cfg.latencySloMs = 500;
+    cfg.maxBatchNumMessages = 5000;
+    cfg.recreateCooldownMs = 10000;
+
+    // Low QPS against the static 10 s linger default
+    {
+        BatchController c(cfg, 10000, 100);
+        BatchingSimulation sim(10000, 100);
+        sim.run(c, cfg, std::vector<double>(30, 0.5));
+        t.assert_true("Low rate: linger dropped to minimum", sim.last.lingerMs == cfg.minLingerMs);
+        t.assert_true("Low rate: producer linger no longer 10 s", sim.producerLinger <= cfg.minLingerMs);
+        t.assert_true("Low rate: decisions within bounds", sim.withinBounds);
+    }
+
+    // Ramp from idle to 50k msg/s: batches must grow, bounded by max and SLO
+    {
+        std::vector<double> ramp;
+        for (int i = 0; i < 60; ++i)
+            ramp.push_back(std::min(50000.0, 10.0 * std::pow(1.25, i)));
+        ramp.insert(ramp.end(), 60, 50000.0);
+        BatchController c(cfg, 10000, 100);
+        BatchingSimulation sim(10000, 100);
+        sim.run(c, cfg, ramp);
+        t.assert_true("High rate: batch size grown", sim.producerBatch >= 1000);
+        t.assert_true("High rate: batch size capped", sim.producerBatch <= cfg.maxBatchNumMessages);
+        t.assert_true("High rate: linger within SLO", sim.producerLinger <= cfg.latencySloMs);
+        t.assert_true("High rate: decisions within bounds", sim.withinBounds);
+        t.assert_true("High rate: metrics exported", c.metrics().decisions == ramp.size() &&
+                                                         c.metrics().toJson().contains("effective_linger_ms"));
+    }
+
+    // Noisy plateau: hysteresis and cooldown must prevent flapping
+    {
+        std::vector<double> noisy;
+        for (int i = 0; i < 300; ++i)
+            noisy.push_back(i % 2 ? 5000.0 : 7000.0);
+        BatchController c(cfg, 10000, 100);
+        BatchingSimulation sim(10000, 100);
+        sim.run(c, cfg, noisy);
+        t.assert_true("Noisy rate: few producer recreations", sim.recreations <= 2);
+        t.assert_true("Noisy rate: SLO respected after settling", sim.sloMisses <= 1);
+    }
+}
+
+void test_shutdown_drain(TestRunner &t)
+{
+    std::cout << "\n🛑 Testing Bounded Shutdown Drain..." << std::endl;
+
+    // Unreachable broker: nothing can be acknowledged, so the deadline must
+    // hold and every record has to be accounted for as delivered or spilled
+    KafkaConfig kc;
+    kc.bootstrapServers = "127.0.0.1:1";
+    kc.lingerMs = 5;
+    const std::string spillPath = "/tmp/traffic_sdk_spill_test.ndjson";
+    std::remove(spillPath.c_str());
+
+    const int n = 200;
+    DeliveryCounters c;
+    auto start = std::chrono::steady_clock::now();
+    {
+        KafkaProducer producer(kc);
+        for (int i = 0; i < n; ++i)
+            producer.send("{\"i\":" + std::to_string(i) + "}");
+
+        std::FILE *spill = std::fopen(spillPath.c_str(), "ab");
+        producer.drain(std::chrono::steady_clock::now() + std::chrono::milliseconds(300), spill);
+        std::fclose(spill);
+        c = producer.counters();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::ifstream in(spillPath);
+    uint64_t lines = 0;
+    bool linesAreJson = true;
+    for (std::string line; std::getline(in, line); ++lines)
+        linesAreJson = linesAreJson && json::accept(line);
+    std::remove(spillPath.c_str());
+
+    t.assert_true("Drain: every record accounted for", c.delivered + c.spilled == n && c.purged == 0 && c.failed == 0);
+    t.assert_true("Drain: spill file holds spilled records", lines == c.spilled && linesAreJson);
+    t.assert_true("Drain: bounded by deadline", elapsed < std::chrono::seconds(3));
+
+    // Through the SDK: intake stops on request, the report accounts for every
+    // capture and later calls return it again
+    SdkConfig sc;
+    sc.kafka = kc;
+    sc.routes.enabled = false;
+    sc.spillPath = spillPath;
+    {
+        TrafficProcessorSdk sdk(sc);
+        RequestData req;
+        req.method = "POST";
+        req.path = "/payments";
+        ResponseData res;
+        res.status = 201;
+        for (int i = 0; i < 5; ++i)
+            sdk.capture(req, res);
+        sdk.requestShutdown();
+        sdk.capture(req, res);
+        t.assert_true("Shutdown: requestShutdown stops intake", sdk.captureAsync(req, res).status() == DeliveryStatus::Skipped);
+
+        auto begin = std::chrono::steady_clock::now();
+        ShutdownReport first = sdk.shutdown(std::chrono::milliseconds(200));
+        auto took = std::chrono::steady_clock::now() - begin;
+        t.assert_true("Shutdown: report counts every capture once",
+                      first.delivered + first.spilled == 5 && first.spilled == 5 && first.dropped == 0 && first.deadlineExceeded);
+        t.assert_true("Shutdown: bounded by its deadline", took < std::chrono::seconds(1) && first.elapsed < std::chrono::seconds(1));
+        ShutdownReport again = sdk.shutdown(std::chrono::milliseconds(200));
+        t.assert_true("Shutdown: repeated calls return the same report",
+                      again.toJson() == first.toJson() && sdk.shutdown().toJson() == first.toJson());
+    }
+    std::ifstream sdkSpill(spillPath);
+    uint64_t spilledRecords = 0;
+    for (std::string line; std::getline(sdkSpill, line); ++spilledRecords)
+        linesAreJson = linesAreJson && json::accept(line);
+    std::remove(spillPath.c_str());
+    t.assert_true("Shutdown: spilled captures in the spill file", spilledRecords == 5 && linesAreJson);
+
+    ShutdownReport report;
+    report.delivered = 7;
+    report.elapsed = std::chrono::milliseconds(12);
+    json j = report.toJson();
+    t.assert_true("Shutdown report serializes", j["delivered"] == 7 && j["elapsed_ms"] == 12 && j["deadline_exceeded"] == false);
+}
+
+// Writes Ethernet/IPv4/TCP frames into a classic pcap file
+struct PcapBuilder
+{
+    std::ofstream out;
+    uint64_t tsUs = 1'700'000'000'000'000ULL;
+
+    explicit PcapBuilder(const std::string &path) : out(path, std::ios::binary)
+    {
+        uint32_t header[6] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    }
+
+    void packet(uint8_t client, bool toServer, uint32_t seq, uint8_t flags, const std::string &payload, uint64_t advanceUs = 1000)
+    {
+        tsUs += advanceUs;
+        const uint8_t clientIp[4] = {10, 0, 0, client};
+        const uint8_t serverIp[4] = {10, 0, 0, 1};
+        const uint16_t clientPort = static_cast<uint16_t>(40000 + client), serverPort = 8080;
+
+        std::string f(14, '\0');
+        f[12] = 0x08; // IPv4
+        std::string ip(20, '\0');
+        ip[0] = 0x45;
+        size_t total = 20 + 20 + payload.size();
+        ip[2] = static_cast<char>(total >> 8);
+        ip[3] = static_cast<char>(total & 0xff);
+        ip[8] = 64;
+        ip[9] = 6;
+        std::memcpy(&ip[12], toServer ? clientIp : serverIp, 4);
+        std::memcpy(&ip[16], toServer ? serverIp : clientIp, 4);
+        std::string tcp(20, '\0');
+        uint16_t sp = toServer ? clientPort : serverPort, dp = toServer ? serverPort : clientPort;
+        tcp[0] = static_cast<char>(sp >> 8);
+        tcp[1] = static_cast<char>(sp & 0xff);
+        tcp[2] = static_cast<char>(dp >> 8);
+        tcp[3] = static_cast<char>(dp & 0xff);
+        for (int i = 0; i < 4; ++i)
+            tcp[4 + i] = static_cast<char>(seq >> (24 - 8 * i));
+        tcp[12] = 0x50;
+        tcp[13] = static_cast<char>(flags);
+        f += ip + tcp + payload;
+
+        uint32_t rec[4] = {static_cast<uint32_t>(tsUs / 1'000'000), static_cast<uint32_t>(tsUs % 1'000'000),
+                           static_cast<uint32_t>(f.size()), static_cast<uint32_t>(f.size())};
+        out.write(reinterpret_cast<const char *>(rec), sizeof(rec));
+        out.write(f.data(), static_cast<std::streamsize>(f.size()));
+    }
+};
+
+void test_passive_capture(TestRunner &t)
+{
+    std::cout << "\n📡 Testing Passive Capture (pcap replay)..." << std::endl;
+
+    // Parser fed one byte at a time: pipelined chunked and sized messages
+    {
+        const std::string stream =
+            "HTTP/1.1 100 Continue\r\n\r\n"
+            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n4;ext=1\r\nWiki\r\n5\r\npedia\r\n0\r\nX-Trailer: y\r\n\r\n"
+            "HTTP/1.1 404 Not Found\r\nContent-Length: 3\r\n\r\nnop";
+        HttpStreamParser parser(HttpStreamParser::Kind::Response);
+        std::vector<HttpMessage> out;
+        for (size_t i = 0; i < stream.size(); ++i)
+            parser.feed(stream.data() + i, 1, i, out);
+        t.assert_true("Parser: interim response skipped", out.size() == 2);
+        t.assert_true("Parser: chunked body decoded", out.size() == 2 && out[0].status == 200 && out[0].body == "Wikipedia");
+        t.assert_true("Parser: pipelined sized body", out.size() == 2 && out[1].status == 404 && out[1].body == "nop");
+        t.assert_true("Parser: timestamps span message", out.size() == 2 && out[1].firstByteNs < out[1].lastByteNs);
+
+        HttpStreamParser bad(HttpStreamParser::Kind::Request);
+        t.assert_true("Parser: rejects non-HTTP", !bad.feed("\x16\x03\x01\x02\x00\r\n\r\n", 9, 0, out) && bad.failed());
+    }
+
+    const std::string path = "/tmp/traffic_sdk_capture_test.pcap";
+    {
+        PcapBuilder pcap(path);
+        // Client .2: handshake, two pipelined requests; the second request
+        // arrives out of order and partly retransmitted
+        pcap.packet(2, true, 1000, TcpSegment::Syn, "");
+        pcap.packet(2, false, 5000, TcpSegment::Syn | TcpSegment::Ack, "");
+        const std::string req1 = "GET /users/42?expand=true HTTP/1.1\r\nHost: api.local\r\n\r\n";
+        const std::string req2a = "POST /orders HTTP/1.1\r\nHost: api.local\r\nContent-Length: 11\r\n\r\nhello";
+        const std::string req2b = " world";
+        uint32_t cseq = 1001;
+        pcap.packet(2, true, cseq, TcpSegment::Ack, req1);
+        pcap.packet(2, true, cseq + req1.size() + req2a.size(), TcpSegment::Ack, req2b); // ahead of a gap
+        pcap.packet(2, true, cseq + req1.size(), TcpSegment::Ack, req2a);
+        pcap.packet(2, true, cseq + req1.size(), TcpSegment::Ack, req2a); // retransmission
+        const std::string res1 = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 9\r\n\r\n{\"id\":42}";
+        const std::string res2 = "HTTP/1.1 201 Created\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nok\r\n0\r\n\r\n";
+        uint32_t sseq = 5001;
+        pcap.packet(2, false, sseq, TcpSegment::Ack, res1.substr(0, 20), 25000);
+        pcap.packet(2, false, sseq + 20, TcpSegment::Ack, res1.substr(20) + res2);
+        uint32_t cend = cseq + static_cast<uint32_t>(req1.size() + req2a.size() + req2b.size());
+        uint32_t send = sseq + static_cast<uint32_t>(res1.size() + res2.size());
+        pcap.packet(2, true, cend, TcpSegment::Fin | TcpSegment::Ack, "");
+        pcap.packet(2, false, send, TcpSegment::Fin | TcpSegment::Ack, "");
+
+        // Client .3 joins mid-stream: HEAD, then a close-delimited response
+        const std::string head = "HEAD /health HTTP/1.1\r\nHost: api.local\r\n\r\n";
+        const std::string get = "GET /stream HTTP/1.1\r\nHost: api.local\r\n\r\n";
+        pcap.packet(3, true, 7000, TcpSegment::Ack, head + get);
+        const std::string headRes = "HTTP/1.1 200 OK\r\nContent-Length: 1234\r\n\r\n";
+        const std::string closeRes = "HTTP/1.0 200 OK\r\n\r\nuntil close";
+        pcap.packet(3, false, 9000, TcpSegment::Ack, headRes + closeRes);
+        pcap.packet(3, false, 9000 + static_cast<uint32_t>(headRes.size() + closeRes.size()), TcpSegment::Fin | TcpSegment::Ack, "");
+
+        // Client .4 speaks TLS to the HTTP port
+        pcap.packet(4, true, 100, TcpSegment::Ack, std::string("\x16\x03\x01\x00\x05hello", 10));
+    }
+
+    std::vector<std::pair<RequestData, ResponseData>> pairs;
+    CaptureConfig cfg;
+    cfg.pcapPath = path;
+    cfg.tracker.ports = {8080};
+    PacketCapture capture(cfg, [&pairs](const RequestData &req, const ResponseData &res)
+                          { pairs.emplace_back(req, res); });
+    capture.run();
+    json stats = capture.stats();
+    std::remove(path.c_str());
+
+    auto find = [&pairs](const std::string &method, const std::string &path) -> const std::pair<RequestData, ResponseData> *
+    {
+        for (const auto &p : pairs)
+            if (p.first.method == method && p.first.path.rfind(path, 0) == 0)
+                return &p;
+        return nullptr;
+    };
+    const auto *get = find("GET", "/users/42");
+    const auto *post = find("POST", "/orders");
+    const auto *headPair = find("HEAD", "/health");
+    const auto *stream = find("GET", "/stream");
+
+    t.assert_true("Capture: all exchanges paired", pairs.size() == 4 && stats["pairs"] == 4);
+    t.assert_true("Capture: request line and host", get && get->first.path == "/users/42?expand=true" &&
+                                                        get->first.host == "api.local" && get->first.ip == "10.0.0.2");
+    t.assert_true("Capture: response body", get && get->second.status == 200 && get->second.bodyText == "{\"id\":42}" &&
+                                                get->second.headers["Content-Type"] == "application/json");
+    t.assert_true("Capture: latency from packet timestamps", get && get->second.endNs - get->first.startNs >= 25'000'000ULL);
+    t.assert_true("Capture: reordered request reassembled", post && post->first.bodyText == "hello world");
+    t.assert_true("Capture: chunked response paired", post && post->second.status == 201 && post->second.bodyText == "ok");
+    t.assert_true("Capture: HEAD response has no body", headPair && headPair->second.bodyText.empty());
+    t.assert_true("Capture: close-delimited body", stream && stream->second.bodyText == "until close");
+    t.assert_true("Capture: reordering counted", stats["out_of_order"] == 1 && stats["retransmits"] == 1);
+    t.assert_true("Capture: non-HTTP flow rejected", stats["parse_errors"] == 1);
+}
+
+void test_record_view(TestRunner &t)
+{
+    std::cout << "\n🔎 Testing Lazy Record View..." << std::endl;
+
+    SdkConfig config;
+    config.accountId = "acct-9";
+    RequestData req;
+    req.method = "POST";
+    req.path = "/orders/17";
+    req.query = "a=1";
+    req.headers = json{{"Content-Type", "application/json"}, {"X-Note", "tab\there \"quoted\" \\u00e9"}};
+    req.bodyText = "{\"id\":17,\"tags\":[\"x\",{\"y\":\"}\"}]}";
+    req.startNs = 1'000'000'000;
+    ResponseData res;
+    res.status = 201;
+    res.headers = json{{"Location", "/orders/17"}};
+    res.bodyText = "caf\xc3\xa9 \xf0\x9f\x98\x80";
+    res.endNs = 1'042'000'000;
+    const std::string record = createTrafficJson(config, req, res).dump();
+
+    RecordView v(record);
+    t.assert_true("View: valid record", v.valid());
+    t.assert_eq("View: account id", "acct-9", std::string(v.accountId()));
+    t.assert_eq("View: latency", 42, static_cast<int>(v.latencyMs()));
+    t.assert_eq("View: method", "POST", std::string(v.request().method()));
+    t.assert_eq("View: path", "/orders/17", std::string(v.request().path()));
+    t.assert_eq("View: header lookup is case-insensitive", "application/json", std::string(v.request().header("content-type")));
+    t.assert_eq("View: escaped header decoded", "tab\there \"quoted\" \\u00e9", std::string(v.request().header("X-Note")));
+    t.assert_eq("View: nested body kept verbatim", req.bodyText, std::string(v.request().bodyText()));
+    t.assert_eq("View: status", 201, v.response().status());
+    t.assert_eq("View: UTF-8 body", res.bodyText, std::string(v.response().bodyText()));
+    t.assert_true("View: missing header is empty", v.response().header("X-Missing").empty());
+    t.assert_true("View: raw member", v.raw("timestamp") == "1234567890");
+
+    RequestData back = v.toRequestData();
+    t.assert_true("View: RequestData round trip", back.method == req.method && back.path == req.path && back.headers == req.headers && back.bodyText == req.bodyText);
+    t.assert_eq("View: ResponseData round trip", 201, v.toResponseData().status);
+
+    json esc = {{"account_id", "a"}, {"timestamp", 1}, {"request", {{"path", "/\xe2\x82\xac\x01"}}}};
+    const std::string escaped = esc.dump(-1, ' ', true); // \u escapes only
+    v.reset(escaped);
+    t.assert_eq("View: \\u escapes decoded", "/\xe2\x82\xac\x01", std::string(v.request().path()));
+    t.assert_eq("View: latency absent", -1, static_cast<int>(v.latencyMs()));
+    t.assert_true("View: absent section", !v.response().present() && v.response().status() == 0);
+
+    v.reset("{\"account_id\":\"a\",\"request\":{\"path\":\"/x\"");
+    t.assert_true("View: truncated record rejected", !v.valid() || v.request().path().empty());
+    v.reset("[1,2]");
+    t.assert_true("View: non-object rejected", !v.valid());
+
+    std::vector<std::string_view> parts;
+    t.assert_true("Split: single object", splitRecords(record, parts) && parts.size() == 1 && parts[0] == record);
+    parts.clear();
+    const std::string ndjson = record + "\n" + record + "\n\n" + record + "\n";
+    t.assert_true("Split: NDJSON", splitRecords(ndjson, parts) && parts.size() == 3);
+    parts.clear();
+    const std::string array = "[" + record + " , " + record + "]";
+    t.assert_true("Split: array", splitRecords(array, parts) && parts.size() == 2 && parts[1] == record);
+    parts.clear();
+    t.assert_true("Split: garbage keeps leading records", !splitRecords(record + "\n{\"a\":", parts) && parts.size() == 1);
+}
+
+void test_consumer(TestRunner &t)
+{
+    std::cout << "\n📥 Testing Partition-Parallel Consumer..." << std::endl;
+
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string topic = "http.traffic.consumer_test";
+    rd_kafka_mock_topic_create(cluster, topic.c_str(), 4, 1);
+
+    SdkConfig config;
+    config.accountId = "acct-c";
+    auto record = [&](int i)
+    {
+        RequestData req;
+        req.method = "GET";
+        req.path = "/items/" + std::to_string(i);
+        ResponseData res;
+        res.status = 200 + i % 3;
+        return createTrafficJson(config, req, res).dump();
+    };
+
+    // 20 single-record messages, one NDJSON batch of 3 and one array of 2
+    const int expected = 25;
+    {
+        KafkaConfig kc;
+        kc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+        kc.topic = topic;
+        KafkaProducer producer(kc);
+        for (int i = 0; i < 20; ++i)
+            producer.send(record(i));
+        producer.send(record(20) + "\n" + record(21) + "\n" + record(22) + "\n");
+        producer.send("[" + record(23) + "," + record(24) + "]");
+        producer.flush();
+    }
+
+    ConsumerConfig cc;
+    cc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cc.groupId = "consumer-test";
+    cc.topics = {topic};
+    cc.workers = 3;
+    cc.batchSize = 4;
+    cc.commitEveryMessages = 5;
+
+    std::mutex mu;
+    std::vector<int> seen;
+    std::map<int32_t, int64_t> lastOffset;
+    std::atomic<bool> ordered{true};
+    std::atomic<int> count{0};
+    ConsumerStats stats;
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &r, const RecordMeta &meta)
+                                 {
+            std::lock_guard<std::mutex> lock(mu);
+            auto it = lastOffset.find(meta.partition);
+            if (it != lastOffset.end() && it->second > meta.offset)
+                ordered = false;
+            lastOffset[meta.partition] = meta.offset;
+            std::string_view path = r.request().path();
+            if (r.accountId() == "acct-c" && path.substr(0, 7) == "/items/")
+                seen.push_back(std::stoi(std::string(path.substr(7))));
+            if (r.response().status() != 200 + seen.back() % 3)
+                ordered = false;
+            ++count; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (count < expected && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        consumer.stop();
+        runner.join();
+        stats = consumer.stats();
+    }
+
+    std::sort(seen.begin(), seen.end());
+    bool all = seen.size() == static_cast<size_t>(expected);
+    for (int i = 0; all && i < expected; ++i)
+        all = seen[i] == i;
+    t.assert_true("Consumer: every record decoded once", all);
+    t.assert_true("Consumer: per-partition order kept", ordered.load());
+    t.assert_eq("Consumer: messages counted", 22, static_cast<int>(stats.messages));
+    t.assert_eq("Consumer: records counted", expected, static_cast<int>(stats.records));
+    t.assert_true("Consumer: offsets committed", stats.commits >= 1 && stats.commitErrors == 0 && stats.malformed == 0);
+
+    // A second member of the same group resumes after the committed offsets
+    std::atomic<int> replayed{0};
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &, const RecordMeta &)
+                                 { ++replayed; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        consumer.stop();
+        runner.join();
+    }
+    t.assert_eq("Consumer: committed offsets not replayed", 0, replayed.load());
+
+    // A batch touching one partition must not clobber the offset stored for
+    // another by an earlier batch; everything is committed only at stop
+    const std::string pair = "http.traffic.consumer_pair";
+    rd_kafka_mock_topic_create(cluster, pair.c_str(), 2, 1);
+    rd_kafka_conf_t *pconf = rd_kafka_conf_new();
+    rd_kafka_conf_set(pconf, "bootstrap.servers", rd_kafka_mock_cluster_bootstraps(cluster), errstr, sizeof(errstr));
+    rd_kafka_t *raw = rd_kafka_new(RD_KAFKA_PRODUCER, pconf, errstr, sizeof(errstr));
+    auto sendTo = [&](int32_t partition, int i)
+    {
+        std::string payload = record(i);
+        rd_kafka_producev(raw, RD_KAFKA_V_TOPIC(pair.c_str()), RD_KAFKA_V_PARTITION(partition),
+                          RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+                          RD_KAFKA_V_VALUE(payload.data(), payload.size()), RD_KAFKA_V_END);
+        rd_kafka_flush(raw, 1000);
+    };
+    ConsumerConfig pc = cc;
+    pc.groupId = "consumer-pair-test";
+    pc.topics = {pair};
+    pc.workers = 1;
+    pc.commitEveryMessages = 1000;
+    pc.commitIntervalMs = 60000;
+    std::atomic<int> handled{0};
+    auto waitFor = [&](int n)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (handled < n && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    };
+    {
+        TrafficConsumer consumer(pc, [&](const RecordView &, const RecordMeta &)
+                                 { ++handled; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        sendTo(0, 0);
+        sendTo(1, 1);
+        waitFor(2);
+        for (int i = 2; i < 5; ++i)
+            sendTo(0, i);
+        waitFor(5);
+        consumer.stop();
+        runner.join();
+    }
+    replayed = 0;
+    {
+        TrafficConsumer consumer(pc, [&](const RecordView &, const RecordMeta &)
+                                 { ++replayed; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        consumer.stop();
+        runner.join();
+    }
+    t.assert_eq("Consumer: two-partition batches handled", 5, handled.load());
+    t.assert_eq("Consumer: untouched partition keeps its stored offset", 0, replayed.load());
+    rd_kafka_destroy(raw);
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+}
+
+void test_streaming_analytics(TestRunner &t)
+{
+    std::cout << "\n📈 Testing Streaming Analytics Sketches..." << std::endl;
+
+    HyperLogLog a(12), b(12);
+    for (int i = 0; i < 60000; ++i)
+        a.add(hash64("10.0." + std::to_string(i)));
+    for (int i = 40000; i < 100000; ++i)
+        b.add(hash64("10.0." + std::to_string(i)));
+    a.merge(b);
+    double hllError = std::abs(static_cast<double>(a.estimate()) - 100000.0) / 100000.0;
+    t.assert_true("HLL: merged distinct count within 5%", hllError < 0.05);
+    HyperLogLog small(12);
+    for (int i = 0; i < 3; ++i)
+        small.add(hash64("same"));
+    small.add(hash64("other"));
+    t.assert_eq("HLL: small cardinality exact", 2, static_cast<int>(small.estimate()));
+
+    // Zipf-like keys split over two summaries, merged
+    HeavyHitters left(10, 1024, 4), right(10, 1024, 4);
+    for (int k = 0; k < 500; ++k)
+    {
+        int freq = 2000 / (k + 1);
+        for (int i = 0; i < freq; ++i)
+            ((i + k) % 2 ? left : right).add("/route/" + std::to_string(k));
+    }
+    left.merge(right);
+    auto top = left.top(3);
+    t.assert_true("Heavy hitters: top keys found after merge",
+                  top.size() == 3 && top[0].key == "/route/0" && top[1].key == "/route/1" && top[2].key == "/route/2");
+    t.assert_true("Count-Min: never undercounts", top[0].count >= 2000 && left.sketch().estimate(hash64("/route/3")) >= 500);
+
+    TDigest d1(100), d2(100);
+    for (int i = 1; i <= 50000; ++i)
+    {
+        d1.add(i);
+        d2.add(50000 + i);
+    }
+    d1.merge(d2);
+    t.assert_true("t-digest: median within 1%", std::abs(d1.quantile(0.5) - 50000) < 1000);
+    t.assert_true("t-digest: p99 within 0.2%", std::abs(d1.quantile(0.99) - 99000) < 200);
+    t.assert_true("t-digest: extremes exact", d1.quantile(0) == 1 && d1.quantile(1) == 100000 && d1.count() == 100000);
+
+    EwmaBurstDetector detector(0.2, 4.0, 10, 3);
+    bool falseAlarm = false;
+    for (int w = 0; w < 20; ++w)
+        falseAlarm = detector.update(5 + w % 3) || falseAlarm;
+    t.assert_true("EWMA: steady series does not alarm", !falseAlarm);
+    t.assert_true("EWMA: jump flagged as burst", detector.update(60) && detector.score() > 4);
+
+    // Concurrent observers on a sharded engine
+    AnalyticsConfig ac;
+    ac.shards = 4;
+    ac.windowMs = 0;
+    ac.topK = 3;
+    ac.burstWarmupWindows = 2;
+    TrafficAnalytics analytics(ac);
+    auto window = [&](int errorsPerThread)
+    {
+        std::vector<std::thread> threads;
+        for (int th = 0; th < 4; ++th)
+            threads.emplace_back([&, th]
+                                 {
+                for (int i = 0; i < 2500; ++i)
+                {
+                    RequestData req;
+                    req.method = "GET";
+                    req.host = i % 2 ? "api" : "web";
+                    req.path = i % 10 == 0 ? "/search?q=x" : "/items/<int>";
+                    req.ip = "192.168." + std::to_string(th) + "." + std::to_string(i % 50);
+                    req.startNs = 1'000'000;
+                    ResponseData res;
+                    res.status = i < errorsPerThread && req.host == "api" ? 503 : 200;
+                    res.endNs = req.startNs + static_cast<uint64_t>(1 + i % 100) * 1'000'000;
+                    analytics.observe(req, res);
+                } });
+        for (auto &th : threads)
+            th.join();
+        return analytics.snapshot();
+    };
+    AnalyticsSnapshot snap;
+    for (int w = 0; w < 4; ++w)
+        snap = window(8);
+    t.assert_true("Analytics: no burst on steady errors", snap.bursts.empty());
+    t.assert_eq("Analytics: records merged across shards", 10000, static_cast<int>(snap.records));
+    t.assert_true("Analytics: top route", !snap.topRoutes.empty() && snap.topRoutes[0].key == "GET /items/<int>" && snap.topRoutes[0].count >= 9000);
+    t.assert_true("Analytics: unique clients", snap.uniqueClients >= 190 && snap.uniqueClients <= 210);
+    t.assert_true("Analytics: unique clients per host", snap.uniqueClientsByHost.size() == 2 && snap.uniqueClientsByHost["api"] >= 95 && snap.uniqueClientsByHost["api"] <= 105);
+    t.assert_true("Analytics: latency quantiles per status",
+                  snap.latencyByStatus.count(200) && snap.latencyByStatus.count(503) && std::abs(snap.latencyByStatus[200].p50 - 50) < 3 && snap.latencyByStatus[200].max == 100);
+
+    snap = window(400);
+    bool apiBurst = false;
+    for (const auto &bst : snap.bursts)
+        apiBurst = apiBurst || (bst.host == "api" && bst.errors == 800);
+    t.assert_true("Analytics: 5xx burst detected on host", apiBurst && snap.serverErrors == 800);
+    json sj = snap.toJson();
+    t.assert_true("Analytics: snapshot serializes", sj["records"] == 10000 && sj["latency_by_status"].contains("503") && sj["bursts"].size() >= 1);
+    t.assert_eq("Analytics: window closed on snapshot", 0, static_cast<int>(analytics.snapshot().records));
+}
+
+void test_columnar_segments(TestRunner &t)
+{
+    std::cout << "\n🧱 Testing Columnar Segments..." << std::endl;
+
+    const std::string path = "/tmp/traffic_sdk_columnar_test.tpcol";
+    std::vector<ColumnarRow> written;
+    for (int i = 0; i < 2500; ++i)
+    {
+        ColumnarRow r;
+        r.timestamp = 1760000000 + i / 7;
+        r.accountId = "acct";
+        r.method = i % 5 == 0 ? "POST" : "GET";
+        r.scheme = "https";
+        r.host = "host" + std::to_string(i % 3) + ".example.com";
+        r.path = "/items/" + std::to_string(i);
+        r.query = i % 4 == 0 ? "page=" + std::to_string(i % 9) : "";
+        r.routeTemplate = "/items/{id}";
+        r.clientIp = "10.0.0." + std::to_string(i % 40);
+        r.status = i % 50 == 0 ? 503 : (i % 11 == 0 ? 404 : 200);
+        r.latencyMs = i % 13 == 0 ? -1 : i % 300;
+        r.requestHeaders = "{\"accept\":\"*/*\"}";
+        r.requestBody = i % 2 ? "" : "{\"n\":" + std::to_string(i) + "}";
+        r.responseHeaders = "{\"content-type\":\"application/json\"}";
+        r.responseBody = std::string(static_cast<size_t>(i % 17), 'x');
+        written.push_back(r);
+    }
+
+    ColumnarConfig cfg;
+    cfg.path = path;
+    cfg.rowGroupRows = 1000;
+    cfg.columnCompression[Column::Path] = ColumnCompression::None;
+    uint64_t segmentBytes = 0;
+    {
+        ColumnarWriter writer(cfg);
+        for (const auto &r : written)
+            writer.append(r);
+        writer.close();
+        segmentBytes = writer.bytesWritten();
+    }
+
+    ColumnarReader reader(path);
+    t.assert_eq("Columnar: row groups", 3, static_cast<int>(reader.rowGroups()));
+    t.assert_eq("Columnar: row count", 2500, static_cast<int>(reader.rows()));
+
+    std::vector<Column> all;
+    for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c)
+        all.push_back(static_cast<Column>(c));
+    auto rows = reader.readAll(all);
+    bool same = rows.size() == written.size();
+    for (size_t i = 0; same && i < rows.size(); ++i)
+    {
+        const ColumnarRow &a = rows[i], &b = written[i];
+        same = a.timestamp == b.timestamp && a.accountId == b.accountId && a.method == b.method && a.scheme == b.scheme &&
+               a.host == b.host && a.path == b.path && a.query == b.query && a.routeTemplate == b.routeTemplate &&
+               a.clientIp == b.clientIp && a.status == b.status && a.latencyMs == b.latencyMs &&
+               a.requestHeaders == b.requestHeaders && a.requestBody == b.requestBody &&
+               a.responseHeaders == b.responseHeaders && a.responseBody == b.responseBody;
+    }
+    t.assert_true("Columnar: every column round-trips across row groups", same);
+
+    std::vector<ColumnarRow> projected;
+    reader.read(1, {Column::Status, Column::LatencyMs}, projected);
+    t.assert_true("Columnar: projection reads only requested columns",
+                  projected.size() == 1000 && projected[0].status == written[1000].status &&
+                      projected[0].latencyMs == written[1000].latencyMs && projected[0].host.empty() && projected[0].timestamp == 0);
+    t.assert_true("Columnar: name lookup", columnFromName(columnName(Column::RouteTemplate)) == Column::RouteTemplate);
+
+    size_t jsonBytes = 0;
+    for (const auto &r : written)
+        jsonBytes += r.path.size() + r.host.size() + r.requestHeaders.size() + r.responseHeaders.size() + 120;
+    t.assert_true("Columnar: segment smaller than the JSON records", segmentBytes < jsonBytes / 2);
+
+    // A segment without its footer (writer never closed) is rejected
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 10));
+    }
+    bool rejected = false;
+    try
+    {
+        ColumnarReader truncated(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        rejected = true;
+    }
+    t.assert_true("Columnar: truncated segment rejected", rejected);
+    std::remove(path.c_str());
+
+    std::string record = json{{"account_id", "acct-1"},
+                              {"timestamp", 1760000123},
+                              {"request", {{"method", "PUT"}, {"scheme", "http"}, {"host", "api"}, {"path", "/users/7"}, {"query", "x=1"}, {"route_template", "/users/{id}"}, {"headers", {{"accept", "*/*"}}}, {"body", "{\"a\":1}"}, {"ip", "10.1.2.3"}}},
+                              {"response", {{"status", 204}, {"headers", json::object()}, {"body", ""}}},
+                              {"latency_ms", 42}}
+                             .dump();
+    ColumnarRow fromRecord = ColumnarRow::fromRecord(RecordView(record));
+    t.assert_true("Columnar: row built from a record view",
+                  fromRecord.accountId == "acct-1" && fromRecord.timestamp == 1760000123 && fromRecord.method == "PUT" &&
+                      fromRecord.routeTemplate == "/users/{id}" && fromRecord.clientIp == "10.1.2.3" && fromRecord.status == 204 &&
+                      fromRecord.latencyMs == 42 && json::parse(fromRecord.requestHeaders)["accept"] == "*/*" &&
+                      fromRecord.requestBody == "{\"a\":1}");
+
+    // Groups are also cut by size: 100 rows of ~1 KiB against a 16 KiB cap
+    ColumnarConfig capped;
+    capped.path = path;
+    capped.rowGroupBytes = 16 << 10;
+    {
+        ColumnarWriter writer(capped);
+        ColumnarRow big = fromRecord;
+        big.responseBody.assign(1000, 'b');
+        for (int i = 0; i < 100; ++i)
+            writer.append(big);
+    }
+    {
+        ColumnarReader groups(path);
+        t.assert_true("Columnar: row groups capped by bytes", groups.rowGroups() >= 6 && groups.rows() == 100);
+    }
+
+    // The exporter writes off the calling thread and counts what it refuses
+    uint64_t exported = 0, dropped = 0;
+    {
+        ColumnarExporter exporter(capped);
+        for (int i = 0; i < 50; ++i)
+            exporter.offer(record);
+        exporter.close();
+        t.assert_true("Columnar exporter: nothing offered after close", !exporter.offer(record));
+        exported = exporter.exported();
+        dropped = exporter.dropped();
+    }
+    ColumnarReader exportedSegment(path);
+    auto exportedRows = exportedSegment.readAll({Column::Method, Column::Status});
+    t.assert_true("Columnar exporter: every record written or counted as dropped",
+                  exported + dropped == 51 && exportedRows.size() == exported && exported >= 1 &&
+                      exportedRows[0].method == "PUT" && exportedRows[0].status == 204);
+    std::remove(path.c_str());
+}
+
+void test_body_dedup(TestRunner &t)
+{
+    std::cout << "\n🧬 Testing Body Deduplication..." << std::endl;
+
+    const std::string page(600, 'p');
+    BodyHash h = hashBody(page);
+    BodyHash parsed;
+    t.assert_true("Body hash: stable and content-sensitive", h == hashBody(std::string(600, 'p')) && !(h == hashBody(page + "!")) && !(h == hashBody(std::string(599, 'p'))));
+    t.assert_true("Body hash: hex round-trips", BodyHash::parse(h.hex(), parsed) && parsed == h && !BodyHash::parse("xyz", parsed) && !BodyHash::parse(std::string(32, 'g'), parsed));
+
+    BodyDedupConfig dc;
+    dc.minBytes = 64;
+    dc.capacity = 2;
+    dc.shards = 1;
+    BodyDeduplicator dedup(dc);
+    auto section = [](const std::string &body, const std::string &base64 = "")
+    {
+        return json{{"status", 200}, {"body", body}, {"body_b64", base64}};
+    };
+
+    json first = section(page), repeat = section(page), small = section("tiny");
+    std::string message;
+    bool shipped = dedup.apply(first, message);
+    t.assert_true("Dedup: first sighting ships the body as a body message",
+                  shipped && first["body"] == "" && first["body_ref"] == h.hex() && json::parse(message)["ref"] == h.hex() &&
+                      json::parse(message)["body"] == page);
+    auto occurrences = [&page](const std::string &s)
+    {
+        size_t n = 0;
+        for (size_t pos = s.find(page); pos != std::string::npos; pos = s.find(page, pos + page.size()))
+            ++n;
+        return n;
+    };
+    t.assert_eq("Dedup: a unique body is sent once across record and body message", 1,
+                static_cast<int>(occurrences(first.dump()) + occurrences(message)));
+    std::string none;
+    bool shippedAgain = dedup.apply(repeat, none);
+    t.assert_true("Dedup: repeat replaced by its reference",
+                  !shippedAgain && none.empty() && repeat["body"] == "" && repeat["body_b64"] == "" && repeat["body_ref"] == first["body_ref"]);
+    t.assert_true("Dedup: small bodies stay inline", !dedup.apply(small, none) && small["body"] == "tiny" && !small.contains("body_ref"));
+
+    json other1 = section(std::string(100, 'a')), other2 = section(std::string(100, 'b')), again = section(page);
+    dedup.apply(other1, none);
+    dedup.apply(other2, none);
+    t.assert_true("Dedup: evicted body is shipped again", dedup.apply(again, none) && dedup.size() == 2);
+    BodyDedupStats ds = dedup.stats();
+    t.assert_true("Dedup: stats", ds.bodies == 5 && ds.referenced == 1 && ds.shipped == 4 && ds.bytesSaved == page.size());
+    json binary = section("\x89PNG", std::string(120, 'Q'));
+    dedup.apply(binary, none);
+    t.assert_true("Dedup: base64 is the content address when present", binary["body_ref"] == hashBody(std::string(120, 'Q')).hex());
+
+    // Concurrent captures of one body ship it exactly once
+    BodyDedupConfig concurrentCfg;
+    concurrentCfg.minBytes = 16;
+    BodyDeduplicator shared(concurrentCfg);
+    std::atomic<int> ships{0};
+    std::vector<std::thread> threads;
+    for (int th = 0; th < 4; ++th)
+        threads.emplace_back([&]
+                             {
+            for (int i = 0; i < 500; ++i)
+            {
+                json s = section("{\"error\":\"not found\",\"code\":" + std::to_string(i % 10) + "}");
+                std::string m;
+                if (shared.apply(s, m))
+                    ++ships;
+            } });
+    for (auto &th : threads)
+        th.join();
+    t.assert_eq("Dedup: concurrent repeats shipped once per body", 10, ships.load());
+
+    // Resolver: body topic messages and inline bodies next to a reference
+    BodyResolver resolver(16, 2);
+    t.assert_true("Resolver: body message accepted", resolver.add(message) && resolver.find(h.hex()) && resolver.find(h.hex())->text == page);
+    json tampered = json::parse(message);
+    tampered["body"] = "forged";
+        t.assert_true("Resolver: body not matching its reference rejected", !resolver.add(tampered.dump()) && !resolver.add("{\"ref\":1}"));
+
+    std::string referencing = json{{"account_id", "a"}, {"timestamp", 1}, {"request", json::object()}, {"response", repeat}}.dump();
+    RecordView view(referencing);
+    auto resolved = resolver.body(view.response());
+    t.assert_true("Resolver: reference resolved", view.response().bodyRef() == h.hex() && resolved && resolved->text == page && resolved->base64.empty());
+    json inlineSection = section(std::string(100, 'z'));
+    BodyDedupConfig noTopic = dc;
+    noTopic.topic.clear();
+    BodyDeduplicator fresh(noTopic);
+    std::string unsent;
+    t.assert_true("Dedup: without a body topic bodies stay inline",
+                  !fresh.apply(inlineSection, unsent) && unsent.empty() && inlineSection["body"] == std::string(100, 'z') &&
+                      inlineSection.contains("body_ref"));
+    std::string inlined = json{{"request", json::object()}, {"response", inlineSection}}.dump();
+    view.reset(inlined);
+    std::string ref(view.response().bodyRef());
+    t.assert_true("Resolver: inline body remembered", resolver.body(view.response()) && resolver.find(ref) && resolver.find(ref)->text == std::string(100, 'z'));
+    t.assert_true("Resolver: unknown reference", !resolver.find(hashBody("missing").hex()));
+
+    // End to end through a cluster: the consumer fills the resolver from the
+    // body topic and hands only records to the handler
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string topic = "http.traffic.dedup_test";
+    const std::string bodyTopic = "http.traffic.dedup_test.bodies";
+    rd_kafka_mock_topic_create(cluster, topic.c_str(), 1, 1);
+    rd_kafka_mock_topic_create(cluster, bodyTopic.c_str(), 1, 1);
+    SdkConfig config;
+    BodyDeduplicator producerSide(dc);
+    size_t recordBytes = 0, fullBytes = 0;
+    {
+        KafkaConfig kc;
+        kc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+        kc.topic = topic;
+        KafkaProducer producer(kc);
+        for (int i = 0; i < 10; ++i)
+        {
+            RequestData req;
+            req.method = "GET";
+            req.path = "/missing/" + std::to_string(i);
+            ResponseData res;
+            res.status = 404;
+            res.bodyText = page;
+            json j = createTrafficJson(config, req, res);
+            fullBytes += j.dump().size();
+            std::string m;
+            if (producerSide.apply(j["response"], m))
+                producer.send(m, bodyTopic, j["response"]["body_ref"].get<std::string>());
+            std::string rec = j.dump();
+            recordBytes += rec.size();
+            producer.send(rec);
+        }
+        producer.flush();
+    }
+    t.assert_true("Dedup: bodies left out of records", recordBytes + 10 * page.size() <= fullBytes + 10 * 64);
+
+    BodyResolver consumerBodies;
+    ConsumerConfig cc;
+    cc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cc.groupId = "dedup-test";
+    cc.topics = {topic};
+    cc.bodies = &consumerBodies;
+    cc.bodyTopic = bodyTopic;
+    cc.workers = 2;
+    std::atomic<int> records{0};
+    std::atomic<int> referencedRecords{0};
+    ConsumerStats stats;
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &r, const RecordMeta &)
+                                 {
+            if (!r.response().bodyRef().empty() && r.response().bodyText().empty())
+                ++referencedRecords;
+            ++records; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while ((records < 10 || consumerBodies.size() < 1) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        consumer.stop();
+        runner.join();
+        stats = consumer.stats();
+    }
+    t.assert_true("Consumer: body topic feeds the resolver, not the handler",
+                  records == 10 && referencedRecords == 10 && stats.bodies == 1 && consumerBodies.find(h.hex()) && consumerBodies.find(h.hex())->text == page);
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+
+    // A body message Kafka never took is shipped again with its next record
+    SdkConfig lossy;
+    lossy.kafka.bootstrapServers = "127.0.0.1:1";
+    lossy.kafka.closeFlushTimeoutMs = 10;
+    lossy.routes.enabled = false;
+    lossy.bodyDedup.enabled = true;
+    lossy.bodyDedup.minBytes = 64;
+    {
+        TrafficProcessorSdk sdk(lossy);
+        RequestData req;
+        req.method = "GET";
+        req.path = "/lost";
+        ResponseData res;
+        res.status = 200;
+        res.bodyText = page;
+        res.bodyBase64 = std::string(800, 'Q'); // the content address
+        sdk.capture(req, res);
+        sdk.shutdown(std::chrono::milliseconds(50));
+        t.assert_true("Dedup: undelivered body message forgotten", sdk.bodyDedup()->shouldShip(hashBody(res.bodyBase64)));
+    }
+}
+
+void test_record_schema(TestRunner &t)
+{
+    std::cout << "\n📐 Testing Compile-Time Record Schemas..." << std::endl;
+
+    static_assert(RecordSchema<fields::Metadata>::has(fields::Status) && !RecordSchema<fields::Metadata>::any(fields::Bodies));
+
+    RequestData req;
+    req.method = "POST";
+    req.scheme = "https";
+    req.host = "api";
+    req.path = "/orders/7?expand=items";
+    req.headers = {{"accept", "*/*"}};
+    req.bodyText = "{\"n\":1}";
+    req.ip = "10.0.0.1";
+    req.startNs = 1'000'000;
+    ResponseData res;
+    res.status = 201;
+    res.headers = {{"content-type", "application/json"}};
+    res.bodyText = "created";
+    res.endNs = 8'000'000;
+    CapturePolicy policy;
+
+    json full = buildRecord<fields::All>("acct", req, res, policy, nullptr);
+    t.assert_true("Schema: all fields recorded",
+                  full["request"].size() == 10 && full["response"].size() == 4 && full["latency_ms"] == 7 &&
+                      full["request"]["query_params"]["expand"] == "items" && full["request"]["body_b64"] == "eyJuIjoxfQ==");
+
+    json templated = buildRecord<fields::Metadata | fields::RouteTemplate>("acct", req, res, policy, std::string_view("/orders/{id}"));
+    req.routeTemplate = "/orders/{order}";
+    json given = buildRecord<fields::Metadata | fields::RouteTemplate>("acct", req, res, policy, std::string_view("/orders/{id}"));
+    req.routeTemplate.clear();
+    t.assert_true("Schema: normalized route passed in, the request's own first",
+                  templated["request"]["route_template"] == "/orders/{id}" && given["request"]["route_template"] == "/orders/{order}");
+
+    json meta = buildRecord<fields::Metadata>("acct", req, res, policy, nullptr);
+    t.assert_true("Schema: metadata only",
+                  meta["request"] == json({{"method", "POST"}, {"path", "/orders/7"}}) && meta["response"] == json({{"status", 201}}) &&
+                      meta["latency_ms"] == 7 && meta["account_id"] == "acct" && meta.contains("timestamp"));
+
+    json noBodies = buildRecord<fields::All & ~fields::Bodies & ~fields::Latency>("acct", req, res, policy, nullptr);
+    t.assert_true("Schema: excluded fields absent",
+                  !noBodies["request"].contains("body") && !noBodies["response"].contains("body_b64") && !noBodies.contains("latency_ms") &&
+                      noBodies["request"]["headers"]["accept"] == "*/*");
+
+    // Records with absent fields still decode; missing members read as defaults
+    std::string serialized = meta.dump();
+    RecordView view(serialized);
+    t.assert_true("Schema: partial record readable", view.valid() && view.request().method() == "POST" && view.request().host().empty() && view.response().status() == 201 && view.latencyMs() == 7);
+}
+
+void test_topic_routing(TestRunner &t)
+{
+    std::cout << "\n🔀 Testing Tiered Topic Routing..." << std::endl;
+
+    std::vector<TopicRule> rules(2);
+    rules[0].topic = "http.traffic.errors";
+    rules[0].minStatus = 500;
+    rules[1].topic = "http.traffic.admin";
+    rules[1].routePrefix = "/admin/";
+    rules[1].methods = {"POST", "DELETE"};
+    auto record = [](const std::string &method, const std::string &path, int status)
+    {
+        return json{{"account_id", "acct"},
+                    {"timestamp", 1760000000},
+                    {"request", {{"method", method}, {"path", path}, {"route_template", path}, {"body", "{\"q\":1}"}, {"body_b64", "eyJxIjoxfQ=="}}},
+                    {"response", {{"status", status}, {"body", ""}, {"body_b64", ""}}}};
+    };
+    const TopicRule *r500 = matchTopicRule(rules, record("GET", "/users/{id}", 503));
+    const TopicRule *rAdmin = matchTopicRule(rules, record("DELETE", "/admin/users/{id}", 204));
+    t.assert_true("Routing: first matching rule wins",
+                  r500 && r500->topic == "http.traffic.errors" && rAdmin && rAdmin->topic == "http.traffic.admin" &&
+                      matchTopicRule(rules, record("POST", "/admin/users", 500)) == r500);
+    t.assert_true("Routing: unmatched records keep the default topic",
+                  !matchTopicRule(rules, record("GET", "/admin/users", 200)) && !matchTopicRule(rules, record("POST", "/users", 201)) &&
+                      !matchTopicRule({}, record("GET", "/", 500)));
+
+    json j = record("POST", "/orders", 201);
+    json bodies = splitRecordBodies(j, "0123456789abcdef0123456789abcdef");
+    t.assert_true("Routing: bodies moved to the body record",
+                  !j["request"].contains("body") && !j["response"].contains("body_b64") && j["request"]["method"] == "POST" &&
+                      bodies["record_id"] == "0123456789abcdef0123456789abcdef" && bodies["account_id"] == "acct" &&
+                      bodies["request"]["body"] == "{\"q\":1}" && bodies["response"]["body"] == "");
+    json empty = record("GET", "/", 204);
+    empty["request"]["body"] = "";
+    empty["request"]["body_b64"] = "";
+    t.assert_true("Routing: no body record without bodies", splitRecordBodies(empty, "id").is_null() && !empty["request"].contains("body"));
+
+    // Per-topic producer settings on a cluster: overridden topics share the
+    // connections matching their settings
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string hot = "http.traffic.routing_test";
+    const std::string cold = "http.traffic.routing_test.payloads";
+    const std::string errors = "http.traffic.routing_test.errors";
+    for (const auto &topic : {hot, cold, errors})
+        rd_kafka_mock_topic_create(cluster, topic.c_str(), 2, 1);
+    KafkaConfig kc;
+    kc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    kc.topic = hot;
+    kc.lingerMs = 1;
+    kc.topics[cold].compression = "zstd";
+    kc.topics[cold].lingerMs = 50;
+    kc.topics[cold].batchSizeBytes = 4 * 1024 * 1024;
+    kc.topics[errors].acks = "all";
+    DeliveryCounters counters;
+    {
+        KafkaProducer producer(kc);
+        for (int i = 0; i < 6; ++i)
+        {
+            std::string id = "id-" + std::to_string(i);
+            producer.send(json{{"record_id", id}, {"request", {{"body", "x"}}}}.dump(), cold, id);
+            producer.send(json{{"record_id", id}}.dump(), i % 3 == 0 ? errors : hot, id);
+        }
+        producer.flush();
+        counters = producer.counters();
+    }
+    t.assert_true("Routing: every topic delivered", counters.delivered == 12 && counters.failed == 0 && counters.enqueueFailed == 0);
+
+    ConsumerConfig cc;
+    cc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cc.groupId = "routing-test";
+    cc.topics = {hot, cold, errors};
+    std::mutex mutex;
+    std::map<std::string, std::map<std::string, std::pair<std::string, int32_t>>> seen; // topic -> key -> (record id, partition)
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &r, const RecordMeta &meta)
+                                 {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen[std::string(meta.topic)][std::string(meta.key)] = {std::string(r.recordId()), meta.partition}; });
+        std::thread runner([&]
+                           { consumer.run(); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        auto count = [&]
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return seen[hot].size() + seen[cold].size() + seen[errors].size();
+        };
+        while (count() < 12 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        consumer.stop();
+        runner.join();
+    }
+    bool linked = seen[cold].size() == 6 && seen[hot].size() == 4 && seen[errors].size() == 2;
+    for (const auto &[key, value] : seen[cold])
+    {
+        auto &meta = seen[seen[errors].count(key) ? errors : hot][key];
+        linked = linked && value.first == key && meta.first == key && meta.second == value.second;
+    }
+    t.assert_true("Routing: split records linked and co-partitioned by record id", linked);
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+
+    // Side messages are not spilled by drain()
+    KafkaConfig down;
+    down.bootstrapServers = "127.0.0.1:1";
+    down.topics["side"].lingerMs = 20;
+    const std::string spillPath = "/tmp/traffic_sdk_routing_spill_test.ndjson";
+    std::remove(spillPath.c_str());
+    int lost = 0;
+    {
+        KafkaProducer producer(down);
+        producer.send("{\"record\":1}");
+        producer.send("{\"record\":2}", "other");
+        producer.send("{\"side\":1}", "side", "k", KafkaProducer::MessageKind::Side);
+        producer.sendSide("{\"side\":2}", "side", "k2", [&lost]
+                          { ++lost; });
+        std::FILE *spill = std::fopen(spillPath.c_str(), "ab");
+        int left = producer.drain(std::chrono::steady_clock::now() + std::chrono::milliseconds(100), spill);
+        std::fclose(spill);
+        counters = producer.counters();
+        t.assert_true("Routing: drain covers every connection", left == 4 && producer.queueLength() == 0);
+    }
+    std::ifstream in(spillPath);
+    std::string spilled((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::remove(spillPath.c_str());
+    t.assert_true("Routing: side messages purged, records spilled",
+                  counters.spilled == 2 && counters.purged == 2 && lost == 1 && spilled == "{\"record\":1}\n{\"record\":2}\n");
+}
+
+// Starts eagerly and never suspends at the end, enough to co_await a future
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+static DetachedTask awaitDelivery(DeliveryFuture future, std::atomic<int> &result)
+{
+    DeliveryStatus status = co_await future;
+    result = static_cast<int>(status);
+}
+
+void test_delivery_futures(TestRunner &t)
+{
+    std::cout << "\n📬 Testing Delivery Futures..." << std::endl;
+
+    DeliveryFuture skipped;
+    DeliveryStatus seen = DeliveryStatus::Pending;
+    skipped.then([&](DeliveryStatus s)
+                 { seen = s; });
+    t.assert_true("Delivery: default future is complete", skipped.ready() && seen == DeliveryStatus::Skipped &&
+                                                              std::string(toString(skipped.wait())) == "skipped");
+
+    DeliveryFuture two = DeliveryFuture::pending();
+    two.state()->expect(2);
+    two.state()->settle(DeliveryStatus::Delivered);
+    bool pendingAfterOne = !two.ready();
+    two.state()->settle(DeliveryStatus::Failed);
+    t.assert_true("Delivery: worst outcome of all messages", pendingAfterOne && two.wait() == DeliveryStatus::Failed);
+
+    size_t before = DeliveryState::pooled();
+    for (int i = 0; i < 10000; ++i)
+    {
+        DeliveryFuture f = DeliveryFuture::pending();
+        f.state()->expect(1);
+        f.state()->settle(DeliveryStatus::Delivered);
+    }
+    t.assert_true("Delivery: states are pooled", DeliveryState::pooled() <= std::max<size_t>(before, 256));
+
+    // Through a cluster: continuations run as a batch on the polling thread
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string topic = "http.traffic.delivery_test";
+    rd_kafka_mock_topic_create(cluster, topic.c_str(), 1, 1);
+    KafkaConfig kc;
+    kc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    kc.topic = topic;
+    kc.lingerMs = 20;
+    std::vector<DeliveryFuture> futures;
+    std::atomic<int> callbacks{0};
+    std::atomic<bool> onPoller{true};
+    std::atomic<int> awaited{-1};
+    bool suspended = false;
+    {
+        KafkaProducer producer(kc);
+        for (int i = 0; i < 50; ++i)
+        {
+            DeliveryFuture f = DeliveryFuture::pending();
+            f.state()->expect(1);
+            DeliveryState *state = f.state();
+            if (i % 10 == 0)
+            {
+                auto caller = std::this_thread::get_id();
+                f.then([&, caller](DeliveryStatus s)
+                       {
+                    onPoller = onPoller && std::this_thread::get_id() == caller;
+                    if (s == DeliveryStatus::Delivered)
+                        ++callbacks; });
+            }
+            producer.send("{\"i\":" + std::to_string(i) + "}", state);
+            futures.push_back(std::move(f));
+        }
+        DeliveryFuture awaitedFuture = DeliveryFuture::pending();
+        DeliveryState *state = awaitedFuture.state();
+        state->expect(1);
+        awaitDelivery(std::move(awaitedFuture), awaited);
+        suspended = awaited == -1;
+        producer.send("{\"awaited\":true}", topic, "k", KafkaProducer::MessageKind::Record, state);
+        producer.flush();
+    }
+    bool allDelivered = std::all_of(futures.begin(), futures.end(), [](const DeliveryFuture &f)
+                                    { return f.delivered(); });
+    t.assert_true("Delivery: futures completed by delivery reports", allDelivered && callbacks == 5 && onPoller);
+    t.assert_true("Delivery: co_await resumes after acknowledgement",
+                  suspended && awaited == static_cast<int>(DeliveryStatus::Delivered));
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+
+    // Unreachable broker: spilled with a spill file, dropped without one
+    KafkaConfig down;
+    down.bootstrapServers = "127.0.0.1:1";
+    const std::string spillPath = "/tmp/traffic_sdk_delivery_spill_test.ndjson";
+    DeliveryFuture spilled = DeliveryFuture::pending();
+    DeliveryFuture dropped = DeliveryFuture::pending();
+    {
+        KafkaProducer first(down);
+        spilled.state()->expect(1);
+        first.send("{\"spilled\":true}", spilled.state());
+        std::FILE *spill = std::fopen(spillPath.c_str(), "ab");
+        first.drain(std::chrono::steady_clock::now() + std::chrono::milliseconds(50), spill);
+        std::fclose(spill);
+
+        KafkaProducer second(down);
+        dropped.state()->expect(1);
+        second.send("{\"dropped\":true}", dropped.state());
+        second.drain(std::chrono::steady_clock::now() + std::chrono::milliseconds(50), nullptr);
+    }
+    std::remove(spillPath.c_str());
+    t.assert_true("Delivery: undelivered outcomes reported",
+                  spilled.waitFor(std::chrono::milliseconds(100)) == DeliveryStatus::Spilled && dropped.status() == DeliveryStatus::Dropped);
+}
+
+void test_body_extraction(TestRunner &t)
+{
+    std::cout << "\n🔎 Testing Body Field Extraction..." << std::endl;
+
+    const std::string body = R"({"meta": {"trace": "x\"y", "tags": [1, 2]}, "order": {"id": 42, "items": [{"sku": "A-1"}, {"sku": "B-2", "qty": 3}], "total": 9.5}, "note": "é"})";
+    JsonFieldSet fields({"/order/id", "order.items[1].sku", "$.order.total", "/order/items/0", "/missing/field"});
+    json out;
+    t.assert_true("Extraction: pointer and dotted paths",
+                  fields.extract(body, out) && out["/order/id"] == 42 && out["order.items[1].sku"] == "B-2" &&
+                      out["$.order.total"] == 9.5 && out["/order/items/0"] == json{{"sku", "A-1"}} && !out.contains("/missing/field"));
+
+    json escaped;
+    JsonFieldSet special({"/a~1b/c~0d", "/list/1", "/obj/1"});
+    t.assert_true("Extraction: escaped keys and numeric segments",
+                  special.extract(R"({"a/b": {"c~d": true}, "list": ["x", null], "obj": {"1": "one"}})", escaped) &&
+                      escaped["/a~1b/c~0d"] == true && escaped["/list/1"].is_null() && escaped["/obj/1"] == "one");
+
+    // Scanning stops once every field was found, so a body cut after them still yields them
+    json early;
+    JsonFieldSet first({"/id"});
+    t.assert_true("Extraction: stops after the last field", first.extract(R"({"id": "abc", "rest": [1, 2, )", early) && early["/id"] == "abc");
+
+    json none;
+    t.assert_true("Extraction: non-JSON and malformed bodies rejected",
+                  !fields.extract("plain text", none) && !fields.extract("42", none) && !fields.extract(R"({"order": {"id": 4)", none) &&
+                      !fields.extract(R"({"order": [1,}})", none) && !fields.extract("", none) && none.is_null());
+
+    bool threw = false;
+    try
+    {
+        JsonFieldSet bad({"a..b"});
+    }
+    catch (const std::invalid_argument &)
+    {
+        threw = true;
+    }
+    t.assert_true("Extraction: malformed paths rejected at init", threw);
+
+    ExtractionConfig cfg;
+    cfg.rules.push_back({.route = "/orders/{id}", .requestFields = {"/order/id"}, .responseFields = {"/status"}});
+    cfg.rules.push_back({.route = "/audit", .requestFields = {"/user"}, .responseFields = {}, .keepBody = true});
+    BodyExtractor extractor(cfg);
+    auto record = [](const std::string &route, const std::string &reqBody, const std::string &resBody)
+    {
+        return json{{"account_id", "acct"},
+                    {"timestamp", 1760000000},
+                    {"request", {{"method", "POST"}, {"path", "/p"}, {"route_template", route}, {"body", reqBody}, {"body_b64", "Zm9v"}}},
+                    {"response", {{"status", 200}, {"body", resBody}, {"body_b64", "YmFy"}, {"body_truncated", true}}}};
+    };
+    json j = record("/orders/{id}", body, R"({"status": "ok", "payload": "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"})");
+    size_t before = j.dump().size();
+    t.assert_true("Extraction: bodies replaced by extracted fields",
+                  extractor.apply(j) && j["request"]["extracted"]["/order/id"] == 42 && j["response"]["extracted"]["/status"] == "ok" &&
+                      !j["request"].contains("body") && !j["request"].contains("body_b64") && !j["response"].contains("body_truncated") &&
+                      j.dump().size() * 2 < before);
+
+    json kept = record("/audit", R"({"user": "u1"})", "");
+    json other = record("/other", body, body);
+    json text = record("/orders/{id}", "not json", "");
+    t.assert_true("Extraction: keepBody, unmatched routes and fallbacks",
+                  extractor.apply(kept) && kept["request"]["extracted"]["/user"] == "u1" && kept["request"]["body"] == R"({"user": "u1"})" &&
+                      !extractor.apply(other) && other["request"]["body"] == body && !extractor.apply(text) &&
+                      text["request"]["body"] == "not json" && !text["request"].contains("extracted"));
+
+    std::string serialized = j.dump();
+    RecordView view(serialized);
+    t.assert_true("Extraction: RecordView reads extracted fields",
+                  view.request().extracted("/order/id") == "42" && view.response().extracted("/status") == "\"ok\"" &&
+                      view.request().extracted("/none").empty() && view.request().bodyText().empty());
+}
+
+void test_sdk_instances(TestRunner &t)
+{
+    std::cout << "\n🏢 Testing SDK Instances and Producer Pool..." << std::endl;
+
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string topic = "http.traffic.tenants_test";
+    rd_kafka_mock_topic_create(cluster, topic.c_str(), 1, 1);
+    // Acknowledged only after a round trip, so futures of an idle instance
+    // complete through the producer's poll thread rather than the poll after a send
+    rd_kafka_mock_broker_set_rtt(cluster, 1, 20);
+
+    ProducerPool pool;
+    KafkaConfig kc;
+    kc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    kc.topic = topic;
+    kc.lingerMs = 1;
+    KafkaConfig acksAll = kc;
+    acksAll.acks = "all";
+    {
+        auto a = pool.acquire(kc);
+        auto b = pool.acquire(kc);
+        auto c = pool.acquire(acksAll);
+        t.assert_true("Pool: equal settings share one producer", a && a == b && a != c && pool.size() == 2);
+        bool notLast = !pool.release(std::move(b)) && pool.size() == 2;
+        std::shared_ptr<KafkaProducer> last = pool.release(std::move(a));
+        t.assert_true("Pool: only the last release hands the producer back", notLast && last && pool.size() == 1);
+        pool.release(std::move(c));
+        t.assert_true("Pool: empty once every lease is back", pool.size() == 0);
+    }
+
+    SdkConfig base;
+    base.kafka = kc;
+    base.producerPool = &pool;
+    base.routes.enabled = false;
+    SdkConfig configA = base, configB = base;
+    configA.accountId = "tenant-a";
+    configB.accountId = "tenant-b";
+    configB.policy.captureRequestBody = false;
+    auto sdkA = std::make_unique<TrafficProcessorSdk>(configA);
+    auto sdkB = std::make_unique<TrafficProcessorSdk>(configB);
+    t.assert_true("Instances: equal Kafka settings share a producer", pool.size() == 1);
+
+    bool rejected = false;
+    try
+    {
+        sdkA->reconfigure(json{{"kafka", {{"linger_ms", 5}}}});
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    t.assert_true("Instances: pooled producer settings are fixed", rejected);
+
+    RequestData req;
+    req.method = "POST";
+    req.path = "/orders";
+    req.bodyText = "{\"id\":1}";
+    ResponseData res;
+    res.status = 201;
+    DeliveryFuture fa = sdkA->captureAsync(req, res);
+    DeliveryFuture fb = sdkB->captureAsync(req, res);
+    sdkB->capture(req, res);
+    t.assert_true("Instances: each delivers through the shared producer",
+                  fa.waitFor(std::chrono::seconds(2)) == DeliveryStatus::Delivered &&
+                      fb.waitFor(std::chrono::seconds(2)) == DeliveryStatus::Delivered);
+
+    ShutdownReport reportA = sdkA->shutdown();
+    t.assert_true("Instances: shutdown leaves the pooled producer to the others",
+                  pool.size() == 1 && !reportA.deadlineExceeded && reportA.dropped == 0 && sdkB->captureAsync(req, res).waitFor(std::chrono::seconds(2)) == DeliveryStatus::Delivered);
+    sdkA.reset();
+    ShutdownReport reportB = sdkB->shutdown();
+    sdkB.reset();
+    t.assert_true("Instances: the last instance drains and releases it", pool.size() == 0 && reportB.dropped == 0 && reportB.delivered >= 2);
+
+    ConsumerConfig cc;
+    cc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cc.groupId = "tenants-test";
+    cc.topics = {topic};
+    std::mutex mutex;
+    std::map<std::string, int> accounts;
+    bool bodylessB = true;
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &r, const RecordMeta &)
+                                 {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++accounts[std::string(r.accountId())];
+            if (r.accountId() == "tenant-b")
+                bodylessB = bodylessB && r.request().bodyText().empty(); });
+        std::thread runner([&]
+                           { consumer.run(); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        auto count = [&]
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return accounts["tenant-a"] + accounts["tenant-b"];
+        };
+        while (count() < 4 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        consumer.stop();
+        runner.join();
+    }
+    t.assert_true("Instances: records carry each instance's account and policy",
+                  accounts["tenant-a"] == 1 && accounts["tenant-b"] == 3 && bodylessB);
+
+    // Replacing an owned producer flushes and tears down the old one rather
+    // than retiring it: nothing holds a capture guard across a poll
+    SdkConfig configC = base;
+    configC.producerPool = nullptr;
+    configC.accountId = "tenant-c";
+    auto sdkC = std::make_unique<TrafficProcessorSdk>(configC);
+    DeliveryFuture beforeSwap = sdkC->captureAsync(req, res);
+    auto swapStart = std::chrono::steady_clock::now();
+    sdkC->reconfigure(json{{"kafka", {{"linger_ms", 5}}}});
+    bool prompt = std::chrono::steady_clock::now() - swapStart < std::chrono::seconds(1);
+    DeliveryFuture afterSwap = sdkC->captureAsync(req, res);
+    t.assert_true("Instances: reconfigure reclaims the replaced producer",
+                  prompt && beforeSwap.ready() && beforeSwap.status() == DeliveryStatus::Delivered &&
+                      afterSwap.waitFor(std::chrono::seconds(2)) == DeliveryStatus::Delivered);
+    ShutdownReport reportC = sdkC->shutdown();
+    t.assert_true("Instances: replaced producer's deliveries reported", reportC.delivered == 2 && reportC.dropped == 0);
+    sdkC.reset();
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+}
+
+void test_record_headers(TestRunner &t)
+{
+    std::cout << "\n🏷️  Testing Kafka Record Headers..." << std::endl;
+
+    json record{{"account_id", "acct-h"},
+                {"timestamp", 1760000000},
+                {"request", {{"method", "GET"}, {"host", "api.example.com"}, {"path", "/users/7"}, {"route_template", "/users/{id}"}}},
+                {"response", {{"status", 503}}}};
+    char statusBuffer[12];
+    RecordHeaders h = recordHeaders(record, statusBuffer);
+    t.assert_true("Headers: taken from the record",
+                  h.accountId == "acct-h" && h.method == "GET" && h.host == "api.example.com" && h.route == "/users/{id}" &&
+                      h.status == "503" && h.statusCode() == 503 && h.schemaVersion == record_headers::CurrentSchemaVersion &&
+                      h.contentEncoding == "json" && h.present());
+    json sparse{{"account_id", "acct-h"}, {"request", {{"path", "/health"}}}, {"response", json::object()}};
+    RecordHeaders hs = recordHeaders(sparse, statusBuffer);
+    t.assert_true("Headers: path without template, empty when absent",
+                  hs.route == "/health" && hs.method.empty() && hs.host.empty() && hs.status.empty() && hs.statusCode() == 0 &&
+                      !RecordHeaders{}.present());
+
+    char errstr[256];
+    rd_kafka_t *admin = rd_kafka_new(RD_KAFKA_PRODUCER, rd_kafka_conf_new(), errstr, sizeof(errstr));
+    rd_kafka_mock_cluster_t *cluster = rd_kafka_mock_cluster_new(admin, 1);
+    const std::string topic = "http.traffic.headers_test";
+    rd_kafka_mock_topic_create(cluster, topic.c_str(), 2, 1);
+
+    SdkConfig cfg;
+    cfg.accountId = "acct-h";
+    cfg.kafka.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cfg.kafka.topic = topic;
+    cfg.kafka.lingerMs = 1;
+    cfg.kafka.topics[topic].acks = "all"; // keyed path with a topic handle
+    {
+        TrafficProcessorSdk sdk(cfg);
+        for (int i = 0; i < 10; ++i)
+        {
+            RequestData req;
+            req.method = i % 2 ? "POST" : "GET";
+            req.host = "api.example.com";
+            req.path = "/items/" + std::to_string(i);
+            ResponseData res;
+            res.status = i < 8 ? 200 : 500;
+            sdk.capture(req, res);
+        }
+        KafkaProducer raw(cfg.kafka);
+        raw.send("{\"account_id\":\"legacy\",\"request\":{},\"response\":{\"status\":500}}"); // no headers
+        raw.flush();
+        sdk.shutdown();
+    }
+
+    ConsumerConfig cc;
+    cc.bootstrapServers = rd_kafka_mock_cluster_bootstraps(cluster);
+    cc.groupId = "headers-test";
+    cc.topics = {topic};
+    cc.filter = [](const RecordHeaders &headers)
+    { return !headers.present() || headers.statusCode() >= 500; };
+    std::mutex mutex;
+    std::vector<std::string> seen;
+    bool headersMatch = true;
+    ConsumerStats stats;
+    {
+        TrafficConsumer consumer(cc, [&](const RecordView &r, const RecordMeta &meta)
+                                 {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen.emplace_back(r.accountId());
+            if (meta.headers.present())
+                headersMatch = headersMatch && meta.headers.accountId == r.accountId() && meta.headers.statusCode() == r.response().status() &&
+                               meta.headers.method == r.request().method() && meta.headers.host == r.request().host(); });
+        std::thread runner([&]
+                           { consumer.run(); });
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (consumer.stats().messages < 11 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        consumer.stop();
+        runner.join();
+        stats = consumer.stats();
+    }
+    t.assert_true("Headers: consumer filters before parsing",
+                  stats.messages == 11 && stats.filtered == 8 && stats.records == 3 && seen.size() == 3 && headersMatch);
+    t.assert_true("Headers: messages without headers reach the filter",
+                  std::count(seen.begin(), seen.end(), "legacy") == 1 && std::count(seen.begin(), seen.end(), "acct-h") == 2);
+
+    rd_kafka_mock_cluster_destroy(cluster);
+    rd_kafka_destroy(admin);
+}
+
 int main()
 {
     std::cout << "🚀 Starting Traffic Processing SDK Unit Tests\n"
@@ -287,6 +2077,23 @@ int main()
     test_configuration(runner);
     test_data_structures(runner);
     test_edge_cases(runner);
+    test_redaction(runner);
+    test_route_normalization(runner);
+    test_runtime_config(runner);
+    test_adaptive_batching(runner);
+    test_shutdown_drain(runner);
+    test_passive_capture(runner);
+    test_record_view(runner);
+    test_consumer(runner);
+    test_streaming_analytics(runner);
+    test_columnar_segments(runner);
+    test_body_dedup(runner);
+    test_record_schema(runner);
+    test_topic_routing(runner);
+    test_delivery_futures(runner);
+    test_body_extraction(runner);
+    test_sdk_instances(runner);
+    test_record_headers(runner);
 
     runner.summary();
 
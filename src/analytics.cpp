@@ -0,0 +1,314 @@
+#include "traffic_processor/analytics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "traffic_processor/sdk.hpp"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace traffic_processor;
+
+namespace
+{
+    struct StringHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    const std::string kOtherHosts = "(other)";
+
+    int64_t nowMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    std::atomic<size_t> nextShard{0};
+}
+
+struct TrafficAnalytics::HostWindow
+{
+    HyperLogLog clients;
+    uint64_t serverErrors{0};
+
+    explicit HostWindow(int precision) : clients(precision) {}
+};
+
+struct TrafficAnalytics::Window
+{
+    HeavyHitters routes;
+    HyperLogLog clients;
+    std::unordered_map<std::string, HostWindow, StringHash, std::equal_to<>> hosts;
+    std::map<int, TDigest> latency;
+    uint64_t records{0};
+    uint64_t serverErrors{0};
+
+    explicit Window(const AnalyticsConfig &cfg)
+        : routes(cfg.topK * 2, cfg.sketchWidth, cfg.sketchDepth), clients(cfg.hllPrecision)
+    {
+    }
+
+    // Hosts past the cap share one entry so memory stays bounded
+    HostWindow &host(std::string_view name, const AnalyticsConfig &cfg)
+    {
+        auto it = hosts.find(name);
+        if (it != hosts.end())
+            return it->second;
+        if (hosts.size() >= cfg.maxHosts)
+            name = kOtherHosts;
+        return hosts.try_emplace(std::string(name), cfg.hostHllPrecision).first->second;
+    }
+};
+
+struct alignas(64) TrafficAnalytics::Shard
+{
+    std::mutex mutex;
+    std::unique_ptr<Window> window;
+};
+
+nlohmann::json AnalyticsSnapshot::toJson() const
+{
+    nlohmann::json routes = nlohmann::json::array();
+    for (const auto &r : topRoutes)
+        routes.push_back({{"route", r.key}, {"count", r.count}});
+    nlohmann::json latency = nlohmann::json::object();
+    for (const auto &[status, l] : latencyByStatus)
+        latency[std::to_string(status)] = {{"count", l.count}, {"p50", l.p50}, {"p90", l.p90}, {"p99", l.p99}, {"max", l.max}};
+    nlohmann::json burstList = nlohmann::json::array();
+    for (const auto &b : bursts)
+        burstList.push_back({{"host", b.host}, {"errors", b.errors}, {"baseline", b.baseline}, {"score", b.score}});
+    return nlohmann::json{
+        {"window_start_ms", windowStartMs},
+        {"window_end_ms", windowEndMs},
+        {"records", records},
+        {"server_errors", serverErrors},
+        {"top_routes", routes},
+        {"unique_clients", uniqueClients},
+        {"unique_clients_by_host", uniqueClientsByHost},
+        {"latency_by_status", latency},
+        {"bursts", burstList},
+    };
+}
+
+TrafficAnalytics::TrafficAnalytics(const AnalyticsConfig &config)
+    : cfg_(config), windowStartMs_(nowMs())
+{
+    cfg_.topK = std::max<size_t>(cfg_.topK, 1);
+    cfg_.maxHosts = std::max<size_t>(cfg_.maxHosts, 1);
+    int n = cfg_.shards > 0 ? cfg_.shards : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int i = 0; i < n; ++i)
+    {
+        shards_.push_back(std::make_unique<Shard>());
+        shards_.back()->window = newWindow();
+    }
+}
+
+TrafficAnalytics::~TrafficAnalytics()
+{
+    stop();
+}
+
+std::unique_ptr<TrafficAnalytics::Window> TrafficAnalytics::newWindow() const
+{
+    return std::make_unique<Window>(cfg_);
+}
+
+TrafficAnalytics::Shard &TrafficAnalytics::shardForThisThread()
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu >= 0)
+        return *shards_[static_cast<size_t>(cpu) % shards_.size()];
+#endif
+    thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed);
+    return *shards_[index % shards_.size()];
+}
+
+void TrafficAnalytics::observe(std::string_view method, std::string_view route, std::string_view host,
+                               std::string_view clientIp, int status, int64_t latencyMs)
+{
+    thread_local std::string routeKey;
+    routeKey.assign(method);
+    routeKey.push_back(' ');
+    routeKey.append(route);
+    uint64_t clientHash = hash64(clientIp);
+    bool serverError = status >= 500 && status < 600;
+
+    Shard &shard = shardForThisThread();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Window &w = *shard.window;
+    ++w.records;
+    w.routes.add(routeKey);
+    if (!clientIp.empty())
+        w.clients.add(clientHash);
+    HostWindow &h = w.host(host, cfg_);
+    if (!clientIp.empty())
+        h.clients.add(clientHash);
+    if (serverError)
+    {
+        ++w.serverErrors;
+        ++h.serverErrors;
+    }
+    if (latencyMs >= 0)
+        w.latency.try_emplace(status, cfg_.digestCompression).first->second.add(static_cast<double>(latencyMs));
+}
+
+void TrafficAnalytics::observe(const RequestData &req, const ResponseData &res, std::string_view route)
+{
+    if (route.empty())
+        route = req.routeTemplate;
+    if (route.empty())
+        route = std::string_view(req.path).substr(0, req.path.find('?'));
+    int64_t latencyMs = -1;
+    if (req.startNs != 0 && res.endNs > req.startNs)
+        latencyMs = static_cast<int64_t>((res.endNs - req.startNs) / 1'000'000);
+    observe(req.method, route, req.host, req.ip, res.status, latencyMs);
+}
+
+AnalyticsSnapshot TrafficAnalytics::snapshot()
+{
+    std::lock_guard<std::mutex> closeLock(closeMutex_);
+    AnalyticsSnapshot snap;
+    snap.windowEndMs = nowMs();
+    snap.windowStartMs = windowStartMs_.exchange(snap.windowEndMs);
+
+    // Swap each shard for an empty window; writers wait at most one swap
+    std::vector<std::unique_ptr<Window>> closed;
+    closed.reserve(shards_.size());
+    for (auto &shard : shards_)
+    {
+        auto fresh = newWindow();
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->window.swap(fresh);
+        }
+        closed.push_back(std::move(fresh));
+    }
+
+    Window &merged = *closed.front();
+    for (size_t i = 1; i < closed.size(); ++i)
+    {
+        Window &w = *closed[i];
+        merged.routes.merge(w.routes);
+        merged.clients.merge(w.clients);
+        for (auto &[name, h] : w.hosts)
+        {
+            HostWindow &target = merged.host(name, cfg_);
+            target.clients.merge(h.clients);
+            target.serverErrors += h.serverErrors;
+        }
+        for (auto &[status, digest] : w.latency)
+            merged.latency.try_emplace(status, cfg_.digestCompression).first->second.merge(digest);
+        merged.records += w.records;
+        merged.serverErrors += w.serverErrors;
+    }
+
+    snap.records = merged.records;
+    snap.serverErrors = merged.serverErrors;
+    snap.topRoutes = merged.routes.top(cfg_.topK);
+    snap.uniqueClients = merged.clients.estimate();
+    for (const auto &[name, h] : merged.hosts)
+        snap.uniqueClientsByHost[name] = h.clients.estimate();
+    for (const auto &[status, digest] : merged.latency)
+    {
+        LatencySummary &l = snap.latencyByStatus[status];
+        l.count = static_cast<uint64_t>(digest.count());
+        l.p50 = digest.quantile(0.5);
+        l.p90 = digest.quantile(0.9);
+        l.p99 = digest.quantile(0.99);
+        l.max = digest.max();
+    }
+
+    // Every tracked series gets a sample each window, zero if it was quiet
+    auto feed = [&](const std::string &host, uint64_t errors)
+    {
+        auto it = detectors_.try_emplace(host, cfg_.burstSmoothing, cfg_.burstThreshold,
+                                         static_cast<double>(cfg_.burstMinErrors), cfg_.burstWarmupWindows)
+                      .first;
+        double baseline = it->second.mean();
+        if (it->second.update(static_cast<double>(errors)))
+            snap.bursts.push_back({host, errors, baseline, it->second.score()});
+    };
+    feed("*", merged.serverErrors);
+    for (const auto &[name, h] : merged.hosts)
+        feed(name, h.serverErrors);
+    for (auto it = detectors_.begin(); it != detectors_.end();)
+    {
+        if (it->first == "*" || merged.hosts.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+        it->second.update(0);
+        // Hosts that went quiet are forgotten, bounding the detector map
+        if (it->second.mean() < 0.5)
+            it = detectors_.erase(it);
+        else
+            ++it;
+    }
+
+    std::lock_guard<std::mutex> lock(latestMutex_);
+    latest_ = snap;
+    return snap;
+}
+
+AnalyticsSnapshot TrafficAnalytics::latest() const
+{
+    std::lock_guard<std::mutex> lock(latestMutex_);
+    return latest_;
+}
+
+void TrafficAnalytics::start(Sink sink)
+{
+    if (timer_.joinable() || cfg_.windowMs <= 0)
+        return;
+    sink_ = std::move(sink);
+    timerStop_ = false;
+    windowStartMs_.store(nowMs());
+    timer_ = std::thread([this]
+                         { timerLoop(); });
+}
+
+void TrafficAnalytics::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(timerMutex_);
+        timerStop_ = true;
+    }
+    timerCv_.notify_all();
+    if (timer_.joinable())
+        timer_.join();
+}
+
+void TrafficAnalytics::timerLoop()
+{
+    const auto interval = std::chrono::milliseconds(cfg_.windowMs);
+    auto next = std::chrono::steady_clock::now() + interval;
+    std::unique_lock<std::mutex> lock(timerMutex_);
+    while (!timerCv_.wait_until(lock, next, [this]
+                                { return timerStop_; }))
+    {
+        lock.unlock();
+        AnalyticsSnapshot snap = snapshot();
+        if (sink_)
+        {
+            try
+            {
+                sink_(snap);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Analytics sink failed: " << e.what() << std::endl;
+            }
+        }
+        next += interval;
+        lock.lock();
+    }
+}
@@ -0,0 +1,116 @@
+#include "traffic_processor/batch_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace traffic_processor;
+
+nlohmann::json BatchControllerMetrics::toJson() const
+{
+    return nlohmann::json{
+        {"arrival_rate", arrivalRate},
+        {"avg_batch_fill", avgBatchFill},
+        {"delivery_latency_ms", deliveryLatencyMs},
+        {"effective_linger_ms", effectiveLingerMs},
+        {"target_batch_num_messages", targetBatchNumMessages},
+        {"producer_linger_ms", producerLingerMs},
+        {"producer_batch_num_messages", producerBatchNumMessages},
+        {"flushing_early", flushingEarly},
+        {"decisions", decisions},
+        {"producer_recreations", producerRecreations},
+        {"slo_violations", sloViolations},
+        {"last_reason", lastReason},
+    };
+}
+
+BatchController::BatchController(const AdaptiveBatchingConfig &config, int producerLingerMs, int producerBatchNumMessages)
+    : cfg_(config), producerLingerMs_(producerLingerMs), producerBatch_(producerBatchNumMessages)
+{
+    metrics_.producerLingerMs = producerLingerMs_;
+    metrics_.producerBatchNumMessages = producerBatch_;
+    metrics_.effectiveLingerMs = producerLingerMs_;
+    metrics_.targetBatchNumMessages = producerBatch_;
+}
+
+void BatchController::producerRecreated(int lingerMs, int batchNumMessages, Clock::time_point now)
+{
+    producerLingerMs_ = lingerMs;
+    producerBatch_ = batchNumMessages;
+    lastRecreate_ = now;
+    recreatedOnce_ = true;
+    metrics_.producerLingerMs = lingerMs;
+    metrics_.producerBatchNumMessages = batchNumMessages;
+    metrics_.producerRecreations++;
+}
+
+BatchDecision BatchController::update(const BatchSample &sample, Clock::time_point now)
+{
+    const double a = std::clamp(cfg_.smoothing, 0.01, 1.0);
+    if (!primed_)
+    {
+        rate_ = sample.arrivalRate;
+        fill_ = sample.avgBatchFill;
+        latency_ = sample.deliveryLatencyMs;
+        rtt_ = sample.rttMs;
+        primed_ = true;
+    }
+    else
+    {
+        rate_ += a * (sample.arrivalRate - rate_);
+        fill_ += a * (sample.avgBatchFill - fill_);
+        latency_ += a * (sample.deliveryLatencyMs - latency_);
+        rtt_ += a * (sample.rttMs - rtt_);
+    }
+
+    BatchDecision d;
+    const double headroomMs = std::max<double>(cfg_.minLingerMs, cfg_.latencySloMs - rtt_);
+    const double expectedInHeadroom = rate_ * headroomMs / 1000.0;
+
+    if (expectedInHeadroom < 2.0)
+    {
+        // Too little traffic for batching to pay off: send right away
+        d.lingerMs = cfg_.minLingerMs;
+        d.batchNumMessages = cfg_.minBatchNumMessages;
+        d.reason = "low-rate";
+    }
+    else
+    {
+        double batch = std::clamp(expectedInHeadroom, static_cast<double>(cfg_.minBatchNumMessages),
+                                  static_cast<double>(cfg_.maxBatchNumMessages));
+        double linger = batch / rate_ * 1000.0;
+        d.batchNumMessages = static_cast<int>(batch);
+        d.lingerMs = static_cast<int>(std::clamp(linger, static_cast<double>(cfg_.minLingerMs),
+                                                 std::min(headroomMs, static_cast<double>(cfg_.maxLingerMs))));
+        d.reason = batch >= cfg_.maxBatchNumMessages ? "max-batch" : "fill-within-slo";
+    }
+
+    // Observed latency above the SLO: back off linger regardless of the model
+    if (latency_ > cfg_.latencySloMs)
+    {
+        metrics_.sloViolations++;
+        d.lingerMs = std::max(cfg_.minLingerMs, std::min(d.lingerMs, producerLingerMs_) / 2);
+        d.reason = "slo-violation";
+    }
+
+    const double ratio = static_cast<double>(std::max(cfg_.recreateRatio, 1.0));
+    const bool lingerTooShort = d.lingerMs > producerLingerMs_ * ratio;
+    const bool batchMismatch = d.batchNumMessages > producerBatch_ * ratio || d.batchNumMessages * ratio < producerBatch_;
+    const bool cooledDown = !recreatedOnce_ || now - lastRecreate_ >= std::chrono::milliseconds(cfg_.recreateCooldownMs);
+    if ((lingerTooShort || batchMismatch) && cooledDown)
+    {
+        d.recreateProducer = true;
+    }
+
+    // Linger below what the producer waits is enforced by flushing early
+    d.flushEarly = !d.recreateProducer && d.lingerMs < producerLingerMs_;
+
+    metrics_.arrivalRate = rate_;
+    metrics_.avgBatchFill = fill_;
+    metrics_.deliveryLatencyMs = latency_;
+    metrics_.effectiveLingerMs = d.recreateProducer ? d.lingerMs : std::min(d.lingerMs, producerLingerMs_);
+    metrics_.targetBatchNumMessages = d.batchNumMessages;
+    metrics_.flushingEarly = d.flushEarly;
+    metrics_.decisions++;
+    metrics_.lastReason = d.reason;
+    return d;
+}
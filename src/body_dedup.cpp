@@ -0,0 +1,404 @@
+#include "traffic_processor/body_dedup.hpp"
+#include "traffic_processor/body_resolver.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+using namespace traffic_processor;
+
+namespace
+{
+    constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+
+    uint64_t fmix64(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDULL;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    uint64_t lane(uint64_t acc, uint64_t word)
+    {
+        return std::rotl(acc + word * kPrime2, 31) * kPrime1;
+    }
+
+    struct BodyHashHasher
+    {
+        size_t operator()(const BodyHash &h) const { return static_cast<size_t>(h.lo); }
+    };
+
+    int64_t steadyMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // One independently locked LRU table; callers hold `mutex`
+    template <typename Value>
+    struct LruShard
+    {
+        struct Entry
+        {
+            BodyHash hash;
+            Value value;
+        };
+
+        std::mutex mutex;
+        std::list<Entry> order; // most recently used first
+        std::unordered_map<BodyHash, typename std::list<Entry>::iterator, BodyHashHasher> index;
+        size_t capacity;
+
+        explicit LruShard(size_t cap) : capacity(std::max<size_t>(cap, 1)) { index.reserve(capacity); }
+
+        Value *find(const BodyHash &hash)
+        {
+            auto it = index.find(hash);
+            if (it == index.end())
+                return nullptr;
+            order.splice(order.begin(), order, it->second);
+            return &it->second->value;
+        }
+
+        void put(const BodyHash &hash, Value value)
+        {
+            if (Value *existing = find(hash))
+            {
+                *existing = std::move(value);
+                return;
+            }
+            if (index.size() >= capacity)
+            {
+                // Reuse the evicted node instead of allocating a new one
+                auto last = std::prev(order.end());
+                index.erase(last->hash);
+                last->hash = hash;
+                last->value = std::move(value);
+                order.splice(order.begin(), order, last);
+            }
+            else
+            {
+                order.push_front(Entry{hash, std::move(value)});
+            }
+            index[hash] = order.begin();
+        }
+
+        void erase(const BodyHash &hash)
+        {
+            auto it = index.find(hash);
+            if (it == index.end())
+                return;
+            order.erase(it->second);
+            index.erase(it);
+        }
+    };
+
+    template <typename Shard>
+    void makeShards(std::vector<std::unique_ptr<Shard>> &shards, size_t capacity, int count)
+    {
+        size_t n = static_cast<size_t>(std::clamp(count, 1, 1024));
+        size_t perShard = (std::max<size_t>(capacity, 1) + n - 1) / n;
+        for (size_t i = 0; i < n; ++i)
+            shards.push_back(std::make_unique<Shard>(perShard));
+    }
+
+    int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // What the content address covers: the exact bytes when base64 is present
+    std::string_view addressed(std::string_view text, std::string_view base64)
+    {
+        return base64.empty() ? text : base64;
+    }
+}
+
+// Two independent 64-bit lanes over 16-byte blocks, cross-mixed at the end
+BodyHash traffic_processor::hashBody(std::string_view data)
+{
+    uint64_t a = kPrime1 ^ data.size();
+    uint64_t b = kPrime3 + data.size();
+    size_t i = 0;
+    for (; i + 16 <= data.size(); i += 16)
+    {
+        uint64_t w0, w1;
+        std::memcpy(&w0, data.data() + i, 8);
+        std::memcpy(&w1, data.data() + i + 8, 8);
+        a = lane(a, w0);
+        b = lane(b, w1);
+    }
+    uint64_t t0 = 0, t1 = 0;
+    size_t rest = data.size() - i;
+    std::memcpy(&t0, data.data() + i, std::min<size_t>(rest, 8));
+    if (rest > 8)
+        std::memcpy(&t1, data.data() + i + 8, rest - 8);
+    a = lane(a, t0);
+    b = lane(b, t1);
+
+    BodyHash h;
+    h.hi = fmix64(a + std::rotl(b, 23));
+    h.lo = fmix64(b ^ (a * kPrime3));
+    return h;
+}
+
+std::string BodyHash::hex() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i)
+    {
+        out[15 - i] = digits[(hi >> (i * 4)) & 0xF];
+        out[31 - i] = digits[(lo >> (i * 4)) & 0xF];
+    }
+    return out;
+}
+
+bool BodyHash::parse(std::string_view hex, BodyHash &out)
+{
+    if (hex.size() != 32)
+        return false;
+    BodyHash h;
+    for (size_t i = 0; i < 32; ++i)
+    {
+        int d = hexDigit(hex[i]);
+        if (d < 0)
+            return false;
+        uint64_t &word = i < 16 ? h.hi : h.lo;
+        word = (word << 4) | static_cast<uint64_t>(d);
+    }
+    out = h;
+    return true;
+}
+
+nlohmann::json BodyDedupStats::toJson() const
+{
+    return nlohmann::json{
+        {"bodies", bodies},
+        {"referenced", referenced},
+        {"shipped", shipped},
+        {"bytes_saved", bytesSaved},
+    };
+}
+
+// ------------------------------------------------------------- deduplicator
+
+struct BodyDeduplicator::Shard : LruShard<int64_t> // value: last shipment, steady ms
+{
+    using LruShard::LruShard;
+};
+
+BodyDeduplicator::BodyDeduplicator(const BodyDedupConfig &config) : cfg_(config)
+{
+    makeShards(shards_, cfg_.capacity, cfg_.shards);
+}
+
+BodyDeduplicator::~BodyDeduplicator() = default;
+
+BodyDeduplicator::Shard &BodyDeduplicator::shardFor(const BodyHash &hash) const
+{
+    // hi picks the shard, lo buckets within it
+    return *shards_[hash.hi % shards_.size()];
+}
+
+bool BodyDeduplicator::shouldShip(const BodyHash &hash)
+{
+    int64_t now = steadyMs();
+    Shard &shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (int64_t *lastShipped = shard.find(hash))
+    {
+        if (now - *lastShipped < cfg_.reshipIntervalMs)
+            return false;
+        *lastShipped = now;
+        return true;
+    }
+    shard.put(hash, now);
+    return true;
+}
+
+void BodyDeduplicator::forget(const BodyHash &hash)
+{
+    Shard &shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.erase(hash);
+}
+
+bool BodyDeduplicator::apply(nlohmann::json &section, std::string &message)
+{
+    auto body = section.find("body");
+    if (body == section.end() || !body->is_string())
+        return false;
+    auto base64 = section.find("body_b64");
+    bool hasBase64 = base64 != section.end() && base64->is_string();
+    const std::string &text = body->get_ref<const std::string &>();
+    std::string_view encoded = hasBase64 ? std::string_view(base64->get_ref<const std::string &>()) : std::string_view();
+    if (std::max(text.size(), encoded.size() / 4 * 3) < std::max<size_t>(cfg_.minBytes, 1))
+        return false;
+
+    bodies_.fetch_add(1, std::memory_order_relaxed);
+    BodyHash hash = hashBody(addressed(text, encoded));
+    std::string ref = hash.hex();
+    if (!sideMessages())
+    {
+        // Nowhere to ship the body: keep it inline, next to its reference
+        section["body_ref"] = std::move(ref);
+        return false;
+    }
+    if (shouldShip(hash))
+    {
+        message = nlohmann::json{
+            {"ref", ref},
+            {"body", text},
+            {"body_b64", encoded},
+            {"timestamp", std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count()},
+        }
+                      .dump(-1, ' ', false, nlohmann::json::error_handler_t::replace); // text of binary bodies is lossy anyway
+        shipped_.fetch_add(1, std::memory_order_relaxed);
+        // The body message carries the body; the record only its reference
+        *body = "";
+        if (hasBase64)
+            *base64 = "";
+        section["body_ref"] = std::move(ref);
+        return true;
+    }
+
+    referenced_.fetch_add(1, std::memory_order_relaxed);
+    bytesSaved_.fetch_add(text.size() + encoded.size(), std::memory_order_relaxed);
+    *body = "";
+    if (hasBase64)
+        *base64 = "";
+    section["body_ref"] = std::move(ref);
+    return false;
+}
+
+size_t BodyDeduplicator::size() const
+{
+    size_t n = 0;
+    for (const auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        n += shard->index.size();
+    }
+    return n;
+}
+
+BodyDedupStats BodyDeduplicator::stats() const
+{
+    BodyDedupStats s;
+    s.bodies = bodies_.load(std::memory_order_relaxed);
+    s.referenced = referenced_.load(std::memory_order_relaxed);
+    s.shipped = shipped_.load(std::memory_order_relaxed);
+    s.bytesSaved = bytesSaved_.load(std::memory_order_relaxed);
+    return s;
+}
+
+// ----------------------------------------------------------------- resolver
+
+struct BodyResolver::Shard : LruShard<std::shared_ptr<const StoredBody>>
+{
+    using LruShard::LruShard;
+};
+
+BodyResolver::BodyResolver(size_t capacity, int shards)
+{
+    makeShards(shards_, capacity, shards);
+}
+
+BodyResolver::~BodyResolver() = default;
+
+BodyResolver::Shard &BodyResolver::shardFor(const BodyHash &hash) const
+{
+    return *shards_[hash.hi % shards_.size()];
+}
+
+bool BodyResolver::add(std::string_view bodyMessage)
+{
+    auto doc = nlohmann::json::parse(bodyMessage, nullptr, false);
+    if (!doc.is_object())
+        return false;
+    auto ref = doc.find("ref");
+    auto text = doc.find("body");
+    auto base64 = doc.find("body_b64");
+    BodyHash hash;
+    if (ref == doc.end() || !ref->is_string() || !BodyHash::parse(ref->get_ref<const std::string &>(), hash) ||
+        text == doc.end() || !text->is_string() || (base64 != doc.end() && !base64->is_string()))
+        return false;
+
+    StoredBody body;
+    body.text = std::move(text->get_ref<std::string &>());
+    if (base64 != doc.end())
+        body.base64 = std::move(base64->get_ref<std::string &>());
+    // A body that does not match its address is never handed out
+    if (!(hashBody(addressed(body.text, body.base64)) == hash))
+        return false;
+    add(hash, std::move(body));
+    return true;
+}
+
+void BodyResolver::add(const BodyHash &hash, StoredBody body)
+{
+    auto stored = std::make_shared<const StoredBody>(std::move(body));
+    Shard &shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.put(hash, std::move(stored));
+}
+
+std::shared_ptr<const StoredBody> BodyResolver::find(std::string_view ref) const
+{
+    BodyHash hash;
+    if (!BodyHash::parse(ref, hash))
+        return nullptr;
+    Shard &shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto *stored = shard.find(hash);
+    return stored ? *stored : nullptr;
+}
+
+std::shared_ptr<const StoredBody> BodyResolver::body(const RecordView::Section &section)
+{
+    std::string_view ref = section.bodyRef();
+    std::string_view text = section.bodyText();
+    std::string_view base64 = section.bodyBase64();
+    if (!ref.empty() && text.empty() && base64.empty())
+        return find(ref);
+
+    auto inlined = std::make_shared<const StoredBody>(StoredBody{std::string(text), std::string(base64)});
+    BodyHash hash;
+    if (!ref.empty() && BodyHash::parse(ref, hash))
+    {
+        Shard &shard = shardFor(hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.put(hash, inlined);
+    }
+    return inlined;
+}
+
+size_t BodyResolver::size() const
+{
+    size_t n = 0;
+    for (const auto &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        n += shard->index.size();
+    }
+    return n;
+}
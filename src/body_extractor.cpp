@@ -0,0 +1,418 @@
+#include "traffic_processor/body_extractor.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace traffic_processor;
+
+static bool allDigits(std::string_view s)
+{
+    if (s.empty() || s.size() > 18)
+        return false;
+    for (char c : s)
+    {
+        if (c < '0' || c > '9')
+            return false;
+    }
+    return true;
+}
+
+// "/a/b~1c/0": RFC 6901 JSON pointer
+static void parsePointer(std::string_view path, std::vector<std::string> &keys)
+{
+    size_t pos = 1;
+    while (true)
+    {
+        size_t next = path.find('/', pos);
+        std::string_view raw = path.substr(pos, next == std::string_view::npos ? std::string_view::npos : next - pos);
+        std::string key;
+        for (size_t i = 0; i < raw.size(); ++i)
+        {
+            if (raw[i] != '~')
+            {
+                key.push_back(raw[i]);
+                continue;
+            }
+            if (i + 1 == raw.size() || (raw[i + 1] != '0' && raw[i + 1] != '1'))
+                throw std::invalid_argument("Invalid escape in JSON pointer: " + std::string(path));
+            key.push_back(raw[++i] == '0' ? '~' : '/');
+        }
+        keys.push_back(std::move(key));
+        if (next == std::string_view::npos)
+            return;
+        pos = next + 1;
+    }
+}
+
+JsonFieldSet::JsonFieldSet(const std::vector<std::string> &paths)
+{
+    if (paths.size() > 64)
+        throw std::invalid_argument("At most 64 extracted fields per body");
+    for (const auto &spec : paths)
+    {
+        Path path;
+        path.name = spec;
+        std::string_view s = spec;
+        if (!s.empty() && s.front() == '/')
+        {
+            std::vector<std::string> keys;
+            parsePointer(s, keys);
+            for (auto &key : keys)
+            {
+                Segment seg;
+                if (allDigits(key))
+                    seg.index = std::stoll(key);
+                seg.key = std::move(key);
+                path.segments.push_back(std::move(seg));
+            }
+        }
+        else
+        {
+            // "a.b[0].c", optionally rooted with "$"
+            if (!s.empty() && s.front() == '$')
+                s.remove_prefix(s.size() > 1 && s[1] == '.' ? 2 : 1);
+            size_t i = 0;
+            while (i < s.size())
+            {
+                Segment seg;
+                if (s[i] == '[')
+                {
+                    size_t close = s.find(']', i);
+                    std::string_view digits = close == std::string_view::npos ? std::string_view() : s.substr(i + 1, close - i - 1);
+                    if (!allDigits(digits))
+                        throw std::invalid_argument("Invalid array index in field path: " + spec);
+                    seg.index = std::stoll(std::string(digits));
+                    seg.matchesKey = false;
+                    i = close + 1;
+                }
+                else
+                {
+                    size_t stop = s.find_first_of(".[", i);
+                    if (stop == std::string_view::npos)
+                        stop = s.size();
+                    if (stop == i)
+                        throw std::invalid_argument("Empty segment in field path: " + spec);
+                    seg.key = std::string(s.substr(i, stop - i));
+                    i = stop;
+                }
+                path.segments.push_back(std::move(seg));
+                if (i < s.size() && s[i] == '.')
+                {
+                    if (++i == s.size())
+                        throw std::invalid_argument("Empty segment in field path: " + spec);
+                }
+            }
+        }
+        if (path.segments.empty())
+            throw std::invalid_argument("Empty field path");
+        paths_.push_back(std::move(path));
+    }
+}
+
+namespace traffic_processor
+{
+    // Recursive descent over the paths still alive at each level; anything
+    // else is skipped without being decoded. Only the values of requested
+    // fields are handed to the JSON parser.
+    class JsonFieldScanner
+    {
+    public:
+        enum Result
+        {
+            Fail,
+            Ok,
+            Done // every field found; the rest of the body is not read
+        };
+
+        JsonFieldScanner(const std::vector<JsonFieldSet::Path> &paths, std::string_view body, nlohmann::json &out)
+            : paths_(paths), p_(body.data()), end_(body.data() + body.size()), out_(out)
+        {
+            pending_ = paths.size() == 64 ? ~uint64_t{0} : (uint64_t{1} << paths.size()) - 1;
+        }
+
+        bool run()
+        {
+            ws();
+            if (p_ == end_ || (*p_ != '{' && *p_ != '['))
+                return false;
+            Result r = value(pending_, 0);
+            if (r != Ok)
+                return r == Done;
+            ws();
+            return p_ == end_;
+        }
+
+    private:
+        void ws()
+        {
+            while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n'))
+                ++p_;
+        }
+
+        // Closing quote of the string whose content starts at s, or nullptr
+        const char *closingQuote(const char *s) const
+        {
+            while (s < end_)
+            {
+                const char *q = static_cast<const char *>(std::memchr(s, '"', static_cast<size_t>(end_ - s)));
+                if (!q)
+                    return nullptr;
+                const char *b = q;
+                while (b > s && b[-1] == '\\')
+                    --b;
+                if ((q - b) % 2 == 0)
+                    return q;
+                s = q + 1;
+            }
+            return nullptr;
+        }
+
+        bool skip()
+        {
+            ws();
+            if (p_ == end_)
+                return false;
+            char c = *p_;
+            if (c == '"')
+            {
+                const char *q = closingQuote(p_ + 1);
+                if (!q)
+                    return false;
+                p_ = q + 1;
+                return true;
+            }
+            if (c == '{' || c == '[')
+            {
+                int depth = 0;
+                while (p_ < end_)
+                {
+                    c = *p_;
+                    if (c == '"')
+                    {
+                        const char *q = closingQuote(p_ + 1);
+                        if (!q)
+                            return false;
+                        p_ = q;
+                    }
+                    else if (c == '{' || c == '[')
+                        ++depth;
+                    else if ((c == '}' || c == ']') && --depth == 0)
+                    {
+                        ++p_;
+                        return true;
+                    }
+                    ++p_;
+                }
+                return false;
+            }
+            const char *start = p_;
+            while (p_ < end_ && ((*p_ >= '0' && *p_ <= '9') || (*p_ >= 'a' && *p_ <= 'z') || *p_ == '-' || *p_ == '+' ||
+                                 *p_ == '.' || *p_ == 'E'))
+                ++p_;
+            return p_ > start;
+        }
+
+        Result value(uint64_t alive, size_t depth)
+        {
+            ws();
+            if (p_ == end_)
+                return Fail;
+            if (*p_ == '{')
+                return object(alive, depth);
+            if (*p_ == '[')
+                return array(alive, depth);
+            return skip() ? Ok : Fail;
+        }
+
+        // The value of one member or element, reached through segments
+        // matching `matches`
+        template <typename Match>
+        Result child(uint64_t alive, size_t depth, Match matches)
+        {
+            uint64_t capture = 0, deeper = 0;
+            for (uint64_t bits = alive & pending_; bits; bits &= bits - 1)
+            {
+                size_t k = static_cast<size_t>(__builtin_ctzll(bits));
+                const auto &segs = paths_[k].segments;
+                if (!matches(segs[depth]))
+                    continue;
+                if (segs.size() == depth + 1)
+                    capture |= uint64_t{1} << k;
+                else
+                    deeper |= uint64_t{1} << k;
+            }
+            ws();
+            const char *start = p_;
+            Result r = deeper ? value(deeper, depth + 1) : (skip() ? Ok : Fail);
+            if (r != Ok || !capture)
+                return r;
+
+            nlohmann::json v = nlohmann::json::parse(start, p_, nullptr, false);
+            if (v.is_discarded())
+                return Fail;
+            for (uint64_t bits = capture; bits; bits &= bits - 1)
+                out_[paths_[static_cast<size_t>(__builtin_ctzll(bits))].name] = v;
+            pending_ &= ~capture;
+            return pending_ == 0 ? Done : Ok;
+        }
+
+        Result object(uint64_t alive, size_t depth)
+        {
+            ++p_;
+            ws();
+            if (p_ < end_ && *p_ == '}')
+            {
+                ++p_;
+                return Ok;
+            }
+            while (true)
+            {
+                ws();
+                if (p_ == end_ || *p_ != '"')
+                    return Fail;
+                const char *q = closingQuote(p_ + 1);
+                if (!q)
+                    return Fail;
+                std::string_view key(p_ + 1, static_cast<size_t>(q - p_ - 1));
+                std::string decoded;
+                if (key.find('\\') != std::string_view::npos)
+                {
+                    nlohmann::json k = nlohmann::json::parse(p_, q + 1, nullptr, false);
+                    if (!k.is_string())
+                        return Fail;
+                    decoded = k.get<std::string>();
+                    key = decoded;
+                }
+                p_ = q + 1;
+                ws();
+                if (p_ == end_ || *p_ != ':')
+                    return Fail;
+                ++p_;
+
+                Result r = child(alive, depth, [key](const JsonFieldSet::Segment &seg)
+                                 { return seg.matchesKey && seg.key == key; });
+                if (r != Ok)
+                    return r;
+                ws();
+                if (p_ < end_ && *p_ == ',')
+                {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == '}')
+                {
+                    ++p_;
+                    return Ok;
+                }
+                return Fail;
+            }
+        }
+
+        Result array(uint64_t alive, size_t depth)
+        {
+            ++p_;
+            ws();
+            if (p_ < end_ && *p_ == ']')
+            {
+                ++p_;
+                return Ok;
+            }
+            for (int64_t i = 0;; ++i)
+            {
+                Result r = child(alive, depth, [i](const JsonFieldSet::Segment &seg)
+                                 { return seg.index == i; });
+                if (r != Ok)
+                    return r;
+                ws();
+                if (p_ < end_ && *p_ == ',')
+                {
+                    ++p_;
+                    continue;
+                }
+                if (p_ < end_ && *p_ == ']')
+                {
+                    ++p_;
+                    return Ok;
+                }
+                return Fail;
+            }
+        }
+
+        const std::vector<JsonFieldSet::Path> &paths_;
+        const char *p_;
+        const char *end_;
+        nlohmann::json &out_;
+        uint64_t pending_;
+    };
+}
+
+bool JsonFieldSet::extract(std::string_view body, nlohmann::json &out) const
+{
+    if (paths_.empty())
+        return false;
+    nlohmann::json found = nlohmann::json::object();
+    if (!JsonFieldScanner(paths_, body, found).run())
+        return false;
+    if (!out.is_object())
+        out = nlohmann::json::object();
+    for (auto &[key, value] : found.items())
+        out[key] = std::move(value);
+    return true;
+}
+
+// ------------------------------------------------------------------ records
+
+BodyExtractor::BodyExtractor(const ExtractionConfig &config)
+{
+    for (const auto &rule : config.rules)
+    {
+        if (rule.requestFields.empty() && rule.responseFields.empty())
+            continue;
+        // The first rule for a route wins, as with topic rules
+        rules_.emplace(rule.route, Compiled{JsonFieldSet(rule.requestFields), JsonFieldSet(rule.responseFields), rule.keepBody});
+    }
+}
+
+bool BodyExtractor::apply(nlohmann::json &record) const
+{
+    auto req = record.find("request");
+    if (req == record.end() || !req->is_object())
+        return false;
+    std::string_view route;
+    for (const char *key : {"route_template", "path"})
+    {
+        auto it = req->find(key);
+        if (route.empty() && it != req->end() && it->is_string())
+            route = it->get_ref<const std::string &>();
+    }
+    auto rule = rules_.find(route);
+    if (rule == rules_.end())
+        return false;
+
+    bool changed = false;
+    const std::pair<const char *, const JsonFieldSet *> sections[2] = {{"request", &rule->second.request},
+                                                                        {"response", &rule->second.response}};
+    for (const auto &[name, fields] : sections)
+    {
+        if (fields->empty())
+            continue;
+        auto section = record.find(name);
+        if (section == record.end() || !section->is_object())
+            continue;
+        auto body = section->find("body");
+        if (body == section->end() || !body->is_string() || body->get_ref<const std::string &>().empty())
+            continue;
+        nlohmann::json extracted = nlohmann::json::object();
+        if (!fields->extract(body->get_ref<const std::string &>(), extracted))
+            continue;
+        if (!rule->second.keepBody)
+        {
+            section->erase("body");
+            section->erase("body_b64");
+            section->erase("body_truncated");
+        }
+        (*section)["extracted"] = std::move(extracted);
+        changed = true;
+    }
+    return changed;
+}
@@ -0,0 +1,81 @@
+#include "traffic_processor/capture_policy.hpp"
+
+#include <stdexcept>
+#include <string>
+
+using namespace traffic_processor;
+
+namespace
+{
+    template <typename T>
+    bool readField(const nlohmann::json &doc, const char *key, T &out)
+    {
+        auto it = doc.find(key);
+        if (it == doc.end())
+            return false;
+        try
+        {
+            T value = it->get<T>();
+            bool changed = !(value == out);
+            out = value;
+            return changed;
+        }
+        catch (const nlohmann::json::exception &)
+        {
+            throw std::invalid_argument(std::string("invalid type for runtime setting '") + key + "'");
+        }
+    }
+} // namespace
+
+bool traffic_processor::applyPolicyJson(CapturePolicy &policy, const nlohmann::json &doc)
+{
+    if (!doc.is_object())
+        throw std::invalid_argument("runtime configuration must be a JSON object");
+
+    CapturePolicy next = policy;
+    bool changed = false;
+    changed |= readField(doc, "sample_rate", next.sampleRate);
+    changed |= readField(doc, "capture_headers", next.captureHeaders);
+    changed |= readField(doc, "capture_request_body", next.captureRequestBody);
+    changed |= readField(doc, "capture_response_body", next.captureResponseBody);
+    changed |= readField(doc, "max_body_bytes", next.maxBodyBytes);
+    if (next.sampleRate < 0.0 || next.sampleRate > 1.0)
+        throw std::invalid_argument("sample_rate must be within [0, 1]");
+    policy = next;
+    return changed;
+}
+
+bool traffic_processor::applyKafkaJson(KafkaConfig &kafka, const nlohmann::json &doc)
+{
+    auto it = doc.find("kafka");
+    if (it == doc.end())
+        return false;
+    if (!it->is_object())
+        throw std::invalid_argument("'kafka' must be a JSON object");
+
+    const auto &k = *it;
+    KafkaConfig next = kafka;
+    bool changed = false;
+    changed |= readField(k, "linger_ms", next.lingerMs);
+    changed |= readField(k, "batch_num_messages", next.batchNumMessages);
+    changed |= readField(k, "batch_size_bytes", next.batchSizeBytes);
+    changed |= readField(k, "queue_buffering_max_messages", next.queueBufferingMaxMessages);
+    changed |= readField(k, "queue_buffering_max_kbytes", next.queueBufferingMaxKbytes);
+    changed |= readField(k, "compression", next.compression);
+    changed |= readField(k, "acks", next.acks);
+    changed |= readField(k, "retries", next.retries);
+    changed |= readField(k, "request_timeout_ms", next.requestTimeoutMs);
+    kafka = next;
+    return changed;
+}
+
+nlohmann::json traffic_processor::policyToJson(const CapturePolicy &policy)
+{
+    return nlohmann::json{
+        {"sample_rate", policy.sampleRate},
+        {"capture_headers", policy.captureHeaders},
+        {"capture_request_body", policy.captureRequestBody},
+        {"capture_response_body", policy.captureResponseBody},
+        {"max_body_bytes", policy.maxBodyBytes},
+    };
+}
@@ -0,0 +1,778 @@
+#include "traffic_processor/columnar.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include "traffic_processor/record_view.hpp"
+
+#ifdef TRAFFIC_SDK_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace traffic_processor;
+
+namespace
+{
+    constexpr char kMagic[8] = {'T', 'P', 'C', 'O', 'L', '1', '\0', '\0'};
+    constexpr char kEndMagic[8] = {'T', 'P', 'C', 'O', 'L', 'E', 'N', 'D'};
+    constexpr size_t kChunkHeader = 11;
+
+    enum Encoding : uint8_t
+    {
+        Plain,
+        Dictionary,
+        Delta,
+        BitPacked,
+        Varint
+    };
+
+    const char *const kColumnNames[] = {
+        "timestamp", "account_id", "method", "scheme", "host", "path", "query", "route_template", "client_ip",
+        "status", "latency_ms", "request_headers", "request_body", "response_headers", "response_body"};
+    static_assert(sizeof(kColumnNames) / sizeof(kColumnNames[0]) == static_cast<size_t>(Column::Count));
+
+    // Field data of a row, as counted against ColumnarConfig::rowGroupBytes
+    size_t rowBytes(const ColumnarRow &r)
+    {
+        return sizeof(int64_t) * 2 + sizeof(int) + r.accountId.size() + r.method.size() + r.scheme.size() +
+               r.host.size() + r.path.size() + r.query.size() + r.routeTemplate.size() + r.clientIp.size() +
+               r.requestHeaders.size() + r.requestBody.size() + r.responseHeaders.size() + r.responseBody.size();
+    }
+
+    Encoding encodingFor(Column c)
+    {
+        switch (c)
+        {
+        case Column::Timestamp:
+            return Delta;
+        case Column::Status:
+            return BitPacked;
+        case Column::LatencyMs:
+            return Varint;
+        case Column::AccountId:
+        case Column::Method:
+        case Column::Scheme:
+        case Column::Host:
+        case Column::RouteTemplate:
+        case Column::ClientIp:
+            return Dictionary;
+        default:
+            return Plain;
+        }
+    }
+
+    std::string *stringField(ColumnarRow &r, Column c)
+    {
+        switch (c)
+        {
+        case Column::AccountId:
+            return &r.accountId;
+        case Column::Method:
+            return &r.method;
+        case Column::Scheme:
+            return &r.scheme;
+        case Column::Host:
+            return &r.host;
+        case Column::Path:
+            return &r.path;
+        case Column::Query:
+            return &r.query;
+        case Column::RouteTemplate:
+            return &r.routeTemplate;
+        case Column::ClientIp:
+            return &r.clientIp;
+        case Column::RequestHeaders:
+            return &r.requestHeaders;
+        case Column::RequestBody:
+            return &r.requestBody;
+        case Column::ResponseHeaders:
+            return &r.responseHeaders;
+        case Column::ResponseBody:
+            return &r.responseBody;
+        default:
+            return nullptr;
+        }
+    }
+
+    const std::string &stringValue(const ColumnarRow &r, Column c)
+    {
+        return *stringField(const_cast<ColumnarRow &>(r), c);
+    }
+
+    int64_t intField(const ColumnarRow &r, Column c)
+    {
+        return c == Column::Timestamp ? r.timestamp : c == Column::Status ? r.status
+                                                                          : r.latencyMs;
+    }
+
+    void setIntField(ColumnarRow &r, Column c, int64_t v)
+    {
+        if (c == Column::Timestamp)
+            r.timestamp = v;
+        else if (c == Column::Status)
+            r.status = static_cast<int>(v);
+        else
+            r.latencyMs = v;
+    }
+
+    // ---- primitive encoders
+
+    void putU32(std::string &out, uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    void putU64(std::string &out, uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back(static_cast<char>(v >> (8 * i)));
+    }
+
+    void putVarint(std::string &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+    int bitWidth(uint64_t maxValue) { return maxValue == 0 ? 0 : std::bit_width(maxValue); }
+
+    // Values must fit in width bits; width <= 56 (statuses and dictionary
+    // indices need at most 33)
+    void packBits(std::string &out, const std::vector<uint64_t> &values, int width)
+    {
+        out.push_back(static_cast<char>(width));
+        if (width == 0)
+            return;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (uint64_t v : values)
+        {
+            acc |= v << bits;
+            bits += width;
+            while (bits >= 8)
+            {
+                out.push_back(static_cast<char>(acc & 0xff));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0)
+            out.push_back(static_cast<char>(acc & 0xff));
+    }
+
+    // ---- primitive decoders over one chunk
+
+    struct Cursor
+    {
+        const unsigned char *p;
+        const unsigned char *end;
+
+        [[noreturn]] static void truncated() { throw std::runtime_error("Malformed columnar segment: truncated chunk"); }
+
+        uint8_t byte()
+        {
+            if (p >= end)
+                truncated();
+            return *p++;
+        }
+
+        uint64_t varint()
+        {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                uint8_t b = byte();
+                v |= static_cast<uint64_t>(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return v;
+            }
+            truncated();
+        }
+
+        std::string_view bytes(size_t n)
+        {
+            if (static_cast<size_t>(end - p) < n)
+                truncated();
+            std::string_view s(reinterpret_cast<const char *>(p), n);
+            p += n;
+            return s;
+        }
+
+        void unpackBits(size_t count, std::vector<uint64_t> &out)
+        {
+            int width = byte();
+            out.assign(count, 0);
+            if (width == 0)
+                return;
+            if (width > 56 || static_cast<size_t>(end - p) < (count * width + 7) / 8)
+                truncated();
+            uint64_t acc = 0;
+            int bits = 0;
+            const uint64_t mask = (uint64_t{1} << width) - 1;
+            for (size_t i = 0; i < count; ++i)
+            {
+                while (bits < width)
+                {
+                    acc |= static_cast<uint64_t>(*p++) << bits;
+                    bits += 8;
+                }
+                out[i] = acc & mask;
+                acc >>= width;
+                bits -= width;
+            }
+        }
+    };
+
+    uint32_t readU32(const char *p)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        return v;
+    }
+
+    uint64_t readU64(const char *p)
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i)
+            v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        return v;
+    }
+
+    void encodeColumn(Column c, const std::vector<ColumnarRow> &rows, std::string &out)
+    {
+        switch (encodingFor(c))
+        {
+        case Delta:
+        {
+            int64_t prev = 0;
+            for (const auto &r : rows)
+            {
+                int64_t v = intField(r, c);
+                putVarint(out, zigzag(v - prev));
+                prev = v;
+            }
+            break;
+        }
+        case BitPacked:
+        {
+            int64_t lo = intField(rows.front(), c);
+            int64_t hi = lo;
+            for (const auto &r : rows)
+            {
+                lo = std::min(lo, intField(r, c));
+                hi = std::max(hi, intField(r, c));
+            }
+            std::vector<uint64_t> offsets;
+            offsets.reserve(rows.size());
+            for (const auto &r : rows)
+                offsets.push_back(static_cast<uint64_t>(intField(r, c) - lo));
+            putVarint(out, zigzag(lo));
+            packBits(out, offsets, bitWidth(static_cast<uint64_t>(hi - lo)));
+            break;
+        }
+        case Varint:
+            for (const auto &r : rows)
+                putVarint(out, zigzag(intField(r, c)));
+            break;
+        case Dictionary:
+        {
+            std::unordered_map<std::string_view, uint64_t> ids;
+            std::vector<std::string_view> dict;
+            std::vector<uint64_t> indices;
+            indices.reserve(rows.size());
+            for (const auto &r : rows)
+            {
+                std::string_view v = stringValue(r, c);
+                auto [it, inserted] = ids.try_emplace(v, dict.size());
+                if (inserted)
+                    dict.push_back(v);
+                indices.push_back(it->second);
+            }
+            putVarint(out, dict.size());
+            for (std::string_view v : dict)
+            {
+                putVarint(out, v.size());
+                out.append(v);
+            }
+            packBits(out, indices, bitWidth(dict.size() - 1));
+            break;
+        }
+        case Plain:
+            for (const auto &r : rows)
+            {
+                const std::string &v = stringValue(r, c);
+                putVarint(out, v.size());
+                out.append(v);
+            }
+            break;
+        }
+    }
+
+    void decodeColumn(Column c, uint8_t encoding, std::string_view raw, ColumnarRow *rows, size_t count)
+    {
+        Cursor in{reinterpret_cast<const unsigned char *>(raw.data()), reinterpret_cast<const unsigned char *>(raw.data() + raw.size())};
+        const bool isString = stringField(rows[0], c) != nullptr;
+        if (isString != (encoding == Plain || encoding == Dictionary))
+            throw std::runtime_error(std::string("Malformed columnar segment: bad encoding for ") + columnName(c));
+        std::vector<uint64_t> values;
+        switch (encoding)
+        {
+        case Delta:
+        {
+            int64_t prev = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                prev += unzigzag(in.varint());
+                setIntField(rows[i], c, prev);
+            }
+            break;
+        }
+        case BitPacked:
+        {
+            int64_t lo = unzigzag(in.varint());
+            in.unpackBits(count, values);
+            for (size_t i = 0; i < count; ++i)
+                setIntField(rows[i], c, lo + static_cast<int64_t>(values[i]));
+            break;
+        }
+        case Varint:
+            for (size_t i = 0; i < count; ++i)
+                setIntField(rows[i], c, unzigzag(in.varint()));
+            break;
+        case Dictionary:
+        {
+            uint64_t n = in.varint();
+            if (n > raw.size())
+                Cursor::truncated();
+            std::vector<std::string_view> dict(n);
+            for (auto &v : dict)
+                v = in.bytes(in.varint());
+            in.unpackBits(count, values);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (values[i] >= n)
+                    Cursor::truncated();
+                stringField(rows[i], c)->assign(dict[values[i]]);
+            }
+            break;
+        }
+        case Plain:
+            for (size_t i = 0; i < count; ++i)
+                stringField(rows[i], c)->assign(in.bytes(in.varint()));
+            break;
+        default:
+            throw std::runtime_error("Malformed columnar segment: unknown encoding");
+        }
+    }
+}
+
+const char *traffic_processor::columnName(Column column)
+{
+    return column < Column::Count ? kColumnNames[static_cast<size_t>(column)] : "unknown";
+}
+
+Column traffic_processor::columnFromName(std::string_view name)
+{
+    for (size_t i = 0; i < static_cast<size_t>(Column::Count); ++i)
+    {
+        if (name == kColumnNames[i])
+            return static_cast<Column>(i);
+    }
+    throw std::invalid_argument("Unknown column: " + std::string(name));
+}
+
+ColumnarRow ColumnarRow::fromRecord(const RecordView &record)
+{
+    ColumnarRow r;
+    r.timestamp = record.timestamp();
+    r.accountId = record.accountId();
+    const auto &req = record.request();
+    r.method = req.method();
+    r.scheme = req.scheme();
+    r.host = req.host();
+    r.path = req.path();
+    r.query = req.query();
+    r.routeTemplate = req.routeTemplate();
+    r.clientIp = req.ip();
+    r.requestHeaders = req.raw("headers");
+    r.requestBody = req.bodyText();
+    const auto &res = record.response();
+    r.status = res.status();
+    r.responseHeaders = res.raw("headers");
+    r.responseBody = res.bodyText();
+    r.latencyMs = record.latencyMs();
+    return r;
+}
+
+// ------------------------------------------------------------------- writer
+
+ColumnarWriter::ColumnarWriter(const ColumnarConfig &config)
+    : cfg_(config), out_(config.path, std::ios::binary | std::ios::trunc)
+{
+    if (!out_)
+        throw std::runtime_error("Cannot create columnar segment " + cfg_.path);
+    cfg_.rowGroupRows = std::max<size_t>(cfg_.rowGroupRows, 1);
+    cfg_.rowGroupBytes = std::max<size_t>(cfg_.rowGroupBytes, 1);
+#ifndef TRAFFIC_SDK_HAVE_ZLIB
+    bool wantsZlib = cfg_.compression == ColumnCompression::Zlib;
+    for (const auto &kv : cfg_.columnCompression)
+        wantsZlib = wantsZlib || kv.second == ColumnCompression::Zlib;
+    if (wantsZlib)
+        std::cerr << "Columnar writer: built without zlib, columns are stored uncompressed" << std::endl;
+#endif
+    out_.write(kMagic, sizeof(kMagic));
+    offset_ = sizeof(kMagic);
+    pending_.reserve(std::min<size_t>(cfg_.rowGroupRows, 1 << 16));
+}
+
+ColumnarWriter::~ColumnarWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Columnar writer: " << e.what() << std::endl;
+    }
+}
+
+void ColumnarWriter::append(const ColumnarRow &row)
+{
+    append(ColumnarRow(row));
+}
+
+void ColumnarWriter::append(ColumnarRow &&row)
+{
+    if (closed_)
+        throw std::runtime_error("Columnar writer is closed");
+    pendingBytes_ += rowBytes(row);
+    pending_.push_back(std::move(row));
+    ++rows_;
+    if (pending_.size() >= cfg_.rowGroupRows || pendingBytes_ >= cfg_.rowGroupBytes)
+        flushRowGroup();
+}
+
+void ColumnarWriter::append(const RecordView &record)
+{
+    append(ColumnarRow::fromRecord(record));
+}
+
+void ColumnarWriter::writeChunk(Column column, uint8_t encoding, const std::string &raw)
+{
+    auto it = cfg_.columnCompression.find(column);
+    ColumnCompression compression = it != cfg_.columnCompression.end() ? it->second : cfg_.compression;
+    const std::string *stored = &raw;
+    uint8_t storedCompression = static_cast<uint8_t>(ColumnCompression::None);
+#ifdef TRAFFIC_SDK_HAVE_ZLIB
+    if (compression == ColumnCompression::Zlib && raw.size() > 64)
+    {
+        uLongf len = compressBound(static_cast<uLong>(raw.size()));
+        scratch_.resize(len);
+        if (compress2(reinterpret_cast<Bytef *>(scratch_.data()), &len, reinterpret_cast<const Bytef *>(raw.data()),
+                      static_cast<uLong>(raw.size()), cfg_.zlibLevel) == Z_OK &&
+            len < raw.size())
+        {
+            scratch_.resize(len);
+            stored = &scratch_;
+            storedCompression = static_cast<uint8_t>(ColumnCompression::Zlib);
+        }
+    }
+#else
+    (void)compression;
+#endif
+
+    std::string header;
+    header.push_back(static_cast<char>(column));
+    header.push_back(static_cast<char>(encoding));
+    header.push_back(static_cast<char>(storedCompression));
+    putU32(header, static_cast<uint32_t>(raw.size()));
+    putU32(header, static_cast<uint32_t>(stored->size()));
+    out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out_.write(stored->data(), static_cast<std::streamsize>(stored->size()));
+    offset_ += header.size() + stored->size();
+}
+
+void ColumnarWriter::flushRowGroup()
+{
+    if (pending_.empty())
+        return;
+
+    // Every chunk is encoded and checked before the group header goes out,
+    // so a group that cannot be stored is dropped whole. Compression only
+    // ever shrinks a chunk, so the raw size is the one to check.
+    std::string raw[static_cast<size_t>(Column::Count)];
+    for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c)
+    {
+        Column column = static_cast<Column>(c);
+        encodeColumn(column, pending_, raw[c]);
+        if (raw[c].size() > UINT32_MAX)
+        {
+            size_t dropped = pending_.size();
+            rows_ -= dropped;
+            pending_.clear();
+            pendingBytes_ = 0;
+            throw std::runtime_error(std::string("Columnar chunk too large: ") + columnName(column) + ", " +
+                                     std::to_string(dropped) + " rows dropped");
+        }
+    }
+
+    uint64_t groupOffset = offset_;
+    std::string header;
+    putU32(header, static_cast<uint32_t>(pending_.size()));
+    header.push_back(static_cast<char>(Column::Count));
+    out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+    offset_ += header.size();
+    for (size_t c = 0; c < static_cast<size_t>(Column::Count); ++c)
+        writeChunk(static_cast<Column>(c), encodingFor(static_cast<Column>(c)), raw[c]);
+    groups_.emplace_back(groupOffset, static_cast<uint32_t>(pending_.size()));
+    pending_.clear();
+    pendingBytes_ = 0;
+    if (!out_)
+        throw std::runtime_error("Write failed on columnar segment " + cfg_.path);
+}
+
+void ColumnarWriter::close()
+{
+    if (closed_)
+        return;
+    closed_ = true;
+    flushRowGroup();
+    std::string footer;
+    putU32(footer, static_cast<uint32_t>(groups_.size()));
+    for (const auto &[offset, rows] : groups_)
+    {
+        putU64(footer, offset);
+        putU32(footer, rows);
+    }
+    uint32_t footerSize = static_cast<uint32_t>(footer.size());
+    putU32(footer, footerSize);
+    footer.append(kEndMagic, sizeof(kEndMagic));
+    out_.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+    offset_ += footer.size();
+    out_.close();
+    if (out_.fail())
+        throw std::runtime_error("Write failed on columnar segment " + cfg_.path);
+}
+
+// ----------------------------------------------------------------- exporter
+
+ColumnarExporter::ColumnarExporter(const ColumnarConfig &config)
+    : writer_(config), maxRecords_(std::max<size_t>(config.queueRecords, 1)), maxBytes_(config.queueBytes)
+{
+    thread_ = std::thread([this]
+                          { run(); });
+}
+
+ColumnarExporter::~ColumnarExporter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Columnar export: " << e.what() << std::endl;
+    }
+}
+
+bool ColumnarExporter::offer(std::string record)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A record larger than the byte bound still goes through alone
+        bool full = queue_.size() >= maxRecords_ || (!queue_.empty() && queuedBytes_ + record.size() > maxBytes_);
+        if (stop_ || failed_ || full)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        queuedBytes_ += record.size();
+        queue_.push_back(std::move(record));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void ColumnarExporter::run()
+{
+    std::deque<std::string> batch;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]
+                     { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            batch.swap(queue_);
+            queuedBytes_ = 0;
+        }
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            uint64_t before = writer_.rows();
+            try
+            {
+                writer_.append(RecordView(batch[i]));
+                exported_.store(writer_.rows(), std::memory_order_relaxed);
+            }
+            catch (const std::exception &e)
+            {
+                // Rows of a rejected group plus everything still queued
+                std::cerr << "Columnar export disabled: " << e.what() << std::endl;
+                dropped_.fetch_add(before + 1 - writer_.rows() + (batch.size() - i - 1), std::memory_order_relaxed);
+                exported_.store(writer_.rows(), std::memory_order_relaxed);
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                dropped_.fetch_add(queue_.size(), std::memory_order_relaxed);
+                queue_.clear();
+                queuedBytes_ = 0;
+                return;
+            }
+        }
+        batch.clear();
+    }
+}
+
+void ColumnarExporter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+    writer_.close();
+}
+
+// ------------------------------------------------------------------- reader
+
+ColumnarReader::ColumnarReader(const std::string &path)
+    : in_(path, std::ios::binary)
+{
+    if (!in_)
+        throw std::runtime_error("Cannot open columnar segment " + path);
+    char head[8];
+    in_.read(head, sizeof(head));
+    in_.seekg(0, std::ios::end);
+    const auto size = static_cast<uint64_t>(in_.tellg());
+    if (!in_ || size < 8 + 4 + 12 || std::memcmp(head, kMagic, sizeof(kMagic)) != 0)
+        throw std::runtime_error("Not a columnar segment: " + path);
+
+    char tail[12];
+    in_.seekg(static_cast<std::streamoff>(size - sizeof(tail)));
+    in_.read(tail, sizeof(tail));
+    uint32_t footerSize = readU32(tail);
+    if (std::memcmp(tail + 4, kEndMagic, sizeof(kEndMagic)) != 0 || footerSize + sizeof(tail) + 8 > size)
+        throw std::runtime_error("Columnar segment has no footer (not closed?): " + path);
+
+    std::string footer(footerSize, '\0');
+    in_.seekg(static_cast<std::streamoff>(size - sizeof(tail) - footerSize));
+    in_.read(footer.data(), footerSize);
+    uint32_t count = footerSize >= 4 ? readU32(footer.data()) : 0;
+    if (!in_ || footerSize != 4 + static_cast<uint64_t>(count) * 12)
+        throw std::runtime_error("Malformed columnar segment footer: " + path);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const char *p = footer.data() + 4 + i * 12;
+        groups_.emplace_back(readU64(p), readU32(p + 8));
+    }
+}
+
+uint64_t ColumnarReader::rows() const
+{
+    uint64_t n = 0;
+    for (const auto &g : groups_)
+        n += g.second;
+    return n;
+}
+
+void ColumnarReader::read(size_t group, const std::vector<Column> &columns, std::vector<ColumnarRow> &out)
+{
+    if (group >= groups_.size())
+        throw std::out_of_range("Row group out of range");
+    bool wanted[static_cast<size_t>(Column::Count)] = {};
+    for (Column c : columns)
+    {
+        if (c < Column::Count)
+            wanted[static_cast<size_t>(c)] = true;
+    }
+
+    in_.clear();
+    in_.seekg(static_cast<std::streamoff>(groups_[group].first));
+    char header[5];
+    in_.read(header, sizeof(header));
+    uint32_t rows = readU32(header);
+    uint8_t chunks = static_cast<uint8_t>(header[4]);
+    if (!in_ || rows != groups_[group].second)
+        throw std::runtime_error("Malformed columnar segment: row group header");
+    if (rows == 0)
+        return;
+
+    size_t base = out.size();
+    out.resize(base + rows);
+    for (uint8_t i = 0; i < chunks; ++i)
+    {
+        char ch[kChunkHeader];
+        in_.read(ch, sizeof(ch));
+        if (!in_)
+            throw std::runtime_error("Malformed columnar segment: truncated row group");
+        auto column = static_cast<Column>(ch[0]);
+        uint8_t encoding = static_cast<uint8_t>(ch[1]);
+        auto compression = static_cast<ColumnCompression>(ch[2]);
+        uint32_t rawSize = readU32(ch + 3);
+        uint32_t storedSize = readU32(ch + 7);
+        if (column >= Column::Count || !wanted[static_cast<size_t>(column)])
+        {
+            // Projection: unrequested columns are never read or decoded
+            in_.seekg(storedSize, std::ios::cur);
+            continue;
+        }
+
+        chunk_.resize(storedSize);
+        in_.read(chunk_.data(), storedSize);
+        if (!in_)
+            throw std::runtime_error("Malformed columnar segment: truncated chunk");
+        std::string_view raw = chunk_;
+        if (compression == ColumnCompression::Zlib)
+        {
+#ifdef TRAFFIC_SDK_HAVE_ZLIB
+            raw_.resize(rawSize);
+            uLongf len = rawSize;
+            if (uncompress(reinterpret_cast<Bytef *>(raw_.data()), &len, reinterpret_cast<const Bytef *>(chunk_.data()), storedSize) != Z_OK ||
+                len != rawSize)
+                throw std::runtime_error("Malformed columnar segment: bad zlib chunk");
+            raw = raw_;
+#else
+            throw std::runtime_error("Columnar segment needs zlib, which this build lacks");
+#endif
+        }
+        else if (compression != ColumnCompression::None || rawSize != storedSize)
+        {
+            throw std::runtime_error("Malformed columnar segment: unknown compression");
+        }
+        decodeColumn(column, encoding, raw, out.data() + base, rows);
+    }
+}
+
+std::vector<ColumnarRow> ColumnarReader::readAll(const std::vector<Column> &columns)
+{
+    std::vector<ColumnarRow> out;
+    out.reserve(rows());
+    for (size_t g = 0; g < groups_.size(); ++g)
+        read(g, columns, out);
+    return out;
+}
@@ -0,0 +1,350 @@
+#include "traffic_processor/consumer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include "traffic_processor/body_resolver.hpp"
+
+using namespace traffic_processor;
+
+nlohmann::json ConsumerStats::toJson() const
+{
+    return nlohmann::json{
+        {"messages", messages},
+        {"records", records},
+        {"bytes", bytes},
+        {"malformed", malformed},
+        {"bodies", bodies},
+        {"filtered", filtered},
+        {"handler_errors", handlerErrors},
+        {"commits", commits},
+        {"commit_errors", commitErrors},
+        {"rebalances", rebalances},
+    };
+}
+
+TrafficConsumer::TrafficConsumer(const ConsumerConfig &config, Handler handler)
+    : config_(config), handler_(std::move(handler))
+{
+    if (config_.workers < 1)
+        config_.workers = 1;
+    if (config_.batchSize == 0)
+        config_.batchSize = 1;
+
+    rd_kafka_conf_t *conf = rd_kafka_conf_new();
+    char errstr[512];
+    const std::pair<const char *, std::string> settings[] = {
+        {"bootstrap.servers", config_.bootstrapServers},
+        {"group.id", config_.groupId},
+        {"auto.offset.reset", config_.autoOffsetReset},
+        // Offsets are stored once the handler is done and committed in batches
+        {"enable.auto.commit", "false"},
+        {"enable.auto.offset.store", "false"},
+    };
+    for (const auto &[key, value] : settings)
+    {
+        if (rd_kafka_conf_set(conf, key, value.c_str(), errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK)
+        {
+            std::cerr << "Failed to set " << key << ": " << errstr << std::endl;
+            rd_kafka_conf_destroy(conf);
+            throw std::runtime_error("Failed to configure Kafka consumer");
+        }
+    }
+    for (const auto &kv : config_.extraProperties)
+    {
+        if (rd_kafka_conf_set(conf, kv.first.c_str(), kv.second.c_str(), errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK)
+        {
+            std::cerr << "Ignoring consumer property " << kv.first << ": " << errstr << std::endl;
+        }
+    }
+    rd_kafka_conf_set_opaque(conf, this);
+    rd_kafka_conf_set_rebalance_cb(conf, &TrafficConsumer::rebalanceCallback);
+
+    consumer_ = rd_kafka_new(RD_KAFKA_CONSUMER, conf, errstr, sizeof(errstr));
+    if (!consumer_)
+    {
+        std::cerr << "Failed to create consumer: " << errstr << std::endl;
+        throw std::runtime_error("Failed to create Kafka consumer");
+    }
+    rd_kafka_poll_set_consumer(consumer_);
+
+    for (int i = 0; i < config_.workers; ++i)
+        queues_.push_back(rd_kafka_queue_new(consumer_));
+}
+
+TrafficConsumer::~TrafficConsumer()
+{
+    stop();
+    for (auto &t : threads_)
+    {
+        if (t.joinable())
+            t.join();
+    }
+    for (auto *q : queues_)
+        rd_kafka_queue_destroy(q);
+    if (consumer_)
+        rd_kafka_destroy(consumer_);
+}
+
+size_t TrafficConsumer::workerFor(const char *topic, int32_t partition) const
+{
+    return (std::hash<std::string_view>{}(topic) + static_cast<size_t>(partition)) % queues_.size();
+}
+
+void TrafficConsumer::rebalanceCallback(rd_kafka_t *rk, rd_kafka_resp_err_t err,
+                                        rd_kafka_topic_partition_list_t *partitions, void *opaque)
+{
+    auto *self = static_cast<TrafficConsumer *>(opaque);
+    self->rebalances_.fetch_add(1, std::memory_order_relaxed);
+    if (err == RD_KAFKA_RESP_ERR__ASSIGN_PARTITIONS)
+    {
+        // Route each partition's fetch queue to its worker before fetching
+        // starts; librdkafka keeps application-set forwarding on assign
+        for (int i = 0; i < partitions->cnt; ++i)
+        {
+            const auto &tp = partitions->elems[i];
+            if (rd_kafka_queue_t *q = rd_kafka_queue_get_partition(rk, tp.topic, tp.partition))
+            {
+                rd_kafka_queue_forward(q, self->queues_[self->workerFor(tp.topic, tp.partition)]);
+                rd_kafka_queue_destroy(q);
+            }
+        }
+        rd_kafka_assign(rk, partitions);
+    }
+    else
+    {
+        // Keep the work done on partitions we are about to lose
+        self->commitStored(false);
+        for (int i = 0; i < partitions->cnt; ++i)
+        {
+            const auto &tp = partitions->elems[i];
+            if (rd_kafka_queue_t *q = rd_kafka_queue_get_partition(rk, tp.topic, tp.partition))
+            {
+                rd_kafka_queue_forward(q, nullptr);
+                rd_kafka_queue_destroy(q);
+            }
+        }
+        rd_kafka_assign(rk, nullptr);
+    }
+}
+
+void TrafficConsumer::run()
+{
+    rd_kafka_topic_partition_list_t *topics = rd_kafka_topic_partition_list_new(static_cast<int>(config_.topics.size()) + 1);
+    for (const auto &t : config_.topics)
+        rd_kafka_topic_partition_list_add(topics, t.c_str(), RD_KAFKA_PARTITION_UA);
+    if (config_.bodies && std::find(config_.topics.begin(), config_.topics.end(), config_.bodyTopic) == config_.topics.end())
+        rd_kafka_topic_partition_list_add(topics, config_.bodyTopic.c_str(), RD_KAFKA_PARTITION_UA);
+    rd_kafka_resp_err_t err = rd_kafka_subscribe(consumer_, topics);
+    rd_kafka_topic_partition_list_destroy(topics);
+    if (err)
+        throw std::runtime_error(std::string("Failed to subscribe: ") + rd_kafka_err2str(err));
+
+    for (size_t i = 0; i < queues_.size(); ++i)
+        threads_.emplace_back([this, i]
+                              { workerLoop(i); });
+
+    // This thread serves the consumer queue: rebalances, errors and any
+    // message that was not routed to a worker
+    RecordView view;
+    std::vector<std::string_view> records;
+    rd_kafka_topic_partition_list_t *offsets = rd_kafka_topic_partition_list_new(1);
+    auto lastCommit = std::chrono::steady_clock::now();
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+        if (rd_kafka_message_t *msg = rd_kafka_consumer_poll(consumer_, 100))
+            process(&msg, 1, view, records, offsets);
+
+        auto now = std::chrono::steady_clock::now();
+        if (uncommitted_.load(std::memory_order_relaxed) >= config_.commitEveryMessages ||
+            (uncommitted_.load(std::memory_order_relaxed) > 0 && now - lastCommit >= std::chrono::milliseconds(config_.commitIntervalMs)))
+        {
+            commitStored(true);
+            lastCommit = now;
+        }
+    }
+    rd_kafka_topic_partition_list_destroy(offsets);
+
+    for (auto &t : threads_)
+        t.join();
+    threads_.clear();
+    commitStored(false);
+    rd_kafka_consumer_close(consumer_);
+}
+
+void TrafficConsumer::workerLoop(size_t worker)
+{
+    std::vector<rd_kafka_message_t *> batch(config_.batchSize);
+    RecordView view;
+    std::vector<std::string_view> records;
+    rd_kafka_topic_partition_list_t *offsets = rd_kafka_topic_partition_list_new(8);
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+        ssize_t n = rd_kafka_consume_batch_queue(queues_[worker], 100, batch.data(), batch.size());
+        if (n > 0)
+            process(batch.data(), static_cast<size_t>(n), view, records, offsets);
+    }
+    rd_kafka_topic_partition_list_destroy(offsets);
+}
+
+// Views of the record headers of a message; fields are empty when absent
+static RecordHeaders messageHeaders(const rd_kafka_message_t *msg)
+{
+    RecordHeaders h;
+    rd_kafka_headers_t *headers = nullptr;
+    if (rd_kafka_message_headers(msg, &headers) != RD_KAFKA_RESP_ERR_NO_ERROR || !headers)
+        return h;
+    auto get = [headers](const char *name)
+    {
+        const void *value = nullptr;
+        size_t size = 0;
+        if (rd_kafka_header_get_last(headers, name, &value, &size) != RD_KAFKA_RESP_ERR_NO_ERROR || !value)
+            return std::string_view();
+        return std::string_view(static_cast<const char *>(value), size);
+    };
+    h.accountId = get(record_headers::AccountId);
+    h.method = get(record_headers::Method);
+    h.status = get(record_headers::Status);
+    h.host = get(record_headers::Host);
+    h.route = get(record_headers::Route);
+    h.schemaVersion = get(record_headers::SchemaVersion);
+    h.contentEncoding = get(record_headers::ContentEncoding);
+    return h;
+}
+
+void TrafficConsumer::process(rd_kafka_message_t **messages, size_t count, RecordView &view,
+                              std::vector<std::string_view> &records, rd_kafka_topic_partition_list_t *offsets)
+{
+    for (size_t m = 0; m < count; ++m)
+    {
+        rd_kafka_message_t *msg = messages[m];
+        if (msg->err)
+        {
+            if (msg->err != RD_KAFKA_RESP_ERR__PARTITION_EOF)
+                std::cerr << "KAFKA CONSUMER ERROR: " << rd_kafka_err2str(msg->err) << std::endl;
+            rd_kafka_message_destroy(msg);
+            continue;
+        }
+
+        RecordMeta meta;
+        meta.topic = rd_kafka_topic_name(msg->rkt);
+        meta.partition = msg->partition;
+        meta.offset = msg->offset;
+        if (msg->key)
+            meta.key = std::string_view(static_cast<const char *>(msg->key), msg->key_len);
+        meta.headers = messageHeaders(msg);
+
+        std::string_view payload(static_cast<const char *>(msg->payload), msg->len);
+        records.clear();
+        if (config_.bodies && meta.topic == config_.bodyTopic)
+        {
+            // Tombstones (null payloads) of the compacted topic carry nothing
+            if (msg->len > 0)
+                (config_.bodies->add(payload) ? bodies_ : malformed_).fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (config_.filter && !accepted(meta.headers))
+            filtered_.fetch_add(1, std::memory_order_relaxed);
+        else if (!splitRecords(payload, records))
+            malformed_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            view.reset(records[i]);
+            if (!view.valid())
+            {
+                malformed_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            meta.indexInMessage = i;
+            try
+            {
+                handler_(view, meta);
+            }
+            catch (const std::exception &e)
+            {
+                if (handlerErrors_.fetch_add(1, std::memory_order_relaxed) == 0)
+                    std::cerr << "Consumer handler failed: " << e.what() << std::endl;
+            }
+        }
+        messages_.fetch_add(1, std::memory_order_relaxed);
+        records_.fetch_add(records.size(), std::memory_order_relaxed);
+        bytes_.fetch_add(msg->len, std::memory_order_relaxed);
+
+        // Remember the next offset to read; batches are ordered per partition
+        bool merged = false;
+        for (int i = 0; i < offsets->cnt && !merged; ++i)
+        {
+            auto &tp = offsets->elems[i];
+            if (tp.partition == msg->partition && meta.topic == tp.topic)
+            {
+                tp.offset = msg->offset + 1;
+                merged = true;
+            }
+        }
+        if (!merged)
+            rd_kafka_topic_partition_list_add(offsets, meta.topic.data(), msg->partition)->offset = msg->offset + 1;
+        rd_kafka_message_destroy(msg);
+    }
+
+    if (offsets->cnt > 0)
+    {
+        rd_kafka_offsets_store(consumer_, offsets);
+        uncommitted_.fetch_add(count, std::memory_order_relaxed);
+        // Empty the list: an entry left behind would store an invalid
+        // offset over its partition's progress in the next batch
+        while (offsets->cnt > 0)
+            rd_kafka_topic_partition_list_del_by_idx(offsets, offsets->cnt - 1);
+    }
+}
+
+bool TrafficConsumer::accepted(const RecordHeaders &headers)
+{
+    try
+    {
+        return config_.filter(headers);
+    }
+    catch (const std::exception &e)
+    {
+        // Counted like a failing handler; the message is skipped
+        if (handlerErrors_.fetch_add(1, std::memory_order_relaxed) == 0)
+            std::cerr << "Consumer filter failed: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool TrafficConsumer::commitStored(bool async)
+{
+    uncommitted_.store(0, std::memory_order_relaxed);
+    rd_kafka_resp_err_t err = rd_kafka_commit(consumer_, nullptr, async ? 1 : 0);
+    if (err && err != RD_KAFKA_RESP_ERR__NO_OFFSET)
+    {
+        commitErrors_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "KAFKA CONSUMER: commit failed - " << rd_kafka_err2str(err) << std::endl;
+        return false;
+    }
+    if (!err)
+        commits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TrafficConsumer::commit()
+{
+    commitStored(false);
+}
+
+ConsumerStats TrafficConsumer::stats() const
+{
+    ConsumerStats s;
+    s.messages = messages_.load(std::memory_order_relaxed);
+    s.records = records_.load(std::memory_order_relaxed);
+    s.bytes = bytes_.load(std::memory_order_relaxed);
+    s.malformed = malformed_.load(std::memory_order_relaxed);
+    s.bodies = bodies_.load(std::memory_order_relaxed);
+    s.filtered = filtered_.load(std::memory_order_relaxed);
+    s.handlerErrors = handlerErrors_.load(std::memory_order_relaxed);
+    s.commits = commits_.load(std::memory_order_relaxed);
+    s.commitErrors = commitErrors_.load(std::memory_order_relaxed);
+    s.rebalances = rebalances_.load(std::memory_order_relaxed);
+    return s;
+}
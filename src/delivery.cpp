@@ -0,0 +1,257 @@
+#include "traffic_processor/delivery.hpp"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace traffic_processor;
+
+namespace traffic_processor
+{
+    // Free list over states allocated in chunks; never shrinks. Leaked on
+    // purpose so producers torn down during static destruction can still
+    // settle their messages.
+    struct DeliveryPool
+    {
+        static constexpr size_t kChunk = 256;
+
+        std::mutex mutex;
+        DeliveryState *free{nullptr};
+        std::vector<std::unique_ptr<DeliveryState[]>> chunks;
+
+        static DeliveryPool &instance()
+        {
+            static DeliveryPool *pool = new DeliveryPool();
+            return *pool;
+        }
+
+        DeliveryState *take()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free)
+            {
+                chunks.emplace_back(new DeliveryState[kChunk]);
+                DeliveryState *chunk = chunks.back().get();
+                for (size_t i = 0; i < kChunk; ++i)
+                {
+                    chunk[i].nextFree_ = free;
+                    free = &chunk[i];
+                }
+            }
+            DeliveryState *s = free;
+            free = s->nextFree_;
+            return s;
+        }
+
+        void give(DeliveryState *s)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            s->nextFree_ = free;
+            free = s;
+        }
+    };
+}
+
+namespace
+{
+    // States completed on this thread whose continuation has yet to run
+    thread_local std::vector<DeliveryState *> completed;
+}
+
+const char *traffic_processor::toString(DeliveryStatus status)
+{
+    switch (status)
+    {
+    case DeliveryStatus::Pending:
+        return "pending";
+    case DeliveryStatus::Delivered:
+        return "delivered";
+    case DeliveryStatus::Spilled:
+        return "spilled";
+    case DeliveryStatus::Failed:
+        return "failed";
+    case DeliveryStatus::Dropped:
+        return "dropped";
+    case DeliveryStatus::Skipped:
+        return "skipped";
+    }
+    return "unknown";
+}
+
+// ------------------------------------------------------------------- state
+
+DeliveryState *DeliveryState::acquire()
+{
+    DeliveryState *s = DeliveryPool::instance().take();
+    s->status_.store(DeliveryStatus::Pending, std::memory_order_relaxed);
+    s->worst_.store(DeliveryStatus::Delivered, std::memory_order_relaxed);
+    s->outstanding_.store(0, std::memory_order_relaxed);
+    s->waiter_.store(NoWaiter, std::memory_order_relaxed);
+    s->refs_.store(1, std::memory_order_release);
+    return s;
+}
+
+void DeliveryState::release()
+{
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        coroutine_ = {};
+        callback_ = nullptr;
+        DeliveryPool::instance().give(this);
+    }
+}
+
+void DeliveryState::expect(int messages)
+{
+    // Messages in flight hold one reference between them
+    if (outstanding_.fetch_add(messages, std::memory_order_acq_rel) == 0)
+        refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DeliveryState::settle(DeliveryStatus status)
+{
+    DeliveryStatus worst = worst_.load(std::memory_order_relaxed);
+    while (status > worst && !worst_.compare_exchange_weak(worst, status, std::memory_order_relaxed))
+    {
+    }
+    if (outstanding_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    status_.store(worst_.load(std::memory_order_relaxed), std::memory_order_release);
+    status_.notify_all();
+    if (waiter_.exchange(Done, std::memory_order_acq_rel) == Waiting)
+        completed.push_back(this); // keeps the in-flight reference until run
+    else
+        release();
+}
+
+bool DeliveryState::suspend(std::coroutine_handle<> coroutine)
+{
+    coroutine_ = coroutine;
+    uint8_t expected = NoWaiter;
+    if (waiter_.compare_exchange_strong(expected, Waiting, std::memory_order_acq_rel))
+        return true;
+    coroutine_ = {};
+    return false;
+}
+
+bool DeliveryState::then(DeliveryCallback &callback)
+{
+    callback_ = std::move(callback);
+    uint8_t expected = NoWaiter;
+    if (waiter_.compare_exchange_strong(expected, Waiting, std::memory_order_acq_rel))
+        return true;
+    callback = std::move(callback_);
+    callback_ = nullptr;
+    return false;
+}
+
+void DeliveryState::wait() const
+{
+    while (status_.load(std::memory_order_acquire) == DeliveryStatus::Pending)
+        status_.wait(DeliveryStatus::Pending, std::memory_order_acquire);
+}
+
+void DeliveryState::runCompleted()
+{
+    // Continuations may complete further states; they join the next round
+    std::vector<DeliveryState *> batch;
+    while (!completed.empty())
+    {
+        batch.swap(completed);
+        for (DeliveryState *s : batch)
+        {
+            try
+            {
+                if (s->coroutine_)
+                {
+                    std::coroutine_handle<> coroutine = s->coroutine_;
+                    s->coroutine_ = {};
+                    coroutine.resume();
+                }
+                else if (s->callback_)
+                {
+                    DeliveryCallback callback = std::move(s->callback_);
+                    s->callback_ = nullptr;
+                    callback(s->status());
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Delivery continuation failed: " << e.what() << std::endl;
+            }
+            s->release();
+        }
+        batch.clear();
+    }
+}
+
+size_t DeliveryState::pooled()
+{
+    DeliveryPool &pool = DeliveryPool::instance();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.chunks.size() * DeliveryPool::kChunk;
+}
+
+// ------------------------------------------------------------------ future
+
+DeliveryFuture DeliveryFuture::pending()
+{
+    DeliveryFuture f;
+    f.state_ = DeliveryState::acquire();
+    f.status_ = DeliveryStatus::Pending;
+    return f;
+}
+
+DeliveryFuture::DeliveryFuture(DeliveryFuture &&other) noexcept : state_(other.state_), status_(other.status_)
+{
+    other.state_ = nullptr;
+}
+
+DeliveryFuture &DeliveryFuture::operator=(DeliveryFuture &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (state_)
+            state_->release();
+        state_ = other.state_;
+        status_ = other.status_;
+        other.state_ = nullptr;
+    }
+    return *this;
+}
+
+DeliveryFuture::~DeliveryFuture()
+{
+    if (state_)
+        state_->release();
+}
+
+DeliveryStatus DeliveryFuture::wait() const
+{
+    if (state_)
+        state_->wait();
+    return status();
+}
+
+DeliveryStatus DeliveryFuture::waitFor(std::chrono::milliseconds timeout) const
+{
+    // Backs off from 50us to 1ms; atomics have no timed wait
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    auto pause = std::chrono::microseconds(50);
+    DeliveryStatus s;
+    while ((s = status()) == DeliveryStatus::Pending && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(pause);
+        pause = std::min<std::chrono::microseconds>(pause * 2, std::chrono::milliseconds(1));
+    }
+    return s;
+}
+
+void DeliveryFuture::then(DeliveryCallback callback)
+{
+    if (!state_ || !state_->then(callback))
+        callback(status());
+}
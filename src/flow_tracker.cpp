@@ -0,0 +1,541 @@
+#include "traffic_processor/flow_tracker.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace traffic_processor;
+
+namespace
+{
+    uint16_t read16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t read32(const uint8_t *p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    }
+
+    constexpr uint16_t EtherIpv4 = 0x0800;
+    constexpr uint16_t EtherIpv6 = 0x86dd;
+
+    std::string formatIp(const std::array<uint8_t, 16> &ip, bool ipv6)
+    {
+        char buf[48];
+        if (!ipv6)
+        {
+            std::snprintf(buf, sizeof(buf), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+            return buf;
+        }
+        // RFC 5952: longest run of two or more zero groups becomes "::"
+        uint16_t groups[8];
+        for (int i = 0; i < 8; ++i)
+            groups[i] = read16(ip.data() + 2 * i);
+        int bestStart = -1, bestLen = 0;
+        for (int i = 0; i < 8;)
+        {
+            int j = i;
+            while (j < 8 && groups[j] == 0)
+                ++j;
+            if (j - i > bestLen && j - i >= 2)
+            {
+                bestStart = i;
+                bestLen = j - i;
+            }
+            i = j == i ? i + 1 : j;
+        }
+        std::string out;
+        for (int i = 0; i < 8; ++i)
+        {
+            if (i == bestStart)
+            {
+                out += "::";
+                i += bestLen - 1;
+                continue;
+            }
+            if (!out.empty() && out.back() != ':')
+                out += ':';
+            std::snprintf(buf, sizeof(buf), "%x", groups[i]);
+            out += buf;
+        }
+        return out;
+    }
+
+    // Proxies send absolute-form targets; keep path and query only
+    std::string originForm(std::string target)
+    {
+        if (target.compare(0, 7, "http://") == 0 || target.compare(0, 8, "https://") == 0)
+        {
+            size_t slash = target.find('/', target.find("//") + 2);
+            return slash == std::string::npos ? "/" : target.substr(slash);
+        }
+        return target;
+    }
+
+    nlohmann::json headersToJson(const std::vector<std::pair<std::string, std::string>> &headers)
+    {
+        nlohmann::json out = nlohmann::json::object();
+        for (const auto &[k, v] : headers)
+        {
+            auto it = out.find(k);
+            if (it == out.end())
+                out[k] = v;
+            else
+                it->get_ref<std::string &>().append(", ").append(v);
+        }
+        return out;
+    }
+}
+
+bool traffic_processor::decodeTcpSegment(int linkType, const uint8_t *frame, size_t len, uint64_t tsNs, TcpSegment &out)
+{
+    size_t off = 0;
+    uint16_t etherType = 0;
+    switch (linkType)
+    {
+    case LinkEthernet:
+        if (len < 14)
+            return false;
+        etherType = read16(frame + 12);
+        off = 14;
+        while ((etherType == 0x8100 || etherType == 0x88a8) && len >= off + 4)
+        {
+            etherType = read16(frame + off + 2);
+            off += 4;
+        }
+        break;
+    case LinkLinuxSll:
+        if (len < 16)
+            return false;
+        etherType = read16(frame + 14);
+        off = 16;
+        break;
+    case LinkNull:
+    {
+        if (len < 4)
+            return false;
+        uint32_t family;
+        std::memcpy(&family, frame, 4); // host byte order of the capturing machine
+        if (family > 0xffff)
+            family = __builtin_bswap32(family);
+        etherType = family == 2 ? EtherIpv4 : (family == 24 || family == 28 || family == 30) ? EtherIpv6 : 0;
+        off = 4;
+        break;
+    }
+    case LinkRaw:
+        if (len < 1)
+            return false;
+        etherType = (frame[0] >> 4) == 4 ? EtherIpv4 : (frame[0] >> 4) == 6 ? EtherIpv6 : 0;
+        break;
+    default:
+        return false;
+    }
+
+    const uint8_t *ip = frame + off;
+    size_t ipLen = len - off;
+    size_t tcpOff = 0;
+    if (etherType == EtherIpv4)
+    {
+        if (ipLen < 20 || (ip[0] >> 4) != 4)
+            return false;
+        size_t ihl = static_cast<size_t>(ip[0] & 0x0f) * 4;
+        size_t total = read16(ip + 2);
+        if (ihl < 20 || total < ihl || ipLen < ihl)
+            return false;
+        ipLen = std::min(ipLen, total); // drop Ethernet padding
+        if ((read16(ip + 6) & 0x3fff) != 0 || ip[9] != 6)
+            return false; // fragment, or not TCP
+        out.ipv6 = false;
+        out.srcIp = {};
+        out.dstIp = {};
+        std::memcpy(out.srcIp.data(), ip + 12, 4);
+        std::memcpy(out.dstIp.data(), ip + 16, 4);
+        tcpOff = ihl;
+    }
+    else if (etherType == EtherIpv6)
+    {
+        if (ipLen < 40 || (ip[0] >> 4) != 6)
+            return false;
+        ipLen = std::min(ipLen, static_cast<size_t>(40 + read16(ip + 4)));
+        uint8_t next = ip[6];
+        tcpOff = 40;
+        // Hop-by-hop, routing and destination options; fragments are skipped
+        while (next == 0 || next == 43 || next == 60)
+        {
+            if (ipLen < tcpOff + 8)
+                return false;
+            next = ip[tcpOff];
+            tcpOff += (static_cast<size_t>(ip[tcpOff + 1]) + 1) * 8;
+        }
+        if (next != 6)
+            return false;
+        out.ipv6 = true;
+        std::memcpy(out.srcIp.data(), ip + 8, 16);
+        std::memcpy(out.dstIp.data(), ip + 24, 16);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (ipLen < tcpOff + 20)
+        return false;
+    const uint8_t *tcp = ip + tcpOff;
+    size_t tcpLen = ipLen - tcpOff;
+    size_t dataOff = static_cast<size_t>(tcp[12] >> 4) * 4;
+    if (dataOff < 20 || dataOff > tcpLen)
+        return false;
+
+    out.srcPort = read16(tcp);
+    out.dstPort = read16(tcp + 2);
+    out.seq = read32(tcp + 4);
+    out.flags = tcp[13];
+    out.payload = tcp + dataOff;
+    out.payloadLen = tcpLen - dataOff;
+    out.tsNs = tsNs;
+    return true;
+}
+
+FlowTrackerStats &FlowTrackerStats::operator+=(const FlowTrackerStats &o)
+{
+    segments += o.segments;
+    flows += o.flows;
+    pairs += o.pairs;
+    outOfOrder += o.outOfOrder;
+    retransmits += o.retransmits;
+    gaps += o.gaps;
+    parseErrors += o.parseErrors;
+    unmatched += o.unmatched;
+    flowsDropped += o.flowsDropped;
+    expired += o.expired;
+    return *this;
+}
+
+nlohmann::json FlowTrackerStats::toJson() const
+{
+    return nlohmann::json{
+        {"segments", segments},
+        {"flows", flows},
+        {"pairs", pairs},
+        {"out_of_order", outOfOrder},
+        {"retransmits", retransmits},
+        {"gaps", gaps},
+        {"parse_errors", parseErrors},
+        {"unmatched", unmatched},
+        {"flows_dropped", flowsDropped},
+        {"expired", expired},
+    };
+}
+
+size_t HttpFlowTracker::FlowKeyHash::operator()(const FlowKey &k) const
+{
+    // FNV-1a over both endpoints
+    uint64_t h = 1469598103934665603ULL;
+    auto mix = [&h](const uint8_t *p, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ p[i]) * 1099511628211ULL;
+    };
+    mix(k.client.ip.data(), k.client.ip.size());
+    mix(k.server.ip.data(), k.server.ip.size());
+    uint16_t ports[2] = {k.client.port, k.server.port};
+    mix(reinterpret_cast<const uint8_t *>(ports), sizeof(ports));
+    return static_cast<size_t>(h);
+}
+
+HttpFlowTracker::HttpFlowTracker(const FlowTrackerConfig &config, Sink sink)
+    : cfg_(config), sink_(std::move(sink))
+{
+}
+
+bool HttpFlowTracker::isServerPort(uint16_t port) const
+{
+    return std::find(cfg_.ports.begin(), cfg_.ports.end(), port) != cfg_.ports.end();
+}
+
+void HttpFlowTracker::process(const TcpSegment &seg)
+{
+    stats_.segments++;
+    const Endpoint src{seg.srcIp, seg.srcPort};
+    const Endpoint dst{seg.dstIp, seg.dstPort};
+
+    bool toServer;
+    FlowKey key;
+    if (isServerPort(seg.dstPort))
+    {
+        toServer = true;
+        key = {src, dst};
+    }
+    else if (isServerPort(seg.srcPort))
+    {
+        toServer = false;
+        key = {dst, src};
+    }
+    else if (cfg_.ports.empty())
+    {
+        // No configured ports: the side sending the initial SYN is the client
+        if (flows_.count(FlowKey{src, dst}))
+        {
+            toServer = true;
+            key = {src, dst};
+        }
+        else if (flows_.count(FlowKey{dst, src}))
+        {
+            toServer = false;
+            key = {dst, src};
+        }
+        else if ((seg.flags & (TcpSegment::Syn | TcpSegment::Ack)) == TcpSegment::Syn)
+        {
+            toServer = true;
+            key = {src, dst};
+        }
+        else
+        {
+            return;
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    auto it = flows_.find(key);
+    if (it == flows_.end())
+    {
+        // Track from the handshake, or join mid-stream at client data
+        if ((seg.flags & TcpSegment::Rst) || !((seg.flags & TcpSegment::Syn) || (toServer && seg.payloadLen > 0)))
+            return;
+        if (flows_.size() >= cfg_.maxFlows)
+        {
+            stats_.flowsDropped++;
+            return;
+        }
+        it = flows_.try_emplace(key, cfg_.maxBodyBytes).first;
+        it->second.ipv6 = seg.ipv6;
+        stats_.flows++;
+    }
+
+    Flow &flow = it->second;
+    flow.lastSeenNs = seg.tsNs;
+    if (!flow.dead)
+        accept(key, flow, toServer, seg);
+
+    if (seg.flags & TcpSegment::Rst)
+    {
+        if (!flow.dead && !flow.toClient.closed && flow.toClient.pending.empty())
+            closeDirection(key, flow, false, seg.tsNs);
+        stats_.unmatched += flow.requests.size();
+        flows_.erase(it);
+    }
+    else if ((flow.toServer.closed && flow.toClient.closed) ||
+             (flow.dead && (seg.flags & TcpSegment::Fin)))
+    {
+        stats_.unmatched += flow.requests.size();
+        flows_.erase(it);
+    }
+}
+
+void HttpFlowTracker::accept(const FlowKey &key, Flow &flow, bool toServer, const TcpSegment &seg)
+{
+    Direction &d = toServer ? flow.toServer : flow.toClient;
+    if (d.closed)
+        return;
+
+    uint32_t seq = seg.seq;
+    const uint8_t *data = seg.payload;
+    size_t len = seg.payloadLen;
+
+    if (seg.flags & TcpSegment::Syn)
+    {
+        seq += 1; // the SYN occupies one sequence number
+        if (!d.synced)
+        {
+            d.synced = true;
+            d.nextSeq = seq;
+        }
+    }
+    else if (!d.synced)
+    {
+        // Joining mid-stream: responses only once the request side is in sync
+        if (len == 0 || (!toServer && !flow.toServer.synced))
+            return;
+        d.synced = true;
+        d.nextSeq = seq;
+    }
+
+    if ((seg.flags & TcpSegment::Fin) && !d.finSeen)
+    {
+        d.finSeen = true;
+        d.finSeq = seq + static_cast<uint32_t>(len);
+    }
+
+    if (len > 0)
+    {
+        int32_t ahead = static_cast<int32_t>(seq - d.nextSeq);
+        if (ahead < 0)
+        {
+            // Retransmission or overlap: keep only bytes not yet delivered
+            stats_.retransmits++;
+            size_t seen = static_cast<size_t>(-static_cast<int64_t>(ahead));
+            data += std::min(seen, len);
+            len -= std::min(seen, len);
+            seq = d.nextSeq;
+            ahead = 0;
+        }
+        if (len > 0 && ahead > 0)
+        {
+            if (d.pendingBytes + len > cfg_.maxOutOfOrderBytes)
+            {
+                // The missing bytes were lost by the capture, not the network
+                stats_.gaps++;
+                flow.dead = true;
+                return;
+            }
+            stats_.outOfOrder++;
+            d.pending.push_back(PendingSegment{seq, std::string(reinterpret_cast<const char *>(data), len), seg.tsNs});
+            d.pendingBytes += len;
+        }
+        else if (len > 0)
+        {
+            deliver(key, flow, toServer, data, len, seg.tsNs);
+            d.nextSeq += static_cast<uint32_t>(len);
+
+            // Release buffered segments that are now contiguous
+            for (bool progress = true; progress && !flow.dead;)
+            {
+                progress = false;
+                for (size_t i = 0; i < d.pending.size(); ++i)
+                {
+                    int32_t gap = static_cast<int32_t>(d.pending[i].seq - d.nextSeq);
+                    if (gap > 0)
+                        continue;
+                    PendingSegment p = std::move(d.pending[i]);
+                    d.pending.erase(d.pending.begin() + static_cast<std::ptrdiff_t>(i));
+                    d.pendingBytes -= p.data.size();
+                    size_t skip = static_cast<size_t>(-static_cast<int64_t>(gap));
+                    if (skip < p.data.size())
+                    {
+                        deliver(key, flow, toServer, reinterpret_cast<const uint8_t *>(p.data.data()) + skip,
+                                p.data.size() - skip, p.tsNs);
+                        d.nextSeq += static_cast<uint32_t>(p.data.size() - skip);
+                    }
+                    progress = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (d.finSeen && d.nextSeq == d.finSeq && !flow.dead)
+        closeDirection(key, flow, toServer, seg.tsNs);
+}
+
+void HttpFlowTracker::deliver(const FlowKey &key, Flow &flow, bool toServer, const uint8_t *data, size_t len, uint64_t tsNs)
+{
+    if (flow.dead)
+        return;
+    HttpStreamParser &parser = toServer ? flow.requestParser : flow.responseParser;
+    flow.scratch.clear();
+    bool ok = parser.feed(reinterpret_cast<const char *>(data), len, tsNs, flow.scratch);
+    if (toServer)
+    {
+        for (auto &m : flow.scratch)
+        {
+            flow.responseParser.expectResponseTo(m.method);
+            if (flow.requests.size() >= cfg_.maxPipelinedRequests)
+            {
+                flow.requests.pop_front();
+                stats_.unmatched++;
+            }
+            flow.requests.push_back(std::move(m));
+        }
+    }
+    else
+    {
+        for (auto &m : flow.scratch)
+            emit(key, flow, std::move(m));
+    }
+    if (!ok)
+    {
+        stats_.parseErrors++;
+        flow.dead = true;
+    }
+    else if (flow.responseParser.upgraded())
+    {
+        flow.dead = true; // WebSocket or CONNECT tunnel: nothing more to parse
+    }
+}
+
+void HttpFlowTracker::closeDirection(const FlowKey &key, Flow &flow, bool toServer, uint64_t tsNs)
+{
+    Direction &d = toServer ? flow.toServer : flow.toClient;
+    d.closed = true;
+    if (!toServer && !flow.dead)
+    {
+        flow.scratch.clear();
+        flow.responseParser.finish(tsNs, flow.scratch);
+        for (auto &m : flow.scratch)
+            emit(key, flow, std::move(m));
+    }
+}
+
+void HttpFlowTracker::emit(const FlowKey &key, Flow &flow, HttpMessage &&response)
+{
+    if (flow.requests.empty())
+    {
+        stats_.unmatched++;
+        return;
+    }
+    HttpMessage request = std::move(flow.requests.front());
+    flow.requests.pop_front();
+
+    RequestData r;
+    r.method = std::move(request.method);
+    r.scheme = "http";
+    r.host = request.header("Host");
+    r.path = originForm(std::move(request.target));
+    r.headers = headersToJson(request.headers);
+    r.bodyText = std::move(request.body);
+    r.ip = formatIp(key.client.ip, flow.ipv6);
+    r.startNs = request.firstByteNs;
+
+    ResponseData s;
+    s.status = response.status;
+    s.headers = headersToJson(response.headers);
+    s.bodyText = std::move(response.body);
+    s.endNs = response.lastByteNs;
+
+    stats_.pairs++;
+    sink_(r, s);
+}
+
+void HttpFlowTracker::expire(uint64_t nowNs)
+{
+    for (auto it = flows_.begin(); it != flows_.end();)
+    {
+        if (it->second.lastSeenNs + cfg_.idleTimeoutNs < nowNs)
+        {
+            stats_.unmatched += it->second.requests.size();
+            stats_.expired++;
+            it = flows_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void HttpFlowTracker::flush()
+{
+    for (auto &[key, flow] : flows_)
+    {
+        if (!flow.dead && !flow.toClient.closed && flow.toClient.pending.empty())
+            closeDirection(key, flow, false, flow.lastSeenNs);
+        stats_.unmatched += flow.requests.size();
+    }
+    flows_.clear();
+}
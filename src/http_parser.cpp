@@ -0,0 +1,438 @@
+#include "traffic_processor/http_parser.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace traffic_processor;
+
+namespace
+{
+    constexpr size_t npos = std::string_view::npos;
+
+    char lower(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (lower(a[i]) != lower(b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    bool icontains(std::string_view haystack, std::string_view needle)
+    {
+        if (needle.size() > haystack.size())
+            return false;
+        for (size_t i = 0; i + needle.size() <= haystack.size(); ++i)
+        {
+            if (iequals(haystack.substr(i, needle.size()), needle))
+                return true;
+        }
+        return false;
+    }
+
+    std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    bool isToken(std::string_view s)
+    {
+        if (s.empty())
+            return false;
+        for (char c : s)
+        {
+            if (c <= ' ' || c >= 127 || std::strchr("\"(),/:;<=>?@[\\]{}", c))
+                return false;
+        }
+        return true;
+    }
+
+    // Finds the blank line ending a header block, scanning 16 bytes per step
+    // for '\n'. Returns the offset just past it, or npos with `from` moved
+    // to where the next call should resume.
+    size_t findHeadEnd(const char *p, size_t n, size_t &from)
+    {
+        auto check = [&](size_t i) -> size_t
+        {
+            if (i + 1 < n && p[i + 1] == '\n')
+                return i + 2;
+            if (i + 2 < n && p[i + 1] == '\r' && p[i + 2] == '\n')
+                return i + 3;
+            return npos;
+        };
+
+        size_t i = from;
+#if defined(__SSE2__)
+        const __m128i nl = _mm_set1_epi8('\n');
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+            int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+            while (bits)
+            {
+                size_t at = i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(bits)));
+                if (size_t end = check(at); end != npos)
+                    return end;
+                bits &= bits - 1;
+            }
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            if (p[i] == '\n')
+            {
+                if (size_t end = check(i); end != npos)
+                    return end;
+            }
+        }
+        // A '\n' in the last two bytes may still turn out to end the block
+        from = n >= 2 ? n - 2 : 0;
+        return npos;
+    }
+
+    bool parseDecimal(std::string_view s, uint64_t &out)
+    {
+        if (s.empty() || s.size() > 18)
+            return false;
+        uint64_t v = 0;
+        for (char c : s)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            v = v * 10 + static_cast<uint64_t>(c - '0');
+        }
+        out = v;
+        return true;
+    }
+
+    bool parseHex(std::string_view s, uint64_t &out)
+    {
+        if (s.empty() || s.size() > 15)
+            return false;
+        uint64_t v = 0;
+        for (char c : s)
+        {
+            int d;
+            if (c >= '0' && c <= '9')
+                d = c - '0';
+            else if (lower(c) >= 'a' && lower(c) <= 'f')
+                d = lower(c) - 'a' + 10;
+            else
+                return false;
+            v = (v << 4) | static_cast<uint64_t>(d);
+        }
+        out = v;
+        return true;
+    }
+}
+
+std::string_view HttpMessage::header(std::string_view name) const
+{
+    for (const auto &[k, v] : headers)
+    {
+        if (iequals(k, name))
+            return v;
+    }
+    return {};
+}
+
+HttpStreamParser::HttpStreamParser(Kind kind, size_t maxBodyBytes, size_t maxHeaderBytes)
+    : kind_(kind), maxBodyBytes_(maxBodyBytes), maxHeaderBytes_(maxHeaderBytes)
+{
+}
+
+void HttpStreamParser::expectResponseTo(std::string_view method)
+{
+    pendingMethods_.emplace_back(method);
+}
+
+// Rejects other protocols (TLS, HTTP/2 preface...) from the first bytes
+// instead of buffering up to maxHeaderBytes waiting for a blank line
+bool HttpStreamParser::plausibleStart(std::string_view in) const
+{
+    if (kind_ == Kind::Response)
+    {
+        constexpr std::string_view prefix = "HTTP/1.";
+        size_t n = std::min(in.size(), prefix.size());
+        return in.substr(0, n) == prefix.substr(0, n);
+    }
+    for (size_t i = 0; i < in.size() && i <= 24; ++i)
+    {
+        if (in[i] == ' ')
+            return i > 0;
+        if (!isToken(in.substr(i, 1)))
+            return false;
+    }
+    return in.size() <= 24;
+}
+
+bool HttpStreamParser::parseHead(std::string_view head)
+{
+    size_t eol = head.find('\n');
+    std::string_view line = trim(head.substr(0, eol));
+    head.remove_prefix(eol + 1);
+
+    size_t sp1 = line.find(' ');
+    if (sp1 == npos)
+        return false;
+    if (kind_ == Kind::Request)
+    {
+        size_t sp2 = line.rfind(' ');
+        if (sp2 == sp1 || line.substr(sp2 + 1, 7) != "HTTP/1." || !isToken(line.substr(0, sp1)))
+            return false;
+        cur_.method = line.substr(0, sp1);
+        cur_.target = trim(line.substr(sp1 + 1, sp2 - sp1 - 1));
+        if (cur_.target.empty())
+            return false;
+    }
+    else
+    {
+        uint64_t status = 0;
+        if (line.substr(0, 7) != "HTTP/1." || !parseDecimal(line.substr(sp1 + 1, 3), status) ||
+            status < 100 || status > 999)
+            return false;
+        cur_.status = static_cast<int>(status);
+    }
+
+    while (!head.empty())
+    {
+        eol = head.find('\n');
+        std::string_view raw = head.substr(0, eol);
+        head.remove_prefix(eol == npos ? head.size() : eol + 1);
+        if (trim(raw).empty())
+            break;
+        if ((raw.front() == ' ' || raw.front() == '\t') && !cur_.headers.empty())
+        {
+            // Obsolete line folding: continuation of the previous value
+            cur_.headers.back().second.append(" ").append(trim(raw));
+            continue;
+        }
+        size_t colon = raw.find(':');
+        if (colon == npos || !isToken(raw.substr(0, colon)))
+            return false;
+        cur_.headers.emplace_back(std::string(raw.substr(0, colon)), std::string(trim(raw.substr(colon + 1))));
+    }
+    return true;
+}
+
+void HttpStreamParser::appendBody(const char *p, size_t n)
+{
+    size_t room = cur_.body.size() < maxBodyBytes_ ? maxBodyBytes_ - cur_.body.size() : 0;
+    if (n > room)
+        cur_.bodyTruncated = true;
+    cur_.body.append(p, std::min(n, room));
+}
+
+void HttpStreamParser::complete(uint64_t tsNs, std::vector<HttpMessage> &out)
+{
+    cur_.lastByteNs = tsNs;
+    out.push_back(std::move(cur_));
+    cur_ = HttpMessage{};
+    started_ = false;
+    if (state_ != State::Upgraded)
+        state_ = State::Headers;
+}
+
+bool HttpStreamParser::feed(const char *data, size_t len, uint64_t tsNs, std::vector<HttpMessage> &out)
+{
+    if (state_ == State::Failed)
+        return false;
+    if (state_ == State::Upgraded)
+        return true;
+
+    // Work on the caller's bytes directly unless a partial line is pending
+    const bool buffered = !buf_.empty();
+    if (buffered)
+        buf_.append(data, len);
+    std::string_view in = buffered ? std::string_view(buf_) : std::string_view(data, len);
+
+    size_t pos = 0;
+    bool more = true;
+    while (more && pos < in.size() && state_ != State::Failed && state_ != State::Upgraded)
+    {
+        switch (state_)
+        {
+        case State::Headers:
+        {
+            if (!started_)
+            {
+                // Stray CRLFs between pipelined messages are allowed
+                while (pos < in.size() && (in[pos] == '\r' || in[pos] == '\n'))
+                    ++pos;
+                if (pos == in.size())
+                    break;
+                started_ = true;
+                cur_.firstByteNs = tsNs;
+                scanned_ = pos;
+            }
+            if (!plausibleStart(in.substr(pos)))
+            {
+                state_ = State::Failed;
+                break;
+            }
+            size_t end = findHeadEnd(in.data(), in.size(), scanned_);
+            if (end == npos)
+            {
+                if (in.size() - pos > maxHeaderBytes_)
+                    state_ = State::Failed;
+                more = false;
+                break;
+            }
+            if (end - pos > maxHeaderBytes_ || !parseHead(in.substr(pos, end - pos)))
+            {
+                state_ = State::Failed;
+                break;
+            }
+            pos = end;
+
+            uint64_t length = 0;
+            bool hasLength = false;
+            if (std::string_view cl = cur_.header("Content-Length"); !cl.empty())
+            {
+                if (!parseDecimal(cl, length))
+                {
+                    state_ = State::Failed;
+                    break;
+                }
+                hasLength = true;
+            }
+            const bool chunked = icontains(cur_.header("Transfer-Encoding"), "chunked");
+
+            if (kind_ == Kind::Response)
+            {
+                if (cur_.status < 200 && cur_.status != 101)
+                {
+                    // Interim response (100 Continue, 103 Early Hints): skip it
+                    cur_ = HttpMessage{};
+                    started_ = false;
+                    break;
+                }
+                std::string method = "GET";
+                if (!pendingMethods_.empty())
+                {
+                    method = std::move(pendingMethods_.front());
+                    pendingMethods_.pop_front();
+                }
+                if (cur_.status == 101 || (method == "CONNECT" && cur_.status < 300))
+                {
+                    state_ = State::Upgraded;
+                    complete(tsNs, out);
+                    break;
+                }
+                if (method == "HEAD" || cur_.status == 204 || cur_.status == 304)
+                {
+                    complete(tsNs, out);
+                    break;
+                }
+            }
+
+            if (chunked)
+                state_ = State::ChunkSize;
+            else if (hasLength && length > 0)
+            {
+                remaining_ = length;
+                state_ = State::Body;
+            }
+            else if (!hasLength && kind_ == Kind::Response)
+                state_ = State::UntilClose;
+            else
+                complete(tsNs, out);
+            break;
+        }
+        case State::Body:
+        case State::ChunkData:
+        {
+            size_t take = static_cast<size_t>(std::min<uint64_t>(remaining_, in.size() - pos));
+            appendBody(in.data() + pos, take);
+            pos += take;
+            remaining_ -= take;
+            if (remaining_ == 0)
+            {
+                if (state_ == State::Body)
+                    complete(tsNs, out);
+                else
+                    state_ = State::ChunkDataEnd;
+            }
+            break;
+        }
+        case State::ChunkSize:
+        case State::ChunkDataEnd:
+        case State::ChunkTrailer:
+        {
+            size_t nl = in.find('\n', pos);
+            if (nl == npos)
+            {
+                size_t limit = state_ == State::ChunkTrailer ? maxHeaderBytes_ : 1024;
+                if (in.size() - pos > limit)
+                    state_ = State::Failed;
+                more = false;
+                break;
+            }
+            std::string_view line = trim(in.substr(pos, nl - pos));
+            pos = nl + 1;
+            if (state_ == State::ChunkDataEnd)
+            {
+                state_ = line.empty() ? State::ChunkSize : State::Failed;
+            }
+            else if (state_ == State::ChunkTrailer)
+            {
+                if (line.empty())
+                    complete(tsNs, out);
+            }
+            else
+            {
+                uint64_t size = 0;
+                if (!parseHex(trim(line.substr(0, line.find(';'))), size))
+                {
+                    state_ = State::Failed;
+                    break;
+                }
+                remaining_ = size;
+                state_ = size == 0 ? State::ChunkTrailer : State::ChunkData;
+            }
+            break;
+        }
+        case State::UntilClose:
+            appendBody(in.data() + pos, in.size() - pos);
+            pos = in.size();
+            break;
+        case State::Failed:
+        case State::Upgraded:
+            break;
+        }
+    }
+
+    // Keep the unconsumed tail (a partial header block or chunk line)
+    if (state_ == State::Headers && started_)
+        scanned_ -= std::min(scanned_, pos);
+    if (buffered)
+        buf_.erase(0, pos);
+    else
+        buf_.assign(in.substr(pos));
+    if (state_ == State::Failed || state_ == State::Upgraded)
+        buf_.clear();
+    return state_ != State::Failed;
+}
+
+void HttpStreamParser::finish(uint64_t tsNs, std::vector<HttpMessage> &out)
+{
+    if (state_ == State::UntilClose)
+        complete(tsNs, out);
+    buf_.clear();
+}
@@ -1,20 +1,136 @@
 #include "traffic_processor/kafka_producer.hpp"
+#include <algorithm>
 #include <iostream>
 #include <cstring>
 
+#include <nlohmann/json.hpp>
+
 using namespace traffic_processor;
 
-static void delivery_report_callback(rd_kafka_t *rk, const rd_kafka_message_t *rkmessage, void * /*opaque*/)
+namespace
 {
-    if (rkmessage->err)
+    // Message opaque marking side messages, which drain() does not spill
+    char kSideMessage;
+
+    // Opaque of a side message sent with sendSide(), tagged in its low bit
+    // so that the delivery report tells it from a record's DeliveryState
+    struct SideMessage
+    {
+        std::function<void()> lost;
+    };
+
+    void *tagged(SideMessage *side)
     {
-        std::cerr << "KAFKA ERROR: Message delivery failed - " << rd_kafka_err2str(rkmessage->err) << std::endl;
+        return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(side) | 1);
+    }
+
+    SideMessage *untagged(void *opaque)
+    {
+        auto bits = reinterpret_cast<uintptr_t>(opaque);
+        return bits & 1 ? reinterpret_cast<SideMessage *>(bits & ~uintptr_t{1}) : nullptr;
+    }
+
+    void runLost(std::unique_ptr<SideMessage> side)
+    {
+        try
+        {
+            side->lost();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Side message loss handler failed: " << e.what() << std::endl;
+        }
+    }
+
+    // Longest the poll thread blocks in librdkafka, and so the longest a
+    // producer takes to notice it is being destroyed
+    constexpr int kPollTimeoutMs = 50;
+
+    // producev() for a target given as RD_KAFKA_V_RKT or RD_KAFKA_V_TOPIC.
+    // Headers go in as RD_KAFKA_V_HEADER values, so the SDK builds no
+    // rd_kafka_headers_t of its own; librdkafka still allocates one per
+    // message internally and copies the values into it.
+    template <typename... Target>
+    rd_kafka_resp_err_t produceMessage(rd_kafka_t *rk, std::string_view key, const std::string &payload, void *opaque,
+                                       const RecordHeaders *h, Target... target)
+    {
+        // An empty key is a key too (hashed to one partition); no key is null
+        const void *keyData = key.empty() ? nullptr : key.data();
+        if (!h)
+        {
+            return rd_kafka_producev(
+                rk,
+                target...,
+                RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+                RD_KAFKA_V_KEY(keyData, key.size()),
+                RD_KAFKA_V_VALUE(const_cast<char *>(payload.data()), payload.size()),
+                RD_KAFKA_V_OPAQUE(opaque),
+                RD_KAFKA_V_END);
+        }
+        namespace names = record_headers;
+        auto len = [](std::string_view v)
+        { return static_cast<ssize_t>(v.size()); };
+        return rd_kafka_producev(
+            rk,
+            target...,
+            RD_KAFKA_V_MSGFLAGS(RD_KAFKA_MSG_F_COPY),
+            RD_KAFKA_V_KEY(keyData, key.size()),
+            RD_KAFKA_V_VALUE(const_cast<char *>(payload.data()), payload.size()),
+            RD_KAFKA_V_OPAQUE(opaque),
+            RD_KAFKA_V_HEADER(names::AccountId, h->accountId.data(), len(h->accountId)),
+            RD_KAFKA_V_HEADER(names::Method, h->method.data(), len(h->method)),
+            RD_KAFKA_V_HEADER(names::Status, h->status.data(), len(h->status)),
+            RD_KAFKA_V_HEADER(names::Host, h->host.data(), len(h->host)),
+            RD_KAFKA_V_HEADER(names::Route, h->route.data(), len(h->route)),
+            RD_KAFKA_V_HEADER(names::SchemaVersion, h->schemaVersion.data(), len(h->schemaVersion)),
+            RD_KAFKA_V_HEADER(names::ContentEncoding, h->contentEncoding.data(), len(h->contentEncoding)),
+            RD_KAFKA_V_END);
     }
 }
 
-KafkaProducer::KafkaProducer(const KafkaConfig &config) : config_(config), producer_(nullptr), topic_(nullptr)
+void KafkaProducer::deliveryCallback(rd_kafka_t * /*rk*/, const rd_kafka_message_t *rkmessage, void *opaque)
 {
+    auto *self = static_cast<KafkaProducer *>(opaque);
+    std::unique_ptr<SideMessage> hooked(untagged(rkmessage->_private));
+    bool side = hooked || rkmessage->_private == &kSideMessage;
+    auto *delivery = side ? nullptr : static_cast<DeliveryState *>(rkmessage->_private);
+    if (!rkmessage->err)
+    {
+        self->delivered_.fetch_add(1, std::memory_order_relaxed);
+        if (delivery)
+            delivery->settle(DeliveryStatus::Delivered);
+        return;
+    }
+    if (hooked)
+        runLost(std::move(hooked));
+
+    bool purged = rkmessage->err == RD_KAFKA_RESP_ERR__PURGE_QUEUE || rkmessage->err == RD_KAFKA_RESP_ERR__PURGE_INFLIGHT;
+    if (purged)
+    {
+        std::lock_guard<std::mutex> lock(self->spillMutex_);
+        bool written = false;
+        if (self->spill_ && !side)
+        {
+            // The spill file may be shared by producers draining in parallel
+            flockfile(self->spill_);
+            written = fwrite_unlocked(rkmessage->payload, 1, rkmessage->len, self->spill_) == rkmessage->len &&
+                      fputc_unlocked('\n', self->spill_) != EOF;
+            funlockfile(self->spill_);
+        }
+        (written ? self->spilled_ : self->purged_).fetch_add(1, std::memory_order_relaxed);
+        if (delivery)
+            delivery->settle(written ? DeliveryStatus::Spilled : DeliveryStatus::Dropped);
+        return;
+    }
+
+    self->failed_.fetch_add(1, std::memory_order_relaxed);
+    if (delivery)
+        delivery->settle(DeliveryStatus::Failed);
+    std::cerr << "KAFKA ERROR: Message delivery failed - " << rd_kafka_err2str(rkmessage->err) << std::endl;
+}
 
+rd_kafka_t *KafkaProducer::createConnection(int lingerMs, int batchSizeBytes, int batchNumMessages, bool withStats)
+{
     // Create Kafka configuration
     rd_kafka_conf_t *conf = rd_kafka_conf_new();
     char errstr[512];
@@ -27,16 +143,17 @@ KafkaProducer::KafkaProducer(const KafkaConfig &config) : config_(config), produ
         throw std::runtime_error("Failed to configure Kafka producer");
     }
 
-    // Basic Kafka settings (configurable)
+    // Basic Kafka settings (configurable); topic-level ones are the
+    // defaults of topics without overrides
     rd_kafka_conf_set(conf, "compression.type", config_.compression.c_str(), errstr, sizeof(errstr));
     rd_kafka_conf_set(conf, "acks", config_.acks.c_str(), errstr, sizeof(errstr));
     rd_kafka_conf_set(conf, "retries", std::to_string(config_.retries).c_str(), errstr, sizeof(errstr));
     rd_kafka_conf_set(conf, "request.timeout.ms", std::to_string(config_.requestTimeoutMs).c_str(), errstr, sizeof(errstr));
 
     // Batching settings
-    rd_kafka_conf_set(conf, "linger.ms", std::to_string(config_.lingerMs).c_str(), errstr, sizeof(errstr));
-    rd_kafka_conf_set(conf, "batch.num.messages", std::to_string(config_.batchNumMessages).c_str(), errstr, sizeof(errstr));
-    rd_kafka_conf_set(conf, "batch.size", std::to_string(config_.batchSizeBytes).c_str(), errstr, sizeof(errstr));
+    rd_kafka_conf_set(conf, "linger.ms", std::to_string(lingerMs).c_str(), errstr, sizeof(errstr));
+    rd_kafka_conf_set(conf, "batch.num.messages", std::to_string(batchNumMessages).c_str(), errstr, sizeof(errstr));
+    rd_kafka_conf_set(conf, "batch.size", std::to_string(batchSizeBytes).c_str(), errstr, sizeof(errstr));
     rd_kafka_conf_set(conf, "queue.buffering.max.messages", std::to_string(config_.queueBufferingMaxMessages).c_str(), errstr, sizeof(errstr));
     rd_kafka_conf_set(conf, "queue.buffering.max.kbytes", std::to_string(config_.queueBufferingMaxKbytes).c_str(), errstr, sizeof(errstr));
 
@@ -46,72 +163,227 @@ KafkaProducer::KafkaProducer(const KafkaConfig &config) : config_(config), produ
         rd_kafka_conf_set(conf, kv.first.c_str(), kv.second.c_str(), errstr, sizeof(errstr));
     }
 
+    if (withStats && config_.statisticsIntervalMs > 0)
+    {
+        rd_kafka_conf_set(conf, "statistics.interval.ms", std::to_string(config_.statisticsIntervalMs).c_str(), errstr, sizeof(errstr));
+        rd_kafka_conf_set_stats_cb(conf, &KafkaProducer::statsCallback);
+    }
+    rd_kafka_conf_set_opaque(conf, this);
+
     // Set delivery report callback for tracking
-    rd_kafka_conf_set_dr_msg_cb(conf, delivery_report_callback);
+    rd_kafka_conf_set_dr_msg_cb(conf, &KafkaProducer::deliveryCallback);
 
     // Create producer instance
-    producer_ = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr, sizeof(errstr));
-    if (!producer_)
+    rd_kafka_t *rk = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr, sizeof(errstr));
+    if (!rk)
     {
         std::cerr << "Failed to create producer: " << errstr << std::endl;
         throw std::runtime_error("Failed to create Kafka producer");
     }
+    return rk;
+}
+
+rd_kafka_topic_t *KafkaProducer::createTopic(rd_kafka_t *rk, const std::string &name, const TopicConfig *overrides)
+{
+    rd_kafka_topic_conf_t *conf = nullptr;
+    if (overrides && (!overrides->compression.empty() || !overrides->acks.empty()))
+    {
+        char errstr[512];
+        conf = rd_kafka_topic_conf_new();
+        if (!overrides->compression.empty() &&
+            rd_kafka_topic_conf_set(conf, "compression.type", overrides->compression.c_str(), errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK)
+            std::cerr << "Topic " << name << ": " << errstr << std::endl;
+        if (!overrides->acks.empty() &&
+            rd_kafka_topic_conf_set(conf, "acks", overrides->acks.c_str(), errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK)
+            std::cerr << "Topic " << name << ": " << errstr << std::endl;
+    }
 
-    // Create topic handle
-    topic_ = rd_kafka_topic_new(producer_, config_.topic.c_str(), nullptr);
-    if (!topic_)
+    // Create topic handle (takes ownership of conf)
+    rd_kafka_topic_t *topic = rd_kafka_topic_new(rk, name.c_str(), conf);
+    if (!topic)
     {
-        std::cerr << "Failed to create topic: " << config_.topic << std::endl;
-        rd_kafka_destroy(producer_);
+        std::cerr << "Failed to create topic: " << name << std::endl;
         throw std::runtime_error("Failed to create Kafka topic");
     }
+    return topic;
+}
+
+KafkaProducer::KafkaProducer(const KafkaConfig &config) : config_(config)
+{
+    producer_ = createConnection(config_.lingerMs, config_.batchSizeBytes, config_.batchNumMessages, true);
+    connections_.push_back({producer_, config_.lingerMs, config_.batchSizeBytes, config_.batchNumMessages});
+
+    try
+    {
+        std::map<std::string, TopicConfig> topics = config_.topics;
+        topics.try_emplace(config_.topic);
+        for (const auto &[name, overrides] : topics)
+        {
+            int linger = overrides.lingerMs >= 0 ? overrides.lingerMs : config_.lingerMs;
+            int batchBytes = overrides.batchSizeBytes >= 0 ? overrides.batchSizeBytes : config_.batchSizeBytes;
+            int batchMessages = overrides.batchNumMessages >= 0 ? overrides.batchNumMessages : config_.batchNumMessages;
 
+            // Topics with the same connection settings share a connection
+            rd_kafka_t *rk = nullptr;
+            for (const auto &c : connections_)
+            {
+                if (c.lingerMs == linger && c.batchSizeBytes == batchBytes && c.batchNumMessages == batchMessages)
+                    rk = c.rk;
+            }
+            if (!rk)
+            {
+                rk = createConnection(linger, batchBytes, batchMessages, false);
+                connections_.push_back({rk, linger, batchBytes, batchMessages});
+            }
+            topics_[name] = {rk, createTopic(rk, name, &overrides)};
+        }
+    }
+    catch (...)
+    {
+        destroy();
+        throw;
+    }
+    topic_ = topics_[config_.topic].topic;
+    topicConnection_ = topics_[config_.topic].rk;
+
+    poller_ = std::thread([this]
+                          { pollLoop(); });
     // Kafka Producer initialized
 }
 
 KafkaProducer::~KafkaProducer()
 {
-    if (producer_)
+    destroy();
+}
+
+void KafkaProducer::pollLoop()
+{
+    while (!pollStop_.load(std::memory_order_relaxed))
+        poll(kPollTimeoutMs); // runs the completed continuations too
+}
+
+void KafkaProducer::destroy()
+{
+    if (poller_.joinable())
+    {
+        // The flush below serves whatever is still outstanding
+        pollStop_.store(true, std::memory_order_relaxed);
+        poller_.join();
+    }
+    for (const auto &c : connections_)
     {
-        // Flush pending messages before shutdown
-        flush(2000);
+        if (rd_kafka_outq_len(c.rk) > 0)
+        {
+            // Flush pending messages before shutdown (already empty after drain())
+            int remaining = rd_kafka_flush(c.rk, config_.closeFlushTimeoutMs) ? rd_kafka_outq_len(c.rk) : 0;
+            if (remaining > 0)
+            {
+                std::cerr << remaining << " messages still in queue after flush timeout" << std::endl;
+                // Reported as purged, so no delivery state is left pending
+                rd_kafka_purge(c.rk, RD_KAFKA_PURGE_F_QUEUE | RD_KAFKA_PURGE_F_INFLIGHT | RD_KAFKA_PURGE_F_NON_BLOCKING);
+                rd_kafka_poll(c.rk, 0);
+            }
+        }
     }
+    DeliveryState::runCompleted();
+    for (auto &[name, handle] : topics_)
+        rd_kafka_topic_destroy(handle.topic);
+    topics_.clear();
+    topic_ = nullptr;
+    topicConnection_ = nullptr;
+    for (const auto &c : connections_)
+        rd_kafka_destroy(c.rk);
+    connections_.clear();
+    producer_ = nullptr;
+}
 
-    if (topic_)
+void KafkaProducer::send(const std::string &jsonRecord, DeliveryState *delivery, const RecordHeaders *headers)
+{
+    if (!producer_ || !topic_)
     {
-        rd_kafka_topic_destroy(topic_);
-        topic_ = nullptr;
+        std::cerr << "Kafka producer not initialized" << std::endl;
+        if (delivery)
+            delivery->settle(DeliveryStatus::Dropped);
+        return;
     }
-    if (producer_)
+
+    // Unkeyed: automatic partitioning
+    rd_kafka_resp_err_t err = produceMessage(topicConnection_, {}, jsonRecord, delivery, headers, RD_KAFKA_V_RKT(topic_));
+    if (err)
     {
-        rd_kafka_destroy(producer_);
-        producer_ = nullptr;
+        enqueueFailed_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "Failed to produce message: " << rd_kafka_err2str(err) << std::endl;
+        if (delivery)
+            delivery->settle(DeliveryStatus::Dropped);
     }
+    // Drive delivery reports and internal callbacks without blocking
+    rd_kafka_poll(topicConnection_, 0);
+    DeliveryState::runCompleted();
 }
 
-void KafkaProducer::send(const std::string &jsonRecord)
+void KafkaProducer::send(const std::string &payload, const std::string &topic, std::string_view key, MessageKind kind,
+                         DeliveryState *delivery, const RecordHeaders *headers)
 {
-    if (!producer_ || !topic_)
+    if (kind == MessageKind::Side)
+        delivery = nullptr;
+    if (!producer_)
     {
         std::cerr << "Kafka producer not initialized" << std::endl;
+        if (delivery)
+            delivery->settle(DeliveryStatus::Dropped);
         return;
     }
 
-    int result = rd_kafka_produce(
-        topic_,
-        RD_KAFKA_PARTITION_UA, // automatic partitioning
-        RD_KAFKA_MSG_F_COPY,
-        const_cast<char *>(jsonRecord.c_str()),
-        jsonRecord.length(),
-        nullptr, 0,
-        nullptr);
+    void *opaque = kind == MessageKind::Side ? static_cast<void *>(&kSideMessage) : delivery;
+    if (produce(payload, topic, key, opaque, headers) && delivery)
+        delivery->settle(DeliveryStatus::Dropped);
+    DeliveryState::runCompleted();
+}
 
-    if (result == -1)
+void KafkaProducer::sendSide(const std::string &payload, const std::string &topic, std::string_view key,
+                             std::function<void()> lost)
+{
+    if (!lost)
     {
-        std::cerr << "Failed to produce message: " << rd_kafka_err2str(rd_kafka_last_error()) << std::endl;
+        send(payload, topic, key, MessageKind::Side);
+        return;
     }
-    // Drive delivery reports and internal callbacks without blocking
-    rd_kafka_poll(producer_, 0);
+    auto side = std::make_unique<SideMessage>(SideMessage{std::move(lost)});
+    if (!producer_)
+    {
+        std::cerr << "Kafka producer not initialized" << std::endl;
+        runLost(std::move(side));
+        return;
+    }
+    // Owned by the delivery report from here on
+    if (produce(payload, topic, key, tagged(side.get()), nullptr))
+        runLost(std::move(side));
+    else
+        side.release();
+}
+
+rd_kafka_resp_err_t KafkaProducer::produce(const std::string &payload, const std::string &topic, std::string_view key,
+                                           void *opaque, const RecordHeaders *headers)
+{
+    rd_kafka_resp_err_t err;
+    rd_kafka_t *rk = producer_;
+    if (auto it = topics_.find(topic); it != topics_.end())
+    {
+        rk = it->second.rk;
+        err = produceMessage(rk, key, payload, opaque, headers, RD_KAFKA_V_RKT(it->second.topic));
+    }
+    else
+    {
+        err = produceMessage(rk, key, payload, opaque, headers, RD_KAFKA_V_TOPIC(topic.c_str()));
+    }
+
+    if (err)
+    {
+        enqueueFailed_.fetch_add(1, std::memory_order_relaxed);
+        std::cerr << "Failed to produce message to " << topic << ": " << rd_kafka_err2str(err) << std::endl;
+    }
+    rd_kafka_poll(rk, 0);
+    return err;
 }
 
 void KafkaProducer::poll(int timeoutMs)
@@ -122,8 +394,11 @@ void KafkaProducer::poll(int timeoutMs)
         return;
     }
 
-    // Poll for delivery reports and internal housekeeping
-    rd_kafka_poll(producer_, timeoutMs);
+    // Poll for delivery reports and internal housekeeping; only the default
+    // connection waits
+    for (const auto &c : connections_)
+        rd_kafka_poll(c.rk, c.rk == producer_ ? timeoutMs : 0);
+    DeliveryState::runCompleted();
 }
 
 void KafkaProducer::flush(int timeoutMs)
@@ -134,7 +409,15 @@ void KafkaProducer::flush(int timeoutMs)
         return;
     }
 
-    int remaining = rd_kafka_flush(producer_, timeoutMs);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    int remaining = 0;
+    for (const auto &c : connections_)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        rd_kafka_flush(c.rk, static_cast<int>(std::max<int64_t>(0, left.count())));
+        remaining += rd_kafka_outq_len(c.rk);
+    }
+    DeliveryState::runCompleted();
     if (remaining > 0)
     {
         std::cerr << remaining << " messages still in queue after flush timeout" << std::endl;
@@ -150,11 +433,151 @@ void KafkaProducer::printStats() const
     }
 
     // Print basic queue statistics
-    int outq_len = rd_kafka_outq_len(producer_);
+    int outq_len = queueLength();
     std::cout << "=== Kafka Producer Statistics ===" << std::endl;
     std::cout << "Messages in outbound queue: " << outq_len << std::endl;
     std::cout << "Topic: " << config_.topic << std::endl;
-    std::cout << "Batch config: " << config_.batchNumMessages << " msgs, "
-              << config_.batchSizeBytes / 1024 << "KB, " << config_.lingerMs << "ms" << std::endl;
+    for (const auto &c : connections_)
+    {
+        std::cout << "Batch config: " << c.batchNumMessages << " msgs, "
+                  << c.batchSizeBytes / 1024 << "KB, " << c.lingerMs << "ms, topics:";
+        for (const auto &[name, handle] : topics_)
+        {
+            if (handle.rk == c.rk)
+                std::cout << " " << name;
+        }
+        std::cout << std::endl;
+    }
     std::cout << "=================================" << std::endl;
-}
\ No newline at end of file
+}
+
+void KafkaProducer::expedite(int waitMs)
+{
+    // rd_kafka_flush() marks the producer as flushing, which makes broker
+    // threads send partial batches immediately; the short wait keeps it
+    // non-blocking in practice.
+    for (const auto &c : connections_)
+        rd_kafka_flush(c.rk, waitMs);
+    DeliveryState::runCompleted();
+}
+
+ProducerStats KafkaProducer::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+int KafkaProducer::statsCallback(rd_kafka_t * /*rk*/, char *json, size_t len, void *opaque)
+{
+    auto *self = static_cast<KafkaProducer *>(opaque);
+    nlohmann::json doc = nlohmann::json::parse(json, json + len, nullptr, false);
+    if (doc.is_discarded())
+        return 0;
+
+    ProducerStats st;
+    st.timestampUs = doc.value("ts", int64_t{0});
+    st.txMessages = doc.value("txmsgs", int64_t{0});
+    st.queuedMessages = doc.value("msg_cnt", int64_t{0});
+
+    double batches = 0;
+    if (auto topics = doc.find("topics"); topics != doc.end() && topics->is_object())
+    {
+        for (const auto &t : *topics)
+        {
+            const auto &cnt = t.value("batchcnt", nlohmann::json::object());
+            const auto &size = t.value("batchsize", nlohmann::json::object());
+            double n = cnt.value("cnt", 0.0);
+            if (n <= 0)
+                continue;
+            st.avgBatchCount += cnt.value("avg", 0.0) * n;
+            st.avgBatchBytes += size.value("avg", 0.0) * n;
+            batches += n;
+        }
+    }
+    if (batches > 0)
+    {
+        st.avgBatchCount /= batches;
+        st.avgBatchBytes /= batches;
+    }
+
+    // Slowest broker that actually carried traffic in this window
+    if (auto brokers = doc.find("brokers"); brokers != doc.end() && brokers->is_object())
+    {
+        for (const auto &b : *brokers)
+        {
+            const auto &lat = b.value("int_latency", nlohmann::json::object());
+            const auto &rtt = b.value("rtt", nlohmann::json::object());
+            if (lat.value("cnt", 0) > 0)
+                st.intLatencyMs = std::max(st.intLatencyMs, lat.value("avg", 0.0) / 1000.0);
+            if (rtt.value("cnt", 0) > 0)
+                st.rttMs = std::max(st.rttMs, rtt.value("avg", 0.0) / 1000.0);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(self->statsMutex_);
+    self->stats_ = st;
+    return 0; // librdkafka frees the json buffer
+}
+
+int KafkaProducer::drain(std::chrono::steady_clock::time_point deadline, std::FILE *spill)
+{
+    if (!producer_)
+        return 0;
+
+    auto remainingMs = [&deadline]
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        return static_cast<int>(std::max<int64_t>(0, left.count()));
+    };
+
+    int left = 0;
+    for (const auto &c : connections_)
+    {
+        rd_kafka_flush(c.rk, remainingMs());
+        left += rd_kafka_outq_len(c.rk);
+    }
+    if (left > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(spillMutex_);
+            spill_ = spill;
+        }
+        // Purged messages come back through delivery reports with a purge
+        // error; waiting for them, like the flush, stops at the deadline
+        for (const auto &c : connections_)
+        {
+            rd_kafka_purge(c.rk, RD_KAFKA_PURGE_F_QUEUE | RD_KAFKA_PURGE_F_INFLIGHT | RD_KAFKA_PURGE_F_NON_BLOCKING);
+            rd_kafka_poll(c.rk, 0);
+        }
+        for (const auto &c : connections_)
+        {
+            while (rd_kafka_outq_len(c.rk) > 0 && remainingMs() > 0)
+                rd_kafka_poll(c.rk, std::min(10, remainingMs()));
+        }
+        std::lock_guard<std::mutex> lock(spillMutex_);
+        spill_ = nullptr;
+        if (spill)
+            std::fflush(spill);
+    }
+    DeliveryState::runCompleted();
+    return left;
+}
+
+int KafkaProducer::queueLength() const
+{
+    int n = 0;
+    for (const auto &c : connections_)
+        n += rd_kafka_outq_len(c.rk);
+    return n;
+}
+
+DeliveryCounters KafkaProducer::counters() const
+{
+    DeliveryCounters c;
+    c.delivered = delivered_.load(std::memory_order_relaxed);
+    c.failed = failed_.load(std::memory_order_relaxed);
+    c.enqueueFailed = enqueueFailed_.load(std::memory_order_relaxed);
+    c.spilled = spilled_.load(std::memory_order_relaxed);
+    c.purged = purged_.load(std::memory_order_relaxed);
+    return c;
+}
@@ -0,0 +1,298 @@
+#include "traffic_processor/packet_capture.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace traffic_processor;
+
+#ifdef __linux__
+namespace
+{
+    uint64_t wallClockNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::system_clock::now().time_since_epoch())
+                                         .count());
+    }
+}
+#endif
+
+PcapReader::PcapReader(const std::string &path)
+    : in_(path, std::ios::binary)
+{
+    if (!in_)
+        throw std::runtime_error("cannot open pcap file " + path);
+    unsigned char header[24];
+    if (!in_.read(reinterpret_cast<char *>(header), sizeof(header)))
+        throw std::runtime_error("truncated pcap header in " + path);
+
+    uint32_t magic;
+    std::memcpy(&magic, header, 4);
+    switch (magic)
+    {
+    case 0xa1b2c3d4:
+        break;
+    case 0xd4c3b2a1:
+        swapped_ = true;
+        break;
+    case 0xa1b23c4d:
+        nanos_ = true;
+        break;
+    case 0x4d3cb2a1:
+        swapped_ = true;
+        nanos_ = true;
+        break;
+    case 0x0a0d0d0a:
+        throw std::runtime_error("pcapng is not supported, convert with `editcap -F pcap`: " + path);
+    default:
+        throw std::runtime_error("not a pcap file: " + path);
+    }
+    linkType_ = static_cast<int>(field(header + 20) & 0xffff);
+}
+
+uint32_t PcapReader::field(const unsigned char *p) const
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return swapped_ ? __builtin_bswap32(v) : v;
+}
+
+bool PcapReader::next(CapturedFrame &frame)
+{
+    unsigned char rec[16];
+    if (!in_.read(reinterpret_cast<char *>(rec), sizeof(rec)))
+        return false;
+    uint32_t len = field(rec + 8);
+    if (len > (256u << 20))
+        throw std::runtime_error("corrupt pcap record length");
+    buf_.resize(len);
+    if (!in_.read(reinterpret_cast<char *>(buf_.data()), len))
+        return false;
+    uint64_t frac = field(rec + 4);
+    frame.data = buf_.data();
+    frame.len = len;
+    frame.tsNs = static_cast<uint64_t>(field(rec)) * 1'000'000'000ULL + (nanos_ ? frac : frac * 1000);
+    return true;
+}
+
+PacketCapture::PacketCapture(const CaptureConfig &config, HttpFlowTracker::Sink sink)
+    : cfg_(config), sink_(std::move(sink))
+{
+    if (cfg_.workers < 1)
+        cfg_.workers = 1;
+}
+
+void PacketCapture::publish(size_t worker, const FlowTrackerStats &stats, uint64_t packets, uint64_t kernelDrops)
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    workerStats_[worker].tracker = stats;
+    workerStats_[worker].packets = packets;
+    workerStats_[worker].kernelDrops = kernelDrops;
+}
+
+nlohmann::json PacketCapture::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    FlowTrackerStats total;
+    uint64_t packets = 0, drops = 0;
+    for (const auto &w : workerStats_)
+    {
+        total += w.tracker;
+        packets += w.packets;
+        drops += w.kernelDrops;
+    }
+    nlohmann::json j = total.toJson();
+    j["packets"] = packets;
+    j["kernel_drops"] = drops;
+    return j;
+}
+
+void PacketCapture::run()
+{
+    if (!cfg_.pcapPath.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            workerStats_.assign(1, WorkerStats{});
+        }
+        runPcap();
+        return;
+    }
+
+#ifdef __linux__
+    if (cfg_.interface.empty())
+        throw std::runtime_error("capture needs an interface or a pcap file");
+
+    unsigned ifindex = 0;
+    if (cfg_.interface != "any")
+    {
+        ifindex = if_nametoindex(cfg_.interface.c_str());
+        if (ifindex == 0)
+            throw std::runtime_error("unknown interface " + cfg_.interface);
+    }
+    const int group = cfg_.fanoutGroup ? cfg_.fanoutGroup : (getpid() & 0xffff);
+
+    // Open every ring before starting threads so setup errors surface here
+    std::vector<int> fds;
+    auto closeAll = [&fds]
+    {
+        for (int fd : fds)
+            close(fd);
+    };
+    for (int w = 0; w < cfg_.workers; ++w)
+    {
+        int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+        if (fd < 0)
+        {
+            closeAll();
+            throw std::runtime_error(std::string("AF_PACKET socket failed (needs CAP_NET_RAW): ") + std::strerror(errno));
+        }
+        fds.push_back(fd);
+
+        int version = TPACKET_V3;
+        tpacket_req3 req{};
+        req.tp_block_size = cfg_.ringBlockSize;
+        req.tp_block_nr = cfg_.ringBlockCount;
+        req.tp_frame_size = cfg_.ringFrameSize;
+        req.tp_frame_nr = cfg_.ringBlockSize / cfg_.ringFrameSize * cfg_.ringBlockCount;
+        req.tp_retire_blk_tov = static_cast<unsigned>(cfg_.blockTimeoutMs);
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+        addr.sll_ifindex = static_cast<int>(ifindex);
+        // Hash fanout is symmetric, so both directions of a connection reach
+        // the same worker; DEFRAG reassembles IP fragments before hashing
+        int fanout = group | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+
+        if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 ||
+            setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 ||
+            bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+            setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0)
+        {
+            std::string err = std::strerror(errno);
+            closeAll();
+            throw std::runtime_error("AF_PACKET ring setup failed on " + cfg_.interface + ": " + err);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        workerStats_.assign(fds.size(), WorkerStats{});
+    }
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < fds.size(); ++w)
+    {
+        threads.emplace_back([this, w, fd = fds[w]]
+                             { runRing(w, fd); });
+    }
+    for (auto &t : threads)
+        t.join();
+    closeAll();
+#else
+    throw std::runtime_error("live capture requires Linux (AF_PACKET); use a pcap file instead");
+#endif
+}
+
+void PacketCapture::runPcap()
+{
+    PcapReader reader(cfg_.pcapPath);
+    HttpFlowTracker tracker(cfg_.tracker, sink_);
+    CapturedFrame frame;
+    TcpSegment seg;
+    uint64_t packets = 0;
+    while (!stop_.load(std::memory_order_relaxed) && reader.next(frame))
+    {
+        ++packets;
+        if (decodeTcpSegment(reader.linkType(), frame.data, frame.len, frame.tsNs, seg))
+            tracker.process(seg);
+        // Idle eviction runs on capture time, so replays behave like live traffic
+        if ((packets & 4095) == 0)
+        {
+            tracker.expire(frame.tsNs);
+            publish(0, tracker.stats(), packets, 0);
+        }
+    }
+    tracker.flush();
+    publish(0, tracker.stats(), packets, 0);
+}
+
+void PacketCapture::runRing(size_t worker, int fd)
+{
+#ifdef __linux__
+    const size_t ringBytes = static_cast<size_t>(cfg_.ringBlockSize) * cfg_.ringBlockCount;
+    void *map = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Capture worker " << worker << ": mmap failed: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    auto *ring = static_cast<uint8_t *>(map);
+
+    HttpFlowTracker tracker(cfg_.tracker, sink_);
+    TcpSegment seg;
+    uint64_t packets = 0, drops = 0;
+    auto lastHousekeeping = std::chrono::steady_clock::now();
+    unsigned block = 0;
+
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+        auto *desc = reinterpret_cast<tpacket_block_desc *>(ring + static_cast<size_t>(block) * cfg_.ringBlockSize);
+        if ((__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+        {
+            pollfd pfd{fd, POLLIN | POLLERR, 0};
+            poll(&pfd, 1, 100);
+        }
+        else
+        {
+            auto *pkt = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<uint8_t *>(desc) + desc->hdr.bh1.offset_to_first_pkt);
+            for (uint32_t i = 0; i < desc->hdr.bh1.num_pkts; ++i)
+            {
+                auto *ll = reinterpret_cast<const sockaddr_ll *>(reinterpret_cast<uint8_t *>(pkt) + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+                int linkType = ll->sll_hatype == ARPHRD_NONE ? LinkRaw : LinkEthernet;
+                uint64_t tsNs = static_cast<uint64_t>(pkt->tp_sec) * 1'000'000'000ULL + pkt->tp_nsec;
+                if (decodeTcpSegment(linkType, reinterpret_cast<uint8_t *>(pkt) + pkt->tp_mac, pkt->tp_snaplen, tsNs, seg))
+                    tracker.process(seg);
+                pkt = reinterpret_cast<tpacket3_hdr *>(reinterpret_cast<uint8_t *>(pkt) + pkt->tp_next_offset);
+            }
+            packets += desc->hdr.bh1.num_pkts;
+            __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+            block = (block + 1) % cfg_.ringBlockCount;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastHousekeeping >= std::chrono::seconds(1))
+        {
+            lastHousekeeping = now;
+            tpacket_stats_v3 ks{};
+            socklen_t ksLen = sizeof(ks);
+            if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &ks, &ksLen) == 0)
+                drops += ks.tp_drops; // counters reset on every read
+            tracker.expire(wallClockNs());
+            publish(worker, tracker.stats(), packets, drops);
+        }
+    }
+
+    tracker.flush();
+    publish(worker, tracker.stats(), packets, drops);
+    munmap(map, ringBytes);
+#else
+    (void)worker;
+    (void)fd;
+#endif
+}
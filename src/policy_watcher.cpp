@@ -0,0 +1,144 @@
+#include "traffic_processor/policy_watcher.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace traffic_processor;
+
+PolicyWatcher::PolicyWatcher(std::string path, Callback onChange)
+    : path_(std::move(path)), onChange_(std::move(onChange))
+{
+}
+
+PolicyWatcher::~PolicyWatcher()
+{
+    stop();
+}
+
+void PolicyWatcher::start()
+{
+    if (running_.exchange(true))
+        return;
+#ifdef __linux__
+    // Watch the directory: editors and config-management tools usually
+    // replace the file (rename over it), which a file watch would miss.
+    // The watch exists before start() returns so no write can slip through.
+    std::string dir = ".";
+    fileName_ = path_;
+    if (auto slash = path_.rfind('/'); slash != std::string::npos)
+    {
+        dir = slash == 0 ? "/" : path_.substr(0, slash);
+        fileName_ = path_.substr(slash + 1);
+    }
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    notifyFd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (notifyFd_ >= 0 && inotify_add_watch(notifyFd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(notifyFd_);
+        notifyFd_ = -1;
+    }
+#endif
+    load();
+    thread_ = std::thread([this]
+                          { run(); });
+}
+
+void PolicyWatcher::stop()
+{
+    if (!running_.exchange(false))
+        return;
+#ifdef __linux__
+    if (wakeFd_ >= 0)
+    {
+        uint64_t one = 1;
+        (void)!write(wakeFd_, &one, sizeof(one));
+    }
+#endif
+    if (thread_.joinable())
+        thread_.join();
+#ifdef __linux__
+    if (wakeFd_ >= 0)
+        close(wakeFd_);
+    if (notifyFd_ >= 0)
+        close(notifyFd_);
+    wakeFd_ = -1;
+    notifyFd_ = -1;
+#endif
+}
+
+void PolicyWatcher::load()
+{
+    std::ifstream in(path_);
+    if (!in)
+    {
+        std::cerr << "Runtime config: cannot open " << path_ << std::endl;
+        return;
+    }
+    std::stringstream buf;
+    buf << in.rdbuf();
+    try
+    {
+        onChange_(nlohmann::json::parse(buf.str()));
+        std::cout << "Runtime config applied from " << path_ << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Runtime config rejected (" << path_ << "): " << e.what() << std::endl;
+    }
+}
+
+void PolicyWatcher::run()
+{
+#ifdef __linux__
+    if (notifyFd_ >= 0)
+    {
+        alignas(inotify_event) char events[4096];
+        while (running_.load())
+        {
+            pollfd fds[2] = {{notifyFd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+            if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN))
+                continue;
+
+            bool touched = false;
+            ssize_t n;
+            while ((n = read(notifyFd_, events, sizeof(events))) > 0)
+            {
+                for (char *p = events; p < events + n;)
+                {
+                    auto *ev = reinterpret_cast<inotify_event *>(p);
+                    if (ev->len > 0 && fileName_ == ev->name)
+                        touched = true;
+                    p += sizeof(inotify_event) + ev->len;
+                }
+            }
+            if (touched)
+                load();
+        }
+        return;
+    }
+    std::cerr << "Runtime config: inotify unavailable, polling " << path_ << std::endl;
+#endif
+
+    struct stat st{};
+    auto lastMtime = stat(path_.c_str(), &st) == 0 ? st.st_mtime : 0;
+    while (running_.load())
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (stat(path_.c_str(), &st) == 0 && st.st_mtime != lastMtime)
+        {
+            lastMtime = st.st_mtime;
+            load();
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#include "traffic_processor/producer_pool.hpp"
+
+#include <nlohmann/json.hpp>
+
+using namespace traffic_processor;
+
+ProducerPool &ProducerPool::shared()
+{
+    static ProducerPool *pool = new ProducerPool();
+    return *pool;
+}
+
+std::string ProducerPool::key(const KafkaConfig &config)
+{
+    nlohmann::json topics = nlohmann::json::object();
+    for (const auto &[name, t] : config.topics)
+        topics[name] = {t.compression, t.acks, t.lingerMs, t.batchSizeBytes, t.batchNumMessages};
+    return nlohmann::json{
+        config.bootstrapServers,
+        config.topic,
+        config.compression,
+        config.lingerMs,
+        config.batchSizeBytes,
+        config.batchNumMessages,
+        config.queueBufferingMaxMessages,
+        config.queueBufferingMaxKbytes,
+        config.acks,
+        config.retries,
+        config.requestTimeoutMs,
+        config.statisticsIntervalMs,
+        config.closeFlushTimeoutMs,
+        config.extraProperties,
+        std::move(topics),
+    }
+        .dump();
+}
+
+std::shared_ptr<KafkaProducer> ProducerPool::acquire(const KafkaConfig &config)
+{
+    std::string k = key(config);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = producers_.find(k);
+    if (it != producers_.end())
+    {
+        if (std::shared_ptr<KafkaProducer> producer = it->second.lock())
+            return producer;
+    }
+    auto producer = std::make_shared<KafkaProducer>(config);
+    producers_[std::move(k)] = producer;
+    return producer;
+}
+
+std::shared_ptr<KafkaProducer> ProducerPool::release(std::shared_ptr<KafkaProducer> lease)
+{
+    if (!lease)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Leases are only taken and dropped under the mutex, so a sole owner
+    // stays sole and two last releases cannot both miss being last
+    if (lease.use_count() > 1)
+    {
+        lease.reset();
+        return nullptr;
+    }
+    for (auto it = producers_.begin(); it != producers_.end();)
+    {
+        if (it->second.expired() || it->second.lock() == lease)
+            it = producers_.erase(it);
+        else
+            ++it;
+    }
+    return lease;
+}
+
+size_t ProducerPool::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t live = 0;
+    for (const auto &[k, producer] : producers_)
+        live += producer.expired() ? 0 : 1;
+    return live;
+}
@@ -0,0 +1,563 @@
+#include "traffic_processor/record_view.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace traffic_processor;
+
+namespace
+{
+    const char *skipWs(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    // p is just past an opening quote; returns the closing quote or nullptr.
+    // Bodies dominate record size, so string content is skipped 16 bytes at
+    // a time looking only for quotes and backslashes.
+    const char *stringEnd(const char *p, const char *end)
+    {
+        for (;;)
+        {
+#if defined(__SSE2__)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i slash = _mm_set1_epi8('\\');
+            while (p + 16 <= end)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                int bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)));
+                if (bits)
+                {
+                    p += __builtin_ctz(static_cast<unsigned>(bits));
+                    break;
+                }
+                p += 16;
+            }
+#endif
+            while (p < end && *p != '"' && *p != '\\')
+                ++p;
+            if (p >= end)
+                return nullptr;
+            if (*p == '"')
+                return p;
+            p += 2; // escaped character
+            if (p > end)
+                return nullptr;
+        }
+    }
+
+    // Returns one past the value starting at p, or nullptr if malformed
+    const char *skipValue(const char *p, const char *end)
+    {
+        if (p >= end)
+            return nullptr;
+        if (*p == '"')
+        {
+            const char *q = stringEnd(p + 1, end);
+            return q ? q + 1 : nullptr;
+        }
+        if (*p == '{' || *p == '[')
+        {
+            int depth = 0;
+            while (p < end)
+            {
+                char c = *p;
+                if (c == '"')
+                {
+                    const char *q = stringEnd(p + 1, end);
+                    if (!q)
+                        return nullptr;
+                    p = q + 1;
+                    continue;
+                }
+                if (c == '{' || c == '[')
+                    ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0)
+                    return p + 1;
+                ++p;
+            }
+            return nullptr;
+        }
+        const char *start = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t')
+            ++p;
+        return p > start ? p : nullptr;
+    }
+
+    // Calls f(rawKey, keyEscaped, rawValue) per member until f returns false
+    template <typename F>
+    bool forEachMember(const char *p, const char *end, F &&f)
+    {
+        p = skipWs(p, end);
+        if (p >= end || *p != '{')
+            return false;
+        p = skipWs(p + 1, end);
+        if (p < end && *p == '}')
+            return true;
+        for (;;)
+        {
+            if (p >= end || *p != '"')
+                return false;
+            const char *keyEnd = stringEnd(p + 1, end);
+            if (!keyEnd)
+                return false;
+            std::string_view key(p + 1, static_cast<size_t>(keyEnd - p - 1));
+            p = skipWs(keyEnd + 1, end);
+            if (p >= end || *p != ':')
+                return false;
+            p = skipWs(p + 1, end);
+            const char *valueEnd = skipValue(p, end);
+            if (!valueEnd)
+                return false;
+            if (!f(key, std::memchr(key.data(), '\\', key.size()) != nullptr, std::string_view(p, static_cast<size_t>(valueEnd - p))))
+                return true;
+            p = skipWs(valueEnd, end);
+            if (p < end && *p == ',')
+            {
+                p = skipWs(p + 1, end);
+                continue;
+            }
+            return p < end && *p == '}';
+        }
+    }
+
+    void appendUtf8(std::string &out, uint32_t cp)
+    {
+        if (cp < 0x80)
+            out.push_back(static_cast<char>(cp));
+        else if (cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+        else if (cp < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+        }
+    }
+
+    bool hex4(std::string_view s, size_t at, uint32_t &out)
+    {
+        if (at + 4 > s.size())
+            return false;
+        out = 0;
+        for (size_t i = at; i < at + 4; ++i)
+        {
+            char c = s[i];
+            uint32_t d = c >= '0' && c <= '9'   ? static_cast<uint32_t>(c - '0')
+                         : c >= 'a' && c <= 'f' ? static_cast<uint32_t>(c - 'a' + 10)
+                         : c >= 'A' && c <= 'F' ? static_cast<uint32_t>(c - 'A' + 10)
+                                                : 16;
+            if (d > 15)
+                return false;
+            out = (out << 4) | d;
+        }
+        return true;
+    }
+
+    // Unescapes the content of a JSON string (quotes excluded)
+    void unescape(std::string_view in, std::string &out)
+    {
+        out.reserve(in.size());
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            char c = in[i];
+            if (c != '\\' || i + 1 >= in.size())
+            {
+                out.push_back(c);
+                continue;
+            }
+            char e = in[++i];
+            switch (e)
+            {
+            case 'n':
+                out.push_back('\n');
+                break;
+            case 't':
+                out.push_back('\t');
+                break;
+            case 'r':
+                out.push_back('\r');
+                break;
+            case 'b':
+                out.push_back('\b');
+                break;
+            case 'f':
+                out.push_back('\f');
+                break;
+            case 'u':
+            {
+                uint32_t cp;
+                if (!hex4(in, i + 1, cp))
+                {
+                    out.push_back('?');
+                    break;
+                }
+                i += 4;
+                uint32_t low;
+                if (cp >= 0xd800 && cp < 0xdc00 && i + 2 < in.size() && in[i + 1] == '\\' && in[i + 2] == 'u' &&
+                    hex4(in, i + 3, low) && low >= 0xdc00 && low < 0xe000)
+                {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    i += 6;
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default: // '"', '\\', '/'
+                out.push_back(e);
+            }
+        }
+    }
+
+    bool parseInt(std::string_view raw, int64_t &out)
+    {
+        if (raw.empty())
+            return false;
+        bool negative = raw.front() == '-';
+        size_t i = negative ? 1 : 0;
+        int64_t v = 0;
+        size_t digits = 0;
+        for (; i < raw.size() && raw[i] >= '0' && raw[i] <= '9' && digits < 19; ++i, ++digits)
+            v = v * 10 + (raw[i] - '0');
+        if (digits == 0)
+            return false;
+        out = negative ? -v : v;
+        return true;
+    }
+
+    bool iequals(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            char x = a[i], y = b[i];
+            if (x >= 'A' && x <= 'Z')
+                x = static_cast<char>(x + 32);
+            if (y >= 'A' && y <= 'Z')
+                y = static_cast<char>(y + 32);
+            if (x != y)
+                return false;
+        }
+        return true;
+    }
+}
+
+bool traffic_processor::splitRecords(std::string_view payload, std::vector<std::string_view> &out)
+{
+    const char *p = payload.data();
+    const char *end = p + payload.size();
+    p = skipWs(p, end);
+    if (p < end && *p == '[')
+    {
+        p = skipWs(p + 1, end);
+        if (p < end && *p == ']')
+            return skipWs(p + 1, end) == end;
+        for (;;)
+        {
+            if (p >= end || *p != '{')
+                return false;
+            const char *valueEnd = skipValue(p, end);
+            if (!valueEnd)
+                return false;
+            out.emplace_back(p, static_cast<size_t>(valueEnd - p));
+            p = skipWs(valueEnd, end);
+            if (p < end && *p == ',')
+            {
+                p = skipWs(p + 1, end);
+                continue;
+            }
+            return p < end && *p == ']' && skipWs(p + 1, end) == end;
+        }
+    }
+    // One object, or several separated by newlines
+    while (p < end)
+    {
+        if (*p != '{')
+            return false;
+        const char *valueEnd = skipValue(p, end);
+        if (!valueEnd)
+            return false;
+        out.emplace_back(p, static_cast<size_t>(valueEnd - p));
+        p = skipWs(valueEnd, end);
+    }
+    return true;
+}
+
+RecordView::RecordView(std::string_view json)
+    : json_(json)
+{
+}
+
+void RecordView::reset(std::string_view json)
+{
+    json_ = json;
+    indexed_ = false;
+    valid_ = false;
+    for (auto &f : fields_)
+        f = {};
+    request_ = Section{};
+    response_ = Section{};
+    decodedUsed_ = 0;
+}
+
+void RecordView::index() const
+{
+    if (indexed_)
+        return;
+    indexed_ = true;
+    valid_ = forEachMember(json_.data(), json_.data() + json_.size(),
+                           [this](std::string_view key, bool escaped, std::string_view value)
+                           {
+                               if (escaped)
+                                   return true;
+                               if (key == "request")
+                                   fields_[Request] = value;
+                               else if (key == "response")
+                                   fields_[Response] = value;
+                               else if (key == "timestamp")
+                                   fields_[Timestamp] = value;
+                               else if (key == "latency_ms")
+                                   fields_[LatencyMs] = value;
+                               else if (key == "account_id")
+                                   fields_[AccountId] = value;
+                               else if (key == "record_id")
+                                   fields_[RecordId] = value;
+                               return true;
+                           });
+    for (auto [section, field] : {std::pair{&request_, Request}, std::pair{&response_, Response}})
+    {
+        section->owner_ = this;
+        std::string_view v = fields_[field];
+        if (!v.empty() && v.front() == '{')
+        {
+            section->begin_ = v.data();
+            section->end_ = v.data() + v.size();
+        }
+    }
+}
+
+std::string_view RecordView::decode(std::string_view raw) const
+{
+    if (!std::memchr(raw.data(), '\\', raw.size()))
+        return raw;
+    if (decodedUsed_ == decoded_.size())
+        decoded_.emplace_back();
+    std::string &s = decoded_[decodedUsed_++];
+    s.clear();
+    unescape(raw, s);
+    return s;
+}
+
+bool RecordView::valid() const
+{
+    index();
+    return valid_;
+}
+
+std::string_view RecordView::accountId() const
+{
+    index();
+    std::string_view v = fields_[AccountId];
+    return v.size() >= 2 && v.front() == '"' ? decode(v.substr(1, v.size() - 2)) : std::string_view{};
+}
+
+std::string_view RecordView::recordId() const
+{
+    index();
+    std::string_view v = fields_[RecordId];
+    return v.size() >= 2 && v.front() == '"' ? decode(v.substr(1, v.size() - 2)) : std::string_view{};
+}
+
+int64_t RecordView::timestamp() const
+{
+    index();
+    int64_t v = 0;
+    return parseInt(fields_[Timestamp], v) ? v : 0;
+}
+
+int64_t RecordView::latencyMs() const
+{
+    index();
+    int64_t v = 0;
+    return parseInt(fields_[LatencyMs], v) ? v : -1;
+}
+
+const RecordView::Section &RecordView::request() const
+{
+    index();
+    return request_;
+}
+
+const RecordView::Section &RecordView::response() const
+{
+    index();
+    return response_;
+}
+
+std::string_view RecordView::raw(std::string_view key) const
+{
+    std::string_view found;
+    forEachMember(json_.data(), json_.data() + json_.size(),
+                  [&](std::string_view k, bool, std::string_view value)
+                  {
+                      if (k != key)
+                          return true;
+                      found = value;
+                      return false;
+                  });
+    return found;
+}
+
+RequestData RecordView::toRequestData() const
+{
+    const Section &s = request();
+    RequestData r;
+    r.method = s.method();
+    r.scheme = s.scheme();
+    r.host = s.host();
+    r.path = s.path();
+    r.query = s.query();
+    r.routeTemplate = s.routeTemplate();
+    r.headers = s.headers();
+    r.bodyText = s.bodyText();
+    r.bodyBase64 = s.bodyBase64();
+    r.ip = s.ip();
+    return r;
+}
+
+ResponseData RecordView::toResponseData() const
+{
+    const Section &s = response();
+    ResponseData r;
+    r.status = s.status();
+    r.headers = s.headers();
+    r.bodyText = s.bodyText();
+    r.bodyBase64 = s.bodyBase64();
+    return r;
+}
+
+void RecordView::Section::index() const
+{
+    if (indexed_ || !begin_)
+        return;
+    indexed_ = true;
+    forEachMember(begin_, end_,
+                  [this](std::string_view key, bool escaped, std::string_view value)
+                  {
+                      if (escaped)
+                          return true;
+                      static constexpr std::pair<std::string_view, Field> names[] = {
+                          {"method", Method}, {"status", Status}, {"path", Path}, {"headers", Headers}, {"body", Body}, {"body_b64", BodyBase64}, {"query", Query}, {"query_params", QueryParams}, {"route_template", RouteTemplate}, {"host", Host}, {"scheme", Scheme}, {"ip", Ip}, {"body_truncated", BodyTruncated}, {"body_ref", BodyRef}, {"extracted", Extracted}};
+                      for (const auto &[name, field] : names)
+                      {
+                          if (key == name)
+                          {
+                              fields_[field] = value;
+                              break;
+                          }
+                      }
+                      return true;
+                  });
+}
+
+std::string_view RecordView::Section::string(Field f) const
+{
+    index();
+    std::string_view v = fields_[f];
+    if (v.size() < 2 || v.front() != '"')
+        return {};
+    return owner_->decode(v.substr(1, v.size() - 2));
+}
+
+int RecordView::Section::status() const
+{
+    index();
+    int64_t v = 0;
+    return parseInt(fields_[Status], v) ? static_cast<int>(v) : 0;
+}
+
+bool RecordView::Section::bodyTruncated() const
+{
+    index();
+    return fields_[BodyTruncated] == "true";
+}
+
+std::string_view RecordView::Section::extracted(std::string_view path) const
+{
+    index();
+    std::string_view fields = fields_[Extracted];
+    std::string_view found;
+    forEachMember(fields.data(), fields.data() + fields.size(),
+                  [&](std::string_view key, bool escaped, std::string_view value)
+                  {
+                      if ((escaped ? owner_->decode(key) : key) != path)
+                          return true;
+                      found = value;
+                      return false;
+                  });
+    return found;
+}
+
+std::string_view RecordView::Section::header(std::string_view name) const
+{
+    index();
+    std::string_view headers = fields_[Headers];
+    std::string_view found;
+    forEachMember(headers.data(), headers.data() + headers.size(),
+                  [&](std::string_view key, bool escaped, std::string_view value)
+                  {
+                      if (!iequals(escaped ? owner_->decode(key) : key, name))
+                          return true;
+                      if (value.size() >= 2 && value.front() == '"')
+                          found = owner_->decode(value.substr(1, value.size() - 2));
+                      return false;
+                  });
+    return found;
+}
+
+nlohmann::json RecordView::Section::headers() const
+{
+    index();
+    std::string_view v = fields_[Headers];
+    return v.empty() ? nlohmann::json::object() : nlohmann::json::parse(v, nullptr, false);
+}
+
+nlohmann::json RecordView::Section::queryParams() const
+{
+    index();
+    std::string_view v = fields_[QueryParams];
+    return v.empty() ? nlohmann::json::object() : nlohmann::json::parse(v, nullptr, false);
+}
+
+std::string_view RecordView::Section::raw(std::string_view key) const
+{
+    std::string_view found;
+    if (begin_)
+    {
+        forEachMember(begin_, end_,
+                      [&](std::string_view k, bool, std::string_view value)
+                      {
+                          if (k != key)
+                              return true;
+                          found = value;
+                          return false;
+                      });
+    }
+    return found;
+}
@@ -0,0 +1,593 @@
+#include "traffic_processor/redactor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace traffic_processor;
+
+namespace
+{
+    constexpr size_t kMaxRootedJsonPaths = 64;
+    constexpr int kMaxJsonDepth = 64;
+
+    std::string toLower(std::string_view s)
+    {
+        std::string out(s);
+        for (auto &c : out)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return out;
+    }
+
+    bool isAlnum(unsigned char c)
+    {
+        return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+    }
+
+    bool isTokenChar(unsigned char c)
+    {
+        return isAlnum(c) || c == '-' || c == '_' || c == '.' || c == '+' || c == '/' || c == '=';
+    }
+
+    bool isDigit(unsigned char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    using BytePairs = std::vector<std::pair<unsigned char, unsigned char>>;
+
+    // Returns the first position in [p, end) where a pattern may start.
+    // With SSE2 this compares 16 positions at once against up to 8 leading
+    // byte pairs (or single bytes); otherwise it falls back to the bitmap.
+    const unsigned char *findCandidate(const unsigned char *p, const unsigned char *end,
+                                       const std::vector<unsigned char> &bytes, const BytePairs &pairs,
+                                       const bool (&set)[256])
+    {
+#if defined(__SSE2__)
+        if (!pairs.empty() && pairs.size() <= 8)
+        {
+            __m128i a[8], b[8];
+            for (size_t k = 0; k < pairs.size(); ++k)
+            {
+                a[k] = _mm_set1_epi8(static_cast<char>(pairs[k].first));
+                b[k] = _mm_set1_epi8(static_cast<char>(pairs[k].second));
+            }
+            while (end - p >= 17)
+            {
+                __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+                __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(v0, a[0]), _mm_cmpeq_epi8(v1, b[0]));
+                for (size_t k = 1; k < pairs.size(); ++k)
+                    hit = _mm_or_si128(hit, _mm_and_si128(_mm_cmpeq_epi8(v0, a[k]), _mm_cmpeq_epi8(v1, b[k])));
+                int bits = _mm_movemask_epi8(hit);
+                if (bits)
+                    return p + __builtin_ctz(static_cast<unsigned>(bits));
+                p += 16;
+            }
+        }
+        else if (!bytes.empty() && bytes.size() <= 8)
+        {
+            __m128i n[8];
+            for (size_t k = 0; k < bytes.size(); ++k)
+                n[k] = _mm_set1_epi8(static_cast<char>(bytes[k]));
+            while (end - p >= 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                __m128i hit = _mm_cmpeq_epi8(v, n[0]);
+                for (size_t k = 1; k < bytes.size(); ++k)
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, n[k]));
+                int bits = _mm_movemask_epi8(hit);
+                if (bits)
+                    return p + __builtin_ctz(static_cast<unsigned>(bits));
+                p += 16;
+            }
+        }
+#else
+        (void)bytes;
+        (void)pairs;
+#endif
+        for (; p < end; ++p)
+        {
+            if (set[*p])
+                return p;
+        }
+        return end;
+    }
+
+    // Next '"' or '\\' in [p, end)
+    const unsigned char *findQuoteOrEscape(const unsigned char *p, const unsigned char *end)
+    {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i slash = _mm_set1_epi8('\\');
+        while (end - p >= 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            int bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)));
+            if (bits)
+                return p + __builtin_ctz(static_cast<unsigned>(bits));
+            p += 16;
+        }
+#endif
+        for (; p < end; ++p)
+        {
+            if (*p == '"' || *p == '\\')
+                return p;
+        }
+        return end;
+    }
+
+    const unsigned char *findDigit(const unsigned char *p, const unsigned char *end)
+    {
+#if defined(__SSE2__)
+        const __m128i zero = _mm_set1_epi8('0');
+        const __m128i nine = _mm_set1_epi8(9);
+        while (end - p >= 16)
+        {
+            __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), zero);
+            // unsigned v <= 9  <=>  min(v, 9) == v
+            int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, nine), v));
+            if (bits)
+                return p + __builtin_ctz(static_cast<unsigned>(bits));
+            p += 16;
+        }
+#endif
+        for (; p < end; ++p)
+        {
+            if (isDigit(*p))
+                return p;
+        }
+        return end;
+    }
+
+    bool luhnValid(const unsigned char *data, const size_t *pos, int count)
+    {
+        int sum = 0;
+        bool dbl = false;
+        for (int k = count - 1; k >= 0; --k)
+        {
+            int d = data[pos[k]] - '0';
+            if (dbl)
+            {
+                d *= 2;
+                if (d > 9)
+                    d -= 9;
+            }
+            sum += d;
+            dbl = !dbl;
+        }
+        return sum % 10 == 0;
+    }
+
+    bool maskCards(unsigned char *data, size_t len, char fill)
+    {
+        if (len < 13)
+            return false;
+        bool changed = false;
+        const unsigned char *end = data + len;
+        const unsigned char *p = data;
+        size_t pos[19];
+        while ((p = findDigit(p, end)) < end)
+        {
+            size_t i = static_cast<size_t>(p - data);
+            if (i > 0 && isAlnum(data[i - 1]))
+            {
+                while (p < end && isAlnum(*p))
+                    ++p;
+                continue;
+            }
+
+            int count = 0;
+            bool tooLong = false;
+            size_t j = i;
+            while (j < len)
+            {
+                if (isDigit(data[j]))
+                {
+                    if (count == 19)
+                    {
+                        tooLong = true;
+                        break;
+                    }
+                    pos[count++] = j++;
+                }
+                else if ((data[j] == ' ' || data[j] == '-') && j + 1 < len && isDigit(data[j + 1]))
+                {
+                    ++j;
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            bool bounded = j >= len || !isAlnum(data[j]);
+            if (!tooLong && bounded && count >= 13 && luhnValid(data, pos, count))
+            {
+                for (int k = 0; k < count - 4; ++k)
+                    data[pos[k]] = static_cast<unsigned char>(fill);
+                changed = true;
+            }
+
+            while (j < len && (isDigit(data[j]) || data[j] == ' ' || data[j] == '-'))
+                ++j;
+            p = data + j;
+        }
+        return changed;
+    }
+} // namespace
+
+Redactor::Redactor(const RedactionConfig &config) : enabled_(config.enabled), cfg_(config)
+{
+    for (const auto &h : cfg_.headerDenyList)
+        denyLower_.push_back(toLower(h));
+    for (const auto &h : cfg_.headerMaskList)
+        maskLower_.push_back(toLower(h));
+    std::sort(denyLower_.begin(), denyLower_.end());
+    std::sort(maskLower_.begin(), maskLower_.end());
+
+    // Build the Aho-Corasick trie, then flatten goto/fail into a dense DFA
+    std::vector<std::string> patterns;
+    for (const auto &p : cfg_.bodyPatterns)
+    {
+        if (!p.empty())
+            patterns.push_back(p);
+    }
+    if (!patterns.empty())
+    {
+        std::vector<std::array<int32_t, 256>> go(1);
+        go[0].fill(-1);
+        matchLen_.assign(1, 0);
+        for (const auto &p : patterns)
+        {
+            int32_t s = 0;
+            for (unsigned char c : p)
+            {
+                if (go[s][c] < 0)
+                {
+                    go[s][c] = static_cast<int32_t>(go.size());
+                    go.emplace_back();
+                    go.back().fill(-1);
+                    matchLen_.push_back(0);
+                }
+                s = go[s][c];
+            }
+            matchLen_[s] = std::max<uint16_t>(matchLen_[s], static_cast<uint16_t>(std::min<size_t>(p.size(), UINT16_MAX)));
+            unsigned char first = static_cast<unsigned char>(p[0]);
+            if (!firstByteSet_[first])
+            {
+                firstByteSet_[first] = true;
+                firstBytes_.push_back(first);
+            }
+        }
+
+        bool allPairs = true;
+        for (const auto &p : patterns)
+        {
+            if (p.size() < 2)
+            {
+                allPairs = false;
+                break;
+            }
+            std::pair<unsigned char, unsigned char> pair{static_cast<unsigned char>(p[0]), static_cast<unsigned char>(p[1])};
+            if (std::find(firstPairs_.begin(), firstPairs_.end(), pair) == firstPairs_.end())
+                firstPairs_.push_back(pair);
+        }
+        if (!allPairs)
+            firstPairs_.clear();
+
+        const size_t states = go.size();
+        delta_.assign(states * 256, 0);
+        std::vector<int32_t> fail(states, 0);
+        std::queue<int32_t> bfs;
+        for (int c = 0; c < 256; ++c)
+        {
+            int32_t t = go[0][c];
+            delta_[c] = t < 0 ? 0 : t;
+            if (t > 0)
+                bfs.push(t);
+        }
+        while (!bfs.empty())
+        {
+            int32_t s = bfs.front();
+            bfs.pop();
+            matchLen_[s] = std::max(matchLen_[s], matchLen_[fail[s]]);
+            for (int c = 0; c < 256; ++c)
+            {
+                int32_t t = go[s][c];
+                if (t < 0)
+                {
+                    delta_[s * 256 + c] = delta_[fail[s] * 256 + c];
+                }
+                else
+                {
+                    fail[t] = delta_[fail[s] * 256 + c];
+                    delta_[s * 256 + c] = t;
+                    bfs.push(t);
+                }
+            }
+        }
+    }
+
+    for (const auto &f : cfg_.jsonFields)
+    {
+        if (f.rfind("$.", 0) == 0)
+        {
+            if (jsonRooted_.size() == kMaxRootedJsonPaths)
+                throw std::invalid_argument("At most " + std::to_string(kMaxRootedJsonPaths) +
+                                            " rooted JSON paths can be redacted; rejected " + f);
+            JsonPath path;
+            size_t start = 2;
+            while (start <= f.size())
+            {
+                size_t dot = f.find('.', start);
+                if (dot == std::string::npos)
+                    dot = f.size();
+                if (dot > start)
+                    path.segments.push_back(f.substr(start, dot - start));
+                start = dot + 1;
+            }
+            if (!path.segments.empty())
+                jsonRooted_.push_back(std::move(path));
+        }
+        else if (!f.empty())
+        {
+            jsonAnyDepth_.push_back(f);
+        }
+    }
+}
+
+bool Redactor::headerListed(const std::vector<std::string> &list, std::string_view name) const
+{
+    if (list.empty())
+        return false;
+    char buf[128];
+    if (name.size() > sizeof(buf))
+        return std::binary_search(list.begin(), list.end(), toLower(name));
+    for (size_t i = 0; i < name.size(); ++i)
+        buf[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[i])));
+    std::string_view lower(buf, name.size());
+    return std::binary_search(list.begin(), list.end(), lower,
+                              [](std::string_view a, std::string_view b)
+                              { return a < b; });
+}
+
+void Redactor::redactHeaders(nlohmann::json &headers) const
+{
+    if (!enabled_ || !headers.is_object())
+        return;
+    for (auto it = headers.begin(); it != headers.end();)
+    {
+        if (headerListed(denyLower_, it.key()))
+        {
+            it = headers.erase(it);
+            continue;
+        }
+        if (headerListed(maskLower_, it.key()))
+            it.value() = cfg_.headerMaskValue;
+        ++it;
+    }
+}
+
+bool Redactor::redactBody(std::string &body) const
+{
+    return redactBody(body.data(), body.size());
+}
+
+bool Redactor::redactBody(char *data, size_t len) const
+{
+    if (!enabled_ || len == 0)
+        return false;
+    auto *bytes = reinterpret_cast<unsigned char *>(data);
+
+    bool changed = maskPatterns(bytes, len);
+
+    size_t first = 0;
+    while (first < len && std::isspace(bytes[first]))
+        ++first;
+    bool looksJson = first < len && (bytes[first] == '{' || bytes[first] == '[');
+    if (looksJson && (!jsonAnyDepth_.empty() || !jsonRooted_.empty() || cfg_.maskCardNumbers))
+    {
+        // The JSON pass also handles card numbers so it can keep numbers valid
+        changed |= maskJsonFields(bytes, len);
+    }
+    else if (cfg_.maskCardNumbers)
+    {
+        changed |= maskCardNumbers(bytes, len);
+    }
+    return changed;
+}
+
+bool Redactor::maskPatterns(unsigned char *data, size_t len) const
+{
+    if (delta_.empty())
+        return false;
+    bool changed = false;
+    const unsigned char *end = data + len;
+    int32_t state = 0;
+    size_t i = 0;
+    while (i < len)
+    {
+        if (state == 0)
+        {
+            // Only a pattern's first byte can leave the root: skip ahead with SIMD
+            const unsigned char *next = findCandidate(data + i, end, firstBytes_, firstPairs_, firstByteSet_);
+            if (next == end)
+                break;
+            i = static_cast<size_t>(next - data);
+        }
+        state = delta_[static_cast<size_t>(state) * 256 + data[i]];
+        uint16_t matched = matchLen_[state];
+        if (matched)
+        {
+            size_t from = i + 1 - matched;
+            size_t to = i + 1;
+            while (to < len && isTokenChar(data[to]))
+                ++to;
+            std::memset(data + from, cfg_.maskChar, to - from);
+            changed = true;
+            state = 0;
+            i = to;
+            continue;
+        }
+        ++i;
+    }
+    return changed;
+}
+
+bool Redactor::maskCardNumbers(unsigned char *data, size_t len) const
+{
+    return maskCards(data, len, cfg_.maskChar);
+}
+
+bool Redactor::maskJsonFields(unsigned char *data, size_t len) const
+{
+    struct Frame
+    {
+        bool object;
+        bool expectKey;
+        bool maskAll;
+        int depth;      // index into rooted path segments for keys of this object
+        uint64_t alive; // rooted paths whose prefix matches the path to here
+    };
+
+    Frame stack[kMaxJsonDepth];
+    int top = -1;
+    bool changed = false;
+
+    // Context for the next value to be read
+    bool pendingMask = false;
+    int pendingDepth = 0;
+    uint64_t pendingAlive = jsonRooted_.size() == 64 ? ~uint64_t{0} : ((uint64_t{1} << jsonRooted_.size()) - 1);
+
+    size_t i = 0;
+    while (i < len)
+    {
+        unsigned char c = data[i];
+        switch (c)
+        {
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+        case ':':
+            ++i;
+            break;
+        case '{':
+        case '[':
+            if (top + 1 == kMaxJsonDepth)
+                return changed | maskCardNumbers(data + i, len - i);
+            ++top;
+            stack[top] = Frame{c == '{', c == '{', pendingMask, pendingDepth, pendingAlive};
+            ++i;
+            break;
+        case '}':
+        case ']':
+            if (top < 0)
+                return changed;
+            --top;
+            ++i;
+            break;
+        case ',':
+            if (top < 0)
+                return changed;
+            if (stack[top].object)
+            {
+                stack[top].expectKey = true;
+            }
+            else
+            {
+                pendingMask = stack[top].maskAll;
+                pendingDepth = stack[top].depth;
+                pendingAlive = stack[top].alive;
+            }
+            ++i;
+            break;
+        case '"':
+        {
+            size_t start = i + 1;
+            size_t j = start;
+            while (true)
+            {
+                j = static_cast<size_t>(findQuoteOrEscape(data + std::min(j, len), data + len) - data);
+                if (j >= len || data[j] == '"')
+                    break;
+                j += 2;
+            }
+            if (j >= len)
+                return changed;
+            if (top >= 0 && stack[top].object && stack[top].expectKey)
+            {
+                Frame &f = stack[top];
+                std::string_view key(reinterpret_cast<const char *>(data + start), j - start);
+                bool mask = f.maskAll;
+                for (size_t k = 0; !mask && k < jsonAnyDepth_.size(); ++k)
+                    mask = jsonAnyDepth_[k] == key;
+                uint64_t childAlive = 0;
+                for (uint64_t bits = f.alive; bits; bits &= bits - 1)
+                {
+                    size_t k = static_cast<size_t>(__builtin_ctzll(bits));
+                    const auto &segs = jsonRooted_[k].segments;
+                    if (static_cast<size_t>(f.depth) >= segs.size())
+                        continue;
+                    const auto &seg = segs[f.depth];
+                    if (seg != "*" && seg != key)
+                        continue;
+                    if (segs.size() == static_cast<size_t>(f.depth) + 1)
+                        mask = true;
+                    else
+                        childAlive |= uint64_t{1} << k;
+                }
+                f.expectKey = false;
+                pendingMask = mask;
+                pendingDepth = f.depth + 1;
+                pendingAlive = childAlive;
+            }
+            else if (pendingMask)
+            {
+                if (j > start)
+                {
+                    std::memset(data + start, cfg_.maskChar, j - start);
+                    changed = true;
+                }
+            }
+            else if (cfg_.maskCardNumbers)
+            {
+                changed |= maskCards(data + start, j - start, cfg_.maskChar);
+            }
+            i = j + 1;
+            break;
+        }
+        default:
+        {
+            size_t j = i;
+            bool number = c == '-' || isDigit(c);
+            while (j < len && (isAlnum(data[j]) || data[j] == '-' || data[j] == '+' || data[j] == '.'))
+                ++j;
+            if (j == i)
+                return changed;
+            if (number && pendingMask)
+            {
+                // Keep the token a valid JSON number of the same length
+                std::memset(data + i, '9', j - i);
+                changed = true;
+            }
+            else if (number && cfg_.maskCardNumbers)
+            {
+                changed |= maskCards(data + i, j - i, '9');
+            }
+            i = j;
+            break;
+        }
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,367 @@
+#include "traffic_processor/route_normalizer.hpp"
+
+#include <algorithm>
+#include <functional>
+
+using namespace traffic_processor;
+
+namespace
+{
+    bool isHex(char c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        return (c | 0x20) - 'a' + 10;
+    }
+
+    std::string percentDecode(std::string_view in)
+    {
+        std::string out;
+        out.reserve(in.size());
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            if (in[i] == '+')
+                out.push_back(' ');
+            else if (in[i] == '%' && i + 2 < in.size() && isHex(in[i + 1]) && isHex(in[i + 2]))
+            {
+                out.push_back(static_cast<char>(hexValue(in[i + 1]) * 16 + hexValue(in[i + 2])));
+                i += 2;
+            }
+            else
+                out.push_back(in[i]);
+        }
+        return out;
+    }
+
+    bool isUuid(std::string_view s)
+    {
+        if (s.size() != 36)
+            return false;
+        for (size_t i = 0; i < 36; ++i)
+        {
+            bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+            if (dash ? s[i] != '-' : !isHex(s[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // Placeholder for an identifier-like path segment, or empty if it looks static
+    std::string_view classifySegment(std::string_view seg)
+    {
+        if (seg.empty())
+            return {};
+        size_t digits = 0, hex = 0, alpha = 0, other = 0;
+        for (char c : seg)
+        {
+            if (c >= '0' && c <= '9')
+                ++digits;
+            else if (isHex(c))
+                ++hex;
+            else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+                ++alpha;
+            else if (c != '-' && c != '_' && c != '.' && c != '~' && c != '=')
+                ++other;
+        }
+        if (digits == seg.size())
+            return "{id}";
+        if (isUuid(seg))
+            return "{uuid}";
+        if (digits + hex == seg.size() && seg.size() >= 16)
+            return "{hash}";
+        if (seg.size() >= 20 && digits > 0 && (alpha + hex) > 0 && other == 0)
+            return "{token}";
+        return {};
+    }
+
+    std::string_view placeholderFor(std::string_view seg)
+    {
+        // Crow: <int>, <uint>, <double>, <string>, <path>; also {name} and :name
+        if (seg.size() >= 2 && ((seg.front() == '<' && seg.back() == '>') || (seg.front() == '{' && seg.back() == '}')))
+            return seg.substr(1, seg.size() - 2);
+        if (seg.size() >= 2 && seg.front() == ':')
+            return seg.substr(1);
+        return {};
+    }
+
+    uint64_t fnv1a(std::string_view s)
+    {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    template <typename Fn>
+    void forEachSegment(std::string_view path, Fn &&fn)
+    {
+        size_t i = 0;
+        while (i < path.size())
+        {
+            if (path[i] == '/')
+            {
+                ++i;
+                continue;
+            }
+            size_t j = path.find('/', i);
+            if (j == std::string_view::npos)
+                j = path.size();
+            if (!fn(path.substr(i, j - i), j))
+                return;
+            i = j;
+        }
+    }
+} // namespace
+
+struct RouteNormalizer::Trie
+{
+    struct Node
+    {
+        std::vector<std::pair<std::string, int>> children; // sorted by segment
+        int param{-1};                                      // any single segment
+        int rest{-1};                                       // <path>: matches the remainder
+        int route{-1};
+    };
+
+    std::vector<Node> nodes{Node{}};
+    std::vector<std::string> templates;
+
+    void insert(std::string_view pattern)
+    {
+        int n = 0;
+        bool done = false;
+        forEachSegment(pattern, [&](std::string_view seg, size_t)
+                       {
+            std::string_view ph = placeholderFor(seg);
+            int *slot = nullptr;
+            if (ph == "path")
+            {
+                slot = &nodes[n].rest;
+                done = true;
+            }
+            else if (!ph.empty())
+            {
+                slot = &nodes[n].param;
+            }
+            else
+            {
+                auto &ch = nodes[n].children;
+                auto it = std::lower_bound(ch.begin(), ch.end(), seg,
+                                           [](const auto &e, std::string_view k)
+                                           { return e.first < k; });
+                if (it == ch.end() || it->first != seg)
+                {
+                    int idx = static_cast<int>(nodes.size());
+                    ch.insert(it, {std::string(seg), idx});
+                    nodes.emplace_back();
+                    n = idx;
+                }
+                else
+                {
+                    n = it->second;
+                }
+                return true;
+            }
+            if (*slot < 0)
+            {
+                // Read the index before emplace_back() invalidates slot
+                *slot = static_cast<int>(nodes.size());
+                n = *slot;
+                nodes.emplace_back();
+            }
+            else
+            {
+                n = *slot;
+            }
+            return !done; });
+
+        if (nodes[n].route < 0)
+        {
+            nodes[n].route = static_cast<int>(templates.size());
+            templates.emplace_back(pattern);
+        }
+    }
+
+    int match(int n, std::string_view path, size_t pos) const
+    {
+        while (pos < path.size() && path[pos] == '/')
+            ++pos;
+        if (pos >= path.size())
+            return nodes[n].route;
+
+        size_t end = path.find('/', pos);
+        if (end == std::string_view::npos)
+            end = path.size();
+        std::string_view seg = path.substr(pos, end - pos);
+
+        // Static segments win over parameters, which win over <path>
+        const auto &ch = nodes[n].children;
+        auto it = std::lower_bound(ch.begin(), ch.end(), seg,
+                                   [](const auto &e, std::string_view k)
+                                   { return e.first < k; });
+        if (it != ch.end() && it->first == seg)
+        {
+            int r = match(it->second, path, end);
+            if (r >= 0)
+                return r;
+        }
+        if (nodes[n].param >= 0)
+        {
+            int r = match(nodes[n].param, path, end);
+            if (r >= 0)
+                return r;
+        }
+        if (nodes[n].rest >= 0)
+            return nodes[nodes[n].rest].route;
+        return -1;
+    }
+};
+
+nlohmann::json traffic_processor::parseQueryString(std::string_view query)
+{
+    nlohmann::json out = nlohmann::json::object();
+    if (!query.empty() && query.front() == '?')
+        query.remove_prefix(1);
+    size_t i = 0;
+    while (i < query.size())
+    {
+        size_t amp = query.find('&', i);
+        if (amp == std::string_view::npos)
+            amp = query.size();
+        std::string_view pair = query.substr(i, amp - i);
+        i = amp + 1;
+        if (pair.empty())
+            continue;
+
+        size_t eq = pair.find('=');
+        std::string key = percentDecode(pair.substr(0, eq));
+        std::string value = eq == std::string_view::npos ? std::string() : percentDecode(pair.substr(eq + 1));
+
+        auto it = out.find(key);
+        if (it == out.end())
+        {
+            out.emplace(std::move(key), std::move(value));
+        }
+        else
+        {
+            if (!it->is_array())
+                *it = nlohmann::json::array({std::move(*it)});
+            it->push_back(std::move(value));
+        }
+    }
+    return out;
+}
+
+RouteNormalizer::RouteNormalizer() : RouteNormalizer(RouteConfig{})
+{
+}
+
+RouteNormalizer::RouteNormalizer(const RouteConfig &config) : cfg_(config)
+{
+    auto trie = std::make_unique<Trie>();
+    for (const auto &r : cfg_.routes)
+        trie->insert(r);
+    trie_.store(trie.get(), std::memory_order_release);
+    tries_.push_back(std::move(trie));
+
+    if (cfg_.autoLearn && cfg_.maxLearnedRoutes > 0)
+    {
+        // Power-of-two table at <= 50% load keeps probe sequences short
+        size_t cap = 1;
+        while (cap < cfg_.maxLearnedRoutes * 2)
+            cap <<= 1;
+        learnedMask_ = cap - 1;
+        learned_.reset(new std::atomic<const std::string *>[cap]);
+        for (size_t i = 0; i < cap; ++i)
+            learned_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+RouteNormalizer::~RouteNormalizer()
+{
+    if (learned_)
+    {
+        for (size_t i = 0; i <= learnedMask_; ++i)
+            delete learned_[i].load(std::memory_order_relaxed);
+    }
+}
+
+void RouteNormalizer::addRoute(std::string_view pattern)
+{
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    auto next = std::make_unique<Trie>(*trie_.load(std::memory_order_relaxed));
+    next->insert(pattern);
+    // Old snapshots stay alive: readers may still be walking them
+    trie_.store(next.get(), std::memory_order_release);
+    tries_.push_back(std::move(next));
+}
+
+const std::string *RouteNormalizer::learn(std::string &&tmpl) const
+{
+    size_t idx = fnv1a(tmpl) & learnedMask_;
+    std::string *mine = nullptr;
+    for (size_t probe = 0; probe <= learnedMask_; ++probe, idx = (idx + 1) & learnedMask_)
+    {
+        const std::string *cur = learned_[idx].load(std::memory_order_acquire);
+        while (!cur)
+        {
+            if (learnedCount_.load(std::memory_order_relaxed) >= cfg_.maxLearnedRoutes)
+            {
+                delete mine;
+                return nullptr;
+            }
+            if (!mine)
+                mine = new std::string(std::move(tmpl));
+            if (learned_[idx].compare_exchange_strong(cur, mine, std::memory_order_acq_rel))
+            {
+                learnedCount_.fetch_add(1, std::memory_order_relaxed);
+                return mine;
+            }
+        }
+        if (*cur == (mine ? *mine : tmpl))
+        {
+            delete mine;
+            return cur;
+        }
+    }
+    delete mine;
+    return nullptr;
+}
+
+std::string RouteNormalizer::normalize(std::string_view path) const
+{
+    size_t q = path.find('?');
+    if (q != std::string_view::npos)
+        path = path.substr(0, q);
+    if (path.empty())
+        return "/";
+
+    const Trie *trie = trie_.load(std::memory_order_acquire);
+    int r = trie->match(0, path, 0);
+    if (r >= 0)
+        return trie->templates[r];
+
+    std::string tmpl;
+    tmpl.reserve(path.size());
+    forEachSegment(path, [&](std::string_view seg, size_t)
+                   {
+        std::string_view ph = classifySegment(seg);
+        tmpl.push_back('/');
+        tmpl.append(ph.empty() ? seg : ph);
+        return true; });
+    if (tmpl.empty())
+        tmpl = "/";
+
+    if (!learned_)
+        return tmpl;
+    const std::string *known = learn(std::move(tmpl));
+    return known ? *known : cfg_.overflowTemplate;
+}
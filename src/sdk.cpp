@@ -1,11 +1,201 @@
 #include "traffic_processor/sdk.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
+#include "traffic_processor/record_view.hpp"
 
 using namespace traffic_processor;
 
+static std::string encodeBase64(const std::string &in)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve(((in.size() + 2) / 3) * 4);
+    size_t i = 0;
+    for (; i + 2 < in.size(); i += 3)
+    {
+        uint32_t n = (static_cast<unsigned char>(in[i]) << 16) | (static_cast<unsigned char>(in[i + 1]) << 8) | static_cast<unsigned char>(in[i + 2]);
+        out.push_back(table[(n >> 18) & 63]);
+        out.push_back(table[(n >> 12) & 63]);
+        out.push_back(table[(n >> 6) & 63]);
+        out.push_back(table[n & 63]);
+    }
+    if (i < in.size())
+    {
+        uint32_t n = static_cast<unsigned char>(in[i]) << 16;
+        if (i + 1 < in.size())
+            n |= static_cast<unsigned char>(in[i + 1]) << 8;
+        out.push_back(table[(n >> 18) & 63]);
+        out.push_back(table[(n >> 12) & 63]);
+        out.push_back(i + 1 < in.size() ? table[(n >> 6) & 63] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+// Per-thread xorshift64*; sampling and record ids must not touch shared state
+static uint64_t nextRandom()
+{
+    thread_local uint64_t state = ((static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}() ^
+                                   static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())) |
+                                  1;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+static bool sampled(double rate)
+{
+    if (rate >= 1.0)
+        return true;
+    if (rate <= 0.0)
+        return false;
+    return static_cast<double>(nextRandom() >> 11) * 0x1.0p-53 < rate;
+}
+
+// 32 hex digits: random bits and the wall clock in nanoseconds
+static std::string newRecordId()
+{
+    BodyHash id;
+    id.hi = nextRandom();
+    id.lo = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    return id.hex();
+}
+
+const TopicRule *traffic_processor::matchTopicRule(const std::vector<TopicRule> &rules, const nlohmann::json &record)
+{
+    if (rules.empty())
+        return nullptr;
+    int status = 0;
+    std::string_view route, method;
+    if (auto res = record.find("response"); res != record.end() && res->is_object())
+    {
+        if (auto st = res->find("status"); st != res->end() && st->is_number_integer())
+            status = st->get<int>();
+    }
+    if (auto req = record.find("request"); req != record.end() && req->is_object())
+    {
+        for (const char *key : {"route_template", "path"})
+        {
+            auto it = req->find(key);
+            if (route.empty() && it != req->end() && it->is_string())
+                route = it->get_ref<const std::string &>();
+        }
+        if (auto m = req->find("method"); m != req->end() && m->is_string())
+            method = m->get_ref<const std::string &>();
+    }
+
+    for (const auto &rule : rules)
+    {
+        if (status < rule.minStatus || status > rule.maxStatus)
+            continue;
+        if (!rule.routePrefix.empty() && route.substr(0, rule.routePrefix.size()) != rule.routePrefix)
+            continue;
+        if (!rule.methods.empty() && std::find(rule.methods.begin(), rule.methods.end(), method) == rule.methods.end())
+            continue;
+        return &rule;
+    }
+    return nullptr;
+}
+
+RecordHeaders traffic_processor::recordHeaders(const nlohmann::json &record, char (&statusBuffer)[12])
+{
+    auto text = [](const nlohmann::json &object, const char *key)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_string() ? std::string_view(it->get_ref<const std::string &>()) : std::string_view();
+    };
+    static const nlohmann::json empty = nlohmann::json::object();
+    auto req = record.find("request");
+    auto res = record.find("response");
+    const nlohmann::json &request = req != record.end() && req->is_object() ? *req : empty;
+    const nlohmann::json &response = res != record.end() && res->is_object() ? *res : empty;
+
+    RecordHeaders h;
+    h.accountId = text(record, "account_id");
+    h.method = text(request, "method");
+    h.host = text(request, "host");
+    h.route = text(request, "route_template");
+    if (h.route.empty())
+        h.route = text(request, "path");
+    if (auto st = response.find("status"); st != response.end() && st->is_number_integer())
+    {
+        auto [end, ec] = std::to_chars(statusBuffer, statusBuffer + sizeof(statusBuffer), st->get<int>());
+        if (ec == std::errc())
+            h.status = std::string_view(statusBuffer, static_cast<size_t>(end - statusBuffer));
+    }
+    h.schemaVersion = record_headers::CurrentSchemaVersion;
+    h.contentEncoding = record_headers::Json;
+    return h;
+}
+
+nlohmann::json traffic_processor::splitRecordBodies(nlohmann::json &record, const std::string &recordId)
+{
+    using nlohmann::json;
+    json bodies{{"record_id", recordId}, {"account_id", record["account_id"]}, {"timestamp", record["timestamp"]}};
+    bool any = false;
+    for (const char *name : {"request", "response"})
+    {
+        auto section = record.find(name);
+        if (section == record.end() || !section->is_object())
+            continue;
+        json &out = bodies[name] = json::object();
+        for (const char *key : {"body", "body_b64", "body_truncated", "body_ref"})
+        {
+            auto it = section->find(key);
+            if (it == section->end())
+                continue;
+            any |= it->is_string() && !it->get_ref<const std::string &>().empty();
+            out[key] = std::move(*it);
+            section->erase(it);
+        }
+    }
+    return any ? bodies : json();
+}
+
+void traffic_processor::setRecordBody(nlohmann::json &section, const std::string &text, const std::string &b64,
+                                      bool captured, size_t maxBytes)
+{
+    if (!captured)
+    {
+        section["body"] = "";
+        section["body_b64"] = "";
+    }
+    else if (maxBytes != 0 && text.size() > maxBytes)
+    {
+        std::string truncated = text.substr(0, maxBytes);
+        section["body_b64"] = encodeBase64(truncated);
+        section["body"] = std::move(truncated);
+        section["body_truncated"] = true;
+    }
+    else
+    {
+        section["body"] = text;
+        section["body_b64"] = b64.empty() && !text.empty() ? encodeBase64(text) : b64;
+    }
+}
+
+// Masks secrets directly inside the record being built; when the body
+// changed, body_b64 is re-encoded so the raw value does not leak through it.
+// Fields left out of the record's schema are skipped.
+static void redactSection(const Redactor &redactor, nlohmann::json &section)
+{
+    if (auto headers = section.find("headers"); headers != section.end())
+        redactor.redactHeaders(*headers);
+    auto body = section.find("body");
+    if (body != section.end() && body->is_string() && redactor.redactBody(body->get_ref<std::string &>()))
+    {
+        section["body_b64"] = encodeBase64(body->get_ref<const std::string &>());
+    }
+}
+
 TrafficProcessorSdk &TrafficProcessorSdk::instance()
 {
     static TrafficProcessorSdk sdk;
@@ -20,8 +210,90 @@ void TrafficProcessorSdk::initialize()
 
 void TrafficProcessorSdk::initialize(const SdkConfig &config)
 {
+    std::unique_lock<std::mutex> lock(reconfigMutex_);
     cfg_ = config;
-    producer_ = std::make_unique<KafkaProducer>(cfg_.kafka);
+    {
+        std::lock_guard<std::mutex> shutdownLock(shutdownMutex_);
+        shutdownDone_ = false;
+        lastReport_ = ShutdownReport{};
+        retiredCounters_ = DeliveryCounters{};
+    }
+    redactor_ = Redactor(cfg_.redaction);
+    extractor_ = BodyExtractor(cfg_.extraction);
+    if (cfg_.routes.enabled)
+    {
+        RouteConfig routeCfg = cfg_.routes;
+        routeCfg.routes.insert(routeCfg.routes.end(), registeredRoutes_.begin(), registeredRoutes_.end());
+        routes_ = std::make_unique<RouteNormalizer>(routeCfg);
+    }
+
+    policies_.push_back(std::make_unique<const CapturePolicy>(cfg_.policy));
+    policy_.store(policies_.back().get(), std::memory_order_release);
+
+    if (cfg_.producerPool && cfg_.adaptiveBatching.enabled)
+    {
+        std::cerr << "Adaptive batching needs a producer of its own; disabled with a pooled producer" << std::endl;
+        cfg_.adaptiveBatching.enabled = false;
+    }
+    if (cfg_.adaptiveBatching.enabled && cfg_.kafka.statisticsIntervalMs <= 0)
+    {
+        cfg_.kafka.statisticsIntervalMs = cfg_.adaptiveBatching.evaluationIntervalMs;
+    }
+
+    if (cfg_.analytics.enabled && !analytics_)
+    {
+        analytics_ = std::make_unique<TrafficAnalytics>(cfg_.analytics);
+        analytics_->start();
+    }
+
+    if (cfg_.bodyDedup.enabled && !bodyDedup_)
+    {
+        bodyDedup_ = std::make_shared<BodyDeduplicator>(cfg_.bodyDedup);
+    }
+
+    if (!cfg_.columnar.path.empty())
+    {
+        std::lock_guard<std::mutex> columnarLock(columnarMutex_);
+        if (!columnar_)
+        {
+            columnar_ = std::make_unique<ColumnarExporter>(cfg_.columnar);
+        }
+    }
+
+    if (leasedProducer_)
+        pool_->release(std::move(leasedProducer_));
+    pool_ = cfg_.producerPool;
+    if (pool_)
+    {
+        leasedProducer_ = pool_->acquire(cfg_.kafka);
+        leaseBaseline_ = leasedProducer_->counters();
+        producer_.store(leasedProducer_.get(), std::memory_order_seq_cst);
+    }
+    else
+    {
+        ownedProducer_ = std::make_unique<KafkaProducer>(cfg_.kafka);
+        producer_.store(ownedProducer_.get(), std::memory_order_seq_cst);
+    }
+
+    if (cfg_.adaptiveBatching.enabled && !maintenance_.joinable())
+    {
+        batching_ = std::make_unique<BatchController>(cfg_.adaptiveBatching, cfg_.kafka.lingerMs, cfg_.kafka.batchNumMessages);
+        maintenanceStop_ = false;
+        maintenance_ = std::thread([this]
+                                   { maintenanceLoop(); });
+    }
+
+    accepting_.store(true, std::memory_order_relaxed);
+    lock.unlock();
+
+    // After the config lock is released: the watcher applies the file
+    // before start() returns, through reconfigure(), which takes it
+    if (!cfg_.runtimeConfigPath.empty())
+    {
+        watcher_ = std::make_unique<PolicyWatcher>(cfg_.runtimeConfigPath, [this](const nlohmann::json &doc)
+                                                   { reconfigure(doc); });
+        watcher_->start();
+    }
 }
 
 TrafficProcessorSdk::~TrafficProcessorSdk()
@@ -29,15 +301,410 @@ TrafficProcessorSdk::~TrafficProcessorSdk()
     shutdown();
 }
 
-void TrafficProcessorSdk::shutdown()
+nlohmann::json ShutdownReport::toJson() const
+{
+    return nlohmann::json{
+        {"delivered", delivered},
+        {"spilled", spilled},
+        {"dropped", dropped},
+        {"columnar_dropped", columnarDropped},
+        {"elapsed_ms", elapsed.count()},
+        {"deadline_exceeded", deadlineExceeded},
+    };
+}
+
+void TrafficProcessorSdk::requestShutdown() noexcept
+{
+    accepting_.store(false, std::memory_order_relaxed);
+}
+
+// Adds the counts of a producer since `since` was taken
+static void addCounters(ShutdownReport &report, const DeliveryCounters &c, const DeliveryCounters &since = {})
+{
+    report.delivered += c.delivered - since.delivered;
+    report.spilled += c.spilled - since.spilled;
+    report.dropped += (c.failed - since.failed) + (c.enqueueFailed - since.enqueueFailed) + (c.purged - since.purged);
+}
+
+ShutdownReport TrafficProcessorSdk::shutdown()
 {
+    return shutdown(std::chrono::milliseconds(cfg_.shutdownTimeoutMs));
+}
+
+ShutdownReport TrafficProcessorSdk::shutdown(std::chrono::milliseconds deadline)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto until = start + deadline;
+    accepting_.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> shutdownLock(shutdownMutex_);
+    if (shutdownDone_)
+        return lastReport_;
+
+    if (maintenance_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(maintenanceMutex_);
+            maintenanceStop_ = true;
+        }
+        maintenanceCv_.notify_all();
+        maintenance_.join();
+    }
+    if (watcher_)
+    {
+        watcher_->stop();
+    }
+    if (analytics_)
+    {
+        analytics_->stop();
+    }
+    // Detached first so captures racing shutdown do not wait for the
+    // export thread to finish writing
+    std::unique_ptr<ColumnarExporter> columnar;
+    {
+        std::lock_guard<std::mutex> lock(columnarMutex_);
+        columnar = std::move(columnar_);
+    }
+    uint64_t columnarDropped = 0;
+    if (columnar)
+    {
+        try
+        {
+            columnar->close();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Shutdown: columnar export failed: " << e.what() << std::endl;
+        }
+        columnarDropped = columnar->dropped();
+        columnar.reset();
+    }
+
+    // Detach every producer; captures already past the intake check finish
+    // on the producer they loaded, so wait for them before draining.
+    std::vector<std::unique_ptr<KafkaProducer>> producers;
+    std::shared_ptr<KafkaProducer> lease;
+    ShutdownReport report;
+    report.columnarDropped = columnarDropped;
+    {
+        std::lock_guard<std::mutex> swapLock(producerSwapMutex_);
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        producer_.store(nullptr, std::memory_order_seq_cst);
+        if (ownedProducer_)
+            producers.push_back(std::move(ownedProducer_));
+        for (auto &p : retiredProducers_)
+            producers.push_back(std::move(p));
+        retiredProducers_.clear();
+        lease = std::move(leasedProducer_);
+        addCounters(report, retiredCounters_);
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+    bool quiescent = epochs_.synchronize(std::max(remaining, std::chrono::milliseconds(0)));
+
+    // A pooled producer keeps serving the other instances leasing it, so it
+    // is only flushed; whoever releases it last drains it like an own one
+    std::shared_ptr<KafkaProducer> lastLease;
+    if (lease && quiescent)
+    {
+        if (lease.use_count() > 1)
+        {
+            remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+            lease->flush(static_cast<int>(std::max<int64_t>(remaining.count(), 0)));
+            report.deadlineExceeded |= lease->queueLength() > 0;
+        }
+        DeliveryCounters c = lease->counters();
+        lastLease = pool_->release(std::move(lease));
+        if (!lastLease)
+            addCounters(report, c, leaseBaseline_);
+    }
+    else if (lease)
+    {
+        std::cerr << "Shutdown: captures still in flight, keeping the pooled producer leased" << std::endl;
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        leasedProducer_ = std::move(lease);
+    }
+    std::vector<KafkaProducer *> draining;
+    for (auto &p : producers)
+        draining.push_back(p.get());
+    if (lastLease)
+        draining.push_back(lastLease.get());
+
+    std::FILE *spill = nullptr;
+    if (!cfg_.spillPath.empty())
+    {
+        spill = std::fopen(cfg_.spillPath.c_str(), "ab");
+        if (!spill)
+            std::cerr << "Shutdown: cannot open spill file " << cfg_.spillPath << std::endl;
+    }
+
+    // Drain all producers concurrently against the same deadline
+    std::vector<int> leftover(draining.size(), 0);
+    std::vector<std::thread> drains;
+    for (size_t i = 0; i < draining.size(); ++i)
+    {
+        drains.emplace_back([&, i]
+                            { leftover[i] = draining[i]->drain(until, spill); });
+    }
+    for (auto &t : drains)
+        t.join();
+    if (spill)
+        std::fclose(spill);
+
+    for (size_t i = 0; i < draining.size(); ++i)
+    {
+        addCounters(report, draining[i]->counters(), draining[i] == lastLease.get() ? leaseBaseline_ : DeliveryCounters{});
+        report.deadlineExceeded |= leftover[i] > 0;
+    }
+    lastLease.reset();
+
+    if (quiescent)
+    {
+        producers.clear(); // queues are empty: destruction does not block
+    }
+    else
+    {
+        std::cerr << "Shutdown: captures still in flight, keeping producers alive" << std::endl;
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        for (auto &p : producers)
+            retiredProducers_.push_back(std::move(p));
+    }
+
+    report.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    lastReport_ = report;
+    shutdownDone_ = true;
+    return report;
+}
+
+void TrafficProcessorSdk::reconfigure(const nlohmann::json &changes)
+{
+    CapturePolicy policy = currentPolicy();
+    KafkaConfig kafka;
+    bool pooled;
+    {
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        kafka = cfg_.kafka;
+        pooled = pool_ != nullptr;
+    }
+
+    // Validate everything before applying anything
+    bool policyChanged = applyPolicyJson(policy, changes);
+    bool producerChanged = applyKafkaJson(kafka, changes);
+    if (producerChanged && pooled)
+        throw std::invalid_argument("'kafka' settings cannot change on a pooled producer");
+
+    if (policyChanged)
+        updatePolicy(policy);
+    if (producerChanged)
+    {
+        reconfigureProducer(kafka);
+    }
+}
+
+void TrafficProcessorSdk::updatePolicy(const CapturePolicy &policy)
+{
+    std::vector<std::unique_ptr<const CapturePolicy>> retired;
+    {
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        cfg_.policy = policy;
+        policies_.push_back(std::make_unique<const CapturePolicy>(policy));
+        policy_.store(policies_.back().get(), std::memory_order_seq_cst);
+        retired.assign(std::make_move_iterator(policies_.begin()), std::make_move_iterator(policies_.end() - 1));
+        policies_.erase(policies_.begin(), policies_.end() - 1);
+    }
+
+    // Captures read the policy inside an epoch guard; once they have all
+    // left, no one can still hold a replaced snapshot
+    if (epochs_.synchronize(std::chrono::seconds(1)))
+        return;
+    std::lock_guard<std::mutex> lock(reconfigMutex_);
+    policies_.insert(policies_.begin(), std::make_move_iterator(retired.begin()), std::make_move_iterator(retired.end()));
+}
+
+CapturePolicy TrafficProcessorSdk::currentPolicy() const
+{
+    std::lock_guard<std::mutex> lock(reconfigMutex_);
+    return cfg_.policy;
+}
+
+void TrafficProcessorSdk::reconfigureProducer(const KafkaConfig &kafka)
+{
+    // Held until the old producer is settled, so that shutdown() cannot
+    // detach the producers while one is in neither place
+    std::lock_guard<std::mutex> swapLock(producerSwapMutex_);
+    std::unique_ptr<KafkaProducer> old;
+    {
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        if (!accepting_.load(std::memory_order_relaxed))
+            throw std::runtime_error("SDK is shut down or shutting down");
+        if (pool_)
+            throw std::runtime_error("Producer settings of a pooled producer are fixed");
+
+        // Build first: if the new configuration is rejected the old producer stays
+        auto next = std::make_unique<KafkaProducer>(kafka);
+        producer_.store(next.get(), std::memory_order_seq_cst);
+        old = std::move(ownedProducer_);
+        ownedProducer_ = std::move(next);
+        cfg_.kafka = kafka;
+        if (batching_)
+        {
+            std::lock_guard<std::mutex> batchingLock(batchingMutex_);
+            batching_->producerRecreated(kafka.lingerMs, kafka.batchNumMessages, BatchController::Clock::now());
+        }
+    }
+    if (!old)
+        return;
+
+    // Drain-and-swap, outside the config lock so policy updates and reads
+    // do not wait on it: once no capture can still be inside old->send(),
+    // flush it, fold its delivery counters into the totals and destroy it.
+    // A producer that cannot empty its queue is kept so that shutdown()
+    // drains or spills it rather than losing its records here.
+    if (!epochs_.synchronize(std::chrono::seconds(1)))
+    {
+        std::cerr << "Producer swap: readers still active, deferring old producer teardown" << std::endl;
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        retiredProducers_.push_back(std::move(old));
+    }
+    else
+    {
+        old->flush(old->config().closeFlushTimeoutMs);
+        std::lock_guard<std::mutex> lock(reconfigMutex_);
+        if (old->queueLength() > 0)
+        {
+            std::cerr << "Producer swap: old producer still has " << old->queueLength() << " queued messages, retiring it" << std::endl;
+            retiredProducers_.push_back(std::move(old));
+            return;
+        }
+        DeliveryCounters c = old->counters();
+        retiredCounters_.delivered += c.delivered;
+        retiredCounters_.failed += c.failed;
+        retiredCounters_.enqueueFailed += c.enqueueFailed;
+        retiredCounters_.spilled += c.spilled;
+        retiredCounters_.purged += c.purged;
+    }
+}
+
+nlohmann::json TrafficProcessorSdk::runtimeConfig() const
+{
+    std::lock_guard<std::mutex> lock(reconfigMutex_);
+    nlohmann::json doc = policyToJson(cfg_.policy);
+    doc["kafka"] = {
+        {"linger_ms", cfg_.kafka.lingerMs},
+        {"batch_num_messages", cfg_.kafka.batchNumMessages},
+        {"batch_size_bytes", cfg_.kafka.batchSizeBytes},
+        {"queue_buffering_max_messages", cfg_.kafka.queueBufferingMaxMessages},
+        {"queue_buffering_max_kbytes", cfg_.kafka.queueBufferingMaxKbytes},
+        {"compression", cfg_.kafka.compression},
+        {"acks", cfg_.kafka.acks},
+        {"retries", cfg_.kafka.retries},
+        {"request_timeout_ms", cfg_.kafka.requestTimeoutMs},
+    };
+    return doc;
+}
+
+void TrafficProcessorSdk::registerRoute(std::string_view pattern)
+{
+    registeredRoutes_.emplace_back(pattern);
+    if (routes_)
+    {
+        routes_->addRoute(pattern);
+    }
+}
+
+nlohmann::json TrafficProcessorSdk::batchingMetrics() const
+{
+    std::lock_guard<std::mutex> lock(batchingMutex_);
+    return batching_ ? batching_->metrics().toJson() : nlohmann::json::object();
+}
+
+nlohmann::json TrafficProcessorSdk::analyticsSnapshot() const
+{
+    return analytics_ ? analytics_->latest().toJson() : nlohmann::json::object();
+}
+
+void TrafficProcessorSdk::maintenanceLoop()
+{
+    using Clock = BatchController::Clock;
+    const auto interval = std::chrono::milliseconds(std::max(10, cfg_.adaptiveBatching.evaluationIntervalMs));
+    auto nextEval = Clock::now() + interval;
+    int64_t lastTs = 0;
+    int64_t lastCount = 0;
+    BatchDecision decision;
+
+    std::unique_lock<std::mutex> lock(maintenanceMutex_);
+    while (!maintenanceStop_)
+    {
+        auto wake = nextEval;
+        if (decision.flushEarly)
+            wake = std::min(wake, Clock::now() + std::chrono::milliseconds(decision.lingerMs));
+        if (maintenanceCv_.wait_until(lock, wake, [this]
+                                      { return maintenanceStop_; }))
+            break;
+        lock.unlock();
+
+        ProducerStats st;
+        KafkaConfig kafka;
+        {
+            EpochDomain::Guard guard(epochs_);
+            if (KafkaProducer *producer = producer_.load(std::memory_order_seq_cst))
+            {
+                if (decision.flushEarly)
+                    producer->expedite();
+                st = producer->stats();
+                kafka = producer->config();
+            }
+        }
+
+        auto now = Clock::now();
+        if (now >= nextEval)
+        {
+            nextEval = now + interval;
+            int64_t count = st.txMessages + st.queuedMessages;
+            if (st.timestampUs > lastTs && lastTs > 0 && count >= lastCount)
+            {
+                BatchSample sample;
+                sample.arrivalRate = static_cast<double>(count - lastCount) * 1e6 / static_cast<double>(st.timestampUs - lastTs);
+                sample.avgBatchFill = st.avgBatchCount;
+                sample.deliveryLatencyMs = st.intLatencyMs + st.rttMs;
+                sample.rttMs = st.rttMs;
+                {
+                    std::lock_guard<std::mutex> batchingLock(batchingMutex_);
+                    decision = batching_->update(sample, now);
+                }
+                if (decision.recreateProducer)
+                {
+                    kafka.lingerMs = decision.lingerMs;
+                    kafka.batchNumMessages = decision.batchNumMessages;
+                    try
+                    {
+                        reconfigureProducer(kafka);
+                        count = 0; // fresh producer, fresh counters
+                        st.timestampUs = 0;
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::cerr << "Adaptive batching: producer recreation failed: " << e.what() << std::endl;
+                    }
+                    decision.flushEarly = false;
+                }
+            }
+            lastTs = st.timestampUs;
+            lastCount = count;
+        }
+        lock.lock();
+    }
 }
 
 void TrafficProcessorSdk::printKafkaStats()
 {
-    if (producer_)
+    EpochDomain::Guard guard(epochs_);
+    if (KafkaProducer *producer = producer_.load(std::memory_order_seq_cst))
     {
-        producer_->printStats();
+        producer->printStats();
+        if (batching_)
+        {
+            std::cout << "Adaptive batching: " << batchingMetrics().dump() << std::endl;
+        }
     }
     else
     {
@@ -47,44 +714,154 @@ void TrafficProcessorSdk::printKafkaStats()
 
 void TrafficProcessorSdk::capture(const RequestData &req, const ResponseData &res)
 {
-    using nlohmann::json;
-    json j;
-    j["account_id"] = cfg_.accountId;
-    j["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(
-                         std::chrono::system_clock::now().time_since_epoch())
-                         .count();
+    capture<fields::All>(req, res);
+}
 
-    json r;
-    r["method"] = req.method;
-    r["scheme"] = req.scheme;
-    r["host"] = req.host;
-    r["path"] = req.path;
-    r["query"] = req.query;
-    r["headers"] = req.headers;
-    r["body"] = req.bodyText;
-    r["body_b64"] = req.bodyBase64;
-    r["ip"] = req.ip;
+DeliveryFuture TrafficProcessorSdk::captureAsync(const RequestData &req, const ResponseData &res)
+{
+    return captureAsync<fields::All>(req, res);
+}
 
-    json s;
-    s["status"] = res.status;
-    s["headers"] = res.headers;
-    s["body"] = res.bodyText;
-    s["body_b64"] = res.bodyBase64;
+const CapturePolicy *TrafficProcessorSdk::admit(const RequestData &req, const ResponseData &res, std::string *route)
+{
+    if (!accepting_.load(std::memory_order_relaxed))
+        return nullptr;
+    const CapturePolicy *policy = policy_.load(std::memory_order_seq_cst);
+    // Analytics sees every request, the record only sampled ones
+    bool unnormalized = req.routeTemplate.empty() && routes_;
+    std::string_view path = std::string_view(req.path).substr(0, req.path.find('?'));
+    std::string normalized;
+    if (analytics_)
+    {
+        if (unnormalized)
+            normalized = routes_->normalize(path);
+        unnormalized = false;
+        analytics_->observe(req, res, normalized);
+    }
+    if (!policy || !sampled(policy->sampleRate))
+        return nullptr;
+    if (route)
+        *route = unnormalized ? routes_->normalize(path) : std::move(normalized);
+    return policy;
+}
 
-    j["request"] = r;
-    j["response"] = s;
+void TrafficProcessorSdk::emit(nlohmann::json &j, DeliveryState *delivery)
+{
+    using nlohmann::json;
+    if (redactor_.enabled())
+    {
+        redactSection(redactor_, j["request"]);
+        redactSection(redactor_, j["response"]);
+    }
+    // After redaction, so masked values stay masked in the extracted fields
+    if (extractor_.enabled())
+        extractor_.apply(j);
 
-    // latency
-    if (req.startNs != 0 && res.endNs != 0 && res.endNs > req.startNs)
+    std::string serialized;
+
+    if (!cfg_.columnar.path.empty())
     {
-        uint64_t deltaNs = res.endNs - req.startNs;
-        j["latency_ms"] = static_cast<int>(deltaNs / 1'000'000);
+        // The export thread decodes the row from the serialized record so
+        // the export holds what Kafka receives after redaction and body
+        // limits, but with full bodies: segments are not resolved against
+        // the body topic
+        serialized = j.dump();
+        std::string exported = serialized;
+        std::lock_guard<std::mutex> lock(columnarMutex_);
+        if (columnar_)
+            columnar_->offer(std::move(exported));
     }
 
-    std::string serialized = j.dump();
+    // Body messages are emitted before the record referencing them
+    std::string bodyMessages[2];
+    bool referenced = false;
+    if (bodyDedup_)
+    {
+        const char *sections[2] = {"request", "response"};
+        for (int i = 0; i < 2; ++i)
+        {
+            json &section = j[sections[i]];
+            bodyDedup_->apply(section, bodyMessages[i]);
+            referenced |= section.contains("body_ref");
+        }
+    }
+    const RoutingConfig &routing = cfg_.routing;
+    std::string recordId, bodyRecord;
+    if (routing.splitBodies)
+    {
+        recordId = newRecordId();
+        json bodies = splitRecordBodies(j, recordId);
+        j["record_id"] = recordId;
+        if (!bodies.is_null())
+        {
+            bodyRecord = bodies.dump(-1, ' ', false, json::error_handler_t::replace);
+            j["body_topic"] = routing.bodyTopic;
+        }
+        serialized = j.dump();
+    }
+    else if (serialized.empty() || referenced)
+        serialized = j.dump();
+    const TopicRule *rule = matchTopicRule(routing.rules, j);
+    char statusBuffer[12];
+    const RecordHeaders headers = recordHeaders(j, statusBuffer);
 
-    if (producer_)
+    EpochDomain::Guard guard(epochs_);
+    KafkaProducer *producer = producer_.load(std::memory_order_seq_cst);
+    if (bodyDedup_)
+    {
+        const BodyDedupConfig &dedup = bodyDedup_->config();
+        for (int i = 0; i < 2; ++i)
+        {
+            if (bodyMessages[i].empty())
+                continue;
+            const std::string &ref = j[i == 0 ? "request" : "response"]["body_ref"].get_ref<const std::string &>();
+            BodyHash hash;
+            BodyHash::parse(ref, hash);
+            if (dedup.sink)
+            {
+                try
+                {
+                    dedup.sink(ref, bodyMessages[i]);
+                }
+                catch (const std::exception &e)
+                {
+                    // Shipped again on its next occurrence
+                    std::cerr << "Body sink failed: " << e.what() << std::endl;
+                    bodyDedup_->forget(hash);
+                }
+            }
+            else if (producer)
+            {
+                // Likewise when Kafka does not take it; a pooled producer
+                // may report that after this instance is gone
+                producer->sendSide(bodyMessages[i], dedup.topic, ref,
+                                   [weak = std::weak_ptr<BodyDeduplicator>(bodyDedup_), hash]
+                                   {
+                                       if (auto d = weak.lock())
+                                           d->forget(hash);
+                                   });
+            }
+        }
+    }
+    if (delivery)
+        delivery->expect(bodyRecord.empty() ? 1 : 2);
+    if (producer)
+    {
+        using Kind = KafkaProducer::MessageKind;
+        // Both halves of a split capture are keyed by record id, so they
+        // land on the same partition number of equally partitioned topics
+        if (!bodyRecord.empty())
+            producer->send(bodyRecord, routing.bodyTopic, recordId, Kind::Record, delivery, &headers);
+        if (rule)
+            producer->send(serialized, rule->topic, recordId, Kind::Record, delivery, &headers);
+        else if (!recordId.empty())
+            producer->send(serialized, producer->config().topic, recordId, Kind::Record, delivery, &headers);
+        else
+            producer->send(serialized, delivery, &headers);
+    }
+    else if (delivery)
     {
-        producer_->send(serialized);
+        for (int i = bodyRecord.empty() ? 1 : 2; i > 0; --i)
+            delivery->settle(DeliveryStatus::Dropped);
     }
 }
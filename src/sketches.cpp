@@ -0,0 +1,388 @@
+#include "traffic_processor/sketches.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace traffic_processor;
+
+namespace
+{
+    constexpr uint64_t kGolden = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t mixWord(uint64_t w)
+    {
+        w *= 0x87C37B91114253D5ULL;
+        w = std::rotl(w, 31);
+        return w * 0x4CF5AD432745937FULL;
+    }
+
+    uint64_t finalize(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        return h ^ (h >> 33);
+    }
+}
+
+uint64_t traffic_processor::hash64(std::string_view data, uint64_t seed)
+{
+    uint64_t h = seed ^ (data.size() * kGolden);
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, data.data() + i, 8);
+        h = std::rotl(h ^ mixWord(w), 27) * 5 + 0x52DCE729;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data.data() + i, data.size() - i);
+    return finalize(h ^ mixWord(tail));
+}
+
+// ---------------------------------------------------------------- Count-Min
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth)
+    : width_(std::bit_ceil(std::max<size_t>(width, 16))), depth_(std::max<size_t>(depth, 1)),
+      counters_(width_ * depth_, 0)
+{
+}
+
+size_t CountMinSketch::slot(uint64_t hash, size_t row) const
+{
+    // Double hashing: row i probes h1 + i*h2, with h2 odd
+    uint64_t h1 = hash;
+    uint64_t h2 = (hash >> 32 | hash << 32) | 1;
+    return row * width_ + ((h1 + row * h2) & (width_ - 1));
+}
+
+void CountMinSketch::add(uint64_t hash, uint64_t count)
+{
+    total_ += count;
+    uint64_t least = UINT64_MAX;
+    for (size_t r = 0; r < depth_; ++r)
+        least = std::min(least, counters_[slot(hash, r)]);
+    // Conservative update: raise only the counters that would underestimate
+    uint64_t target = least + count;
+    for (size_t r = 0; r < depth_; ++r)
+    {
+        uint64_t &c = counters_[slot(hash, r)];
+        c = std::max(c, target);
+    }
+}
+
+uint64_t CountMinSketch::estimate(uint64_t hash) const
+{
+    uint64_t least = UINT64_MAX;
+    for (size_t r = 0; r < depth_; ++r)
+        least = std::min(least, counters_[slot(hash, r)]);
+    return least;
+}
+
+void CountMinSketch::merge(const CountMinSketch &other)
+{
+    if (other.width_ != width_ || other.depth_ != depth_)
+        throw std::invalid_argument("Count-Min sketches differ in dimensions");
+    for (size_t i = 0; i < counters_.size(); ++i)
+        counters_[i] += other.counters_[i];
+    total_ += other.total_;
+}
+
+// ------------------------------------------------------------ Heavy hitters
+
+HeavyHitters::HeavyHitters(size_t capacity, size_t width, size_t depth)
+    : sketch_(width, depth), capacity_(std::max<size_t>(capacity, 1))
+{
+    candidates_.reserve(capacity_ + 1);
+}
+
+void HeavyHitters::evictMin()
+{
+    auto victim = candidates_.begin();
+    for (auto it = candidates_.begin(); it != candidates_.end(); ++it)
+    {
+        if (it->second < victim->second)
+            victim = it;
+    }
+    candidates_.erase(victim);
+    minCount_ = UINT64_MAX;
+    for (const auto &c : candidates_)
+        minCount_ = std::min(minCount_, c.second);
+}
+
+void HeavyHitters::add(std::string_view key, uint64_t count)
+{
+    uint64_t h = hash64(key);
+    sketch_.add(h, count);
+    uint64_t est = sketch_.estimate(h);
+
+    auto it = candidates_.find(key);
+    if (it != candidates_.end())
+    {
+        bool wasMin = it->second == minCount_;
+        it->second = est;
+        if (wasMin && candidates_.size() >= capacity_)
+        {
+            minCount_ = UINT64_MAX;
+            for (const auto &c : candidates_)
+                minCount_ = std::min(minCount_, c.second);
+        }
+        return;
+    }
+    if (candidates_.size() < capacity_)
+    {
+        candidates_.emplace(key, est);
+        if (candidates_.size() == capacity_)
+        {
+            minCount_ = UINT64_MAX;
+            for (const auto &c : candidates_)
+                minCount_ = std::min(minCount_, c.second);
+        }
+        return;
+    }
+    // Full: the common case is a key that is not heavy, decided with one compare
+    if (est <= minCount_)
+        return;
+    candidates_.emplace(key, est);
+    evictMin();
+}
+
+void HeavyHitters::merge(const HeavyHitters &other)
+{
+    sketch_.merge(other.sketch_);
+    for (const auto &c : other.candidates_)
+        candidates_.emplace(c.first, 0);
+    for (auto &c : candidates_)
+        c.second = sketch_.estimate(hash64(c.first));
+    while (candidates_.size() > capacity_)
+        evictMin();
+    minCount_ = UINT64_MAX;
+    for (const auto &c : candidates_)
+        minCount_ = std::min(minCount_, c.second);
+}
+
+std::vector<HeavyHitter> HeavyHitters::top(size_t n) const
+{
+    std::vector<HeavyHitter> out;
+    out.reserve(candidates_.size());
+    for (const auto &c : candidates_)
+        out.push_back({c.first, c.second});
+    std::sort(out.begin(), out.end(), [](const HeavyHitter &a, const HeavyHitter &b)
+              { return a.count != b.count ? a.count > b.count : a.key < b.key; });
+    if (out.size() > n)
+        out.resize(n);
+    return out;
+}
+
+// -------------------------------------------------------------- HyperLogLog
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision_(std::clamp(precision, 4, 18)), registers_(size_t{1} << precision_, 0)
+{
+}
+
+void HyperLogLog::add(uint64_t hash)
+{
+    size_t index = hash >> (64 - precision_);
+    // The guard bit bounds the rank when the remaining bits are all zero
+    uint64_t rest = (hash << precision_) | (uint64_t{1} << (precision_ - 1));
+    uint8_t rank = static_cast<uint8_t>(std::countl_zero(rest) + 1);
+    if (rank > registers_[index])
+        registers_[index] = rank;
+}
+
+uint64_t HyperLogLog::estimate() const
+{
+    const double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_)
+    {
+        sum += std::ldexp(1.0, -r);
+        zeros += r == 0;
+    }
+    double alpha = registers_.size() == 16 ? 0.673 : registers_.size() == 32 ? 0.697
+                                                 : registers_.size() == 64   ? 0.709
+                                                                             : 0.7213 / (1 + 1.079 / m);
+    double e = alpha * m * m / sum;
+    // Small cardinalities: linear counting is more accurate
+    if (e <= 2.5 * m && zeros > 0)
+        e = m * std::log(m / static_cast<double>(zeros));
+    return static_cast<uint64_t>(std::llround(e));
+}
+
+void HyperLogLog::merge(const HyperLogLog &other)
+{
+    if (other.precision_ != precision_)
+        throw std::invalid_argument("HyperLogLog sketches differ in precision");
+    for (size_t i = 0; i < registers_.size(); ++i)
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+}
+
+// ------------------------------------------------------------------ t-digest
+
+TDigest::TDigest(double compression)
+    : compression_(std::max(compression, 10.0))
+{
+}
+
+void TDigest::add(double value, double weight)
+{
+    if (!(weight > 0) || std::isnan(value))
+        return;
+    if (count() == 0)
+    {
+        min_ = value;
+        max_ = value;
+    }
+    else
+    {
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+    buffer_.push_back({value, weight});
+    if (buffer_.size() >= static_cast<size_t>(compression_) * 5)
+        compress();
+}
+
+double TDigest::count() const
+{
+    double w = weight_;
+    for (const auto &c : buffer_)
+        w += c.weight;
+    return w;
+}
+
+void TDigest::compress() const
+{
+    if (buffer_.empty())
+        return;
+    buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+    std::sort(buffer_.begin(), buffer_.end(), [](const Centroid &a, const Centroid &b)
+              { return a.mean < b.mean; });
+    double total = 0;
+    for (const auto &c : buffer_)
+        total += c.weight;
+
+    // Arcsine scale: k(q) = d/(2*pi) * asin(2q - 1); a centroid may span at
+    // most one unit of k, which keeps centroids near the tails small
+    const double pi = 3.14159265358979323846;
+    auto k = [&](double q)
+    { return compression_ / (2 * pi) * std::asin(2 * q - 1); };
+    auto kInv = [&](double kv)
+    { return (std::sin(std::min(kv * 2 * pi / compression_, pi / 2)) + 1) / 2; };
+
+    std::vector<Centroid> out;
+    out.reserve(static_cast<size_t>(compression_) + 8);
+    Centroid cur = buffer_.front();
+    double before = 0;
+    double limit = kInv(k(0) + 1) * total;
+    for (size_t i = 1; i < buffer_.size(); ++i)
+    {
+        const Centroid &next = buffer_[i];
+        if (before + cur.weight + next.weight <= limit)
+        {
+            cur.mean += (next.mean - cur.mean) * next.weight / (cur.weight + next.weight);
+            cur.weight += next.weight;
+        }
+        else
+        {
+            before += cur.weight;
+            out.push_back(cur);
+            limit = kInv(k(before / total) + 1) * total;
+            cur = next;
+        }
+    }
+    out.push_back(cur);
+    centroids_.swap(out);
+    buffer_.clear();
+    weight_ = total;
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    if (other.count() == 0)
+        return;
+    if (count() == 0)
+    {
+        min_ = other.min_;
+        max_ = other.max_;
+    }
+    else
+    {
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+    buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+    buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+    compress();
+}
+
+double TDigest::quantile(double q) const
+{
+    compress();
+    if (centroids_.empty())
+        return 0;
+    if (centroids_.size() == 1)
+        return centroids_.front().mean;
+    q = std::clamp(q, 0.0, 1.0);
+    const double target = q * weight_;
+
+    // Interpolate between centroid centres; the ends interpolate to min/max
+    const Centroid &first = centroids_.front();
+    if (target < first.weight / 2)
+        return min_ + (first.mean - min_) * target / (first.weight / 2);
+    double cumulative = first.weight / 2; // position of the current centre
+    for (size_t i = 0; i + 1 < centroids_.size(); ++i)
+    {
+        const Centroid &a = centroids_[i];
+        const Centroid &b = centroids_[i + 1];
+        double gap = (a.weight + b.weight) / 2;
+        if (target < cumulative + gap)
+            return a.mean + (b.mean - a.mean) * (target - cumulative) / gap;
+        cumulative += gap;
+    }
+    const Centroid &last = centroids_.back();
+    double tail = weight_ - cumulative;
+    return tail > 0 ? last.mean + (max_ - last.mean) * std::min(1.0, (target - cumulative) / tail) : last.mean;
+}
+
+// -------------------------------------------------------------------- bursts
+
+EwmaBurstDetector::EwmaBurstDetector(double smoothing, double threshold, double minCount, int warmupWindows)
+    : smoothing_(std::clamp(smoothing, 0.01, 1.0)), threshold_(threshold), minCount_(minCount),
+      warmupWindows_(std::max(warmupWindows, 1))
+{
+}
+
+double EwmaBurstDetector::stddev() const
+{
+    return std::max(std::sqrt(variance_), std::sqrt(std::max(mean_, 1.0)));
+}
+
+bool EwmaBurstDetector::update(double value)
+{
+    bool burst = false;
+    if (windows_ == 0)
+    {
+        mean_ = value;
+        variance_ = 0;
+        score_ = 0;
+    }
+    else
+    {
+        score_ = (value - mean_) / stddev();
+        burst = windows_ >= warmupWindows_ && value >= minCount_ && score_ >= threshold_;
+        // Incremental EWMA of mean and variance
+        double diff = value - mean_;
+        double step = smoothing_ * diff;
+        mean_ += step;
+        variance_ = (1 - smoothing_) * (variance_ + diff * step);
+    }
+    ++windows_;
+    return burst;
+}
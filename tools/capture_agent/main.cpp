@@ -0,0 +1,136 @@
+#include "traffic_processor/packet_capture.hpp"
+#include "traffic_processor/sdk.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace traffic_processor;
+
+// Passive capture agent: sniffs HTTP/1.1 traffic of services that do not
+// link the SDK and feeds it through the same capture() pipeline.
+//
+//   capture_agent --interface eth0 --port 8080 --workers 4
+//   capture_agent --pcap traffic.pcap --port 80
+
+static std::atomic<PacketCapture *> activeCapture{nullptr};
+
+static void onSignal(int)
+{
+    if (PacketCapture *capture = activeCapture.load())
+        capture->stop();
+}
+
+static void usage()
+{
+    std::cerr << "usage: capture_agent (--interface IF | --pcap FILE) [--port N]... [--workers N]\n"
+              << "                     [--fanout-group N] [--max-body BYTES]\n"
+              << "Kafka and SDK settings come from the same environment variables as the examples\n"
+              << "(KAFKA_URL, KAFKA_TOPIC, TRAFFIC_RUNTIME_CONFIG, TRAFFIC_SPILL_PATH)." << std::endl;
+}
+
+static SdkConfig buildConfigFromEnv()
+{
+    SdkConfig cfg;
+    cfg.accountId = "capture-agent";
+    if (const char *url = std::getenv("KAFKA_URL"))
+    {
+        cfg.kafka.bootstrapServers = url;
+    }
+    if (const char *topic = std::getenv("KAFKA_TOPIC"))
+    {
+        cfg.kafka.topic = topic;
+    }
+    if (const char *path = std::getenv("TRAFFIC_RUNTIME_CONFIG"))
+    {
+        cfg.runtimeConfigPath = path;
+    }
+    if (const char *spill = std::getenv("TRAFFIC_SPILL_PATH"))
+    {
+        cfg.spillPath = spill;
+    }
+    return cfg;
+}
+
+int main(int argc, char **argv)
+{
+    CaptureConfig capture;
+    bool portsGiven = false;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                    throw std::invalid_argument("missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--interface" || arg == "-i")
+                capture.interface = value();
+            else if (arg == "--pcap" || arg == "-r")
+                capture.pcapPath = value();
+            else if (arg == "--port" || arg == "-p")
+            {
+                if (!portsGiven)
+                    capture.tracker.ports.clear();
+                portsGiven = true;
+                capture.tracker.ports.push_back(static_cast<uint16_t>(std::stoi(value())));
+            }
+            else if (arg == "--workers")
+                capture.workers = std::stoi(value());
+            else if (arg == "--fanout-group")
+                capture.fanoutGroup = static_cast<uint16_t>(std::stoi(value()));
+            else if (arg == "--max-body")
+                capture.tracker.maxBodyBytes = std::stoul(value());
+            else
+            {
+                usage();
+                return arg == "--help" || arg == "-h" ? 0 : 2;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid arguments: " << e.what() << std::endl;
+        usage();
+        return 2;
+    }
+    if (capture.interface.empty() && capture.pcapPath.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    auto &sdk = TrafficProcessorSdk::instance();
+    sdk.initialize(buildConfigFromEnv());
+
+    PacketCapture sniffer(capture, [&sdk](const RequestData &req, const ResponseData &res)
+                          { sdk.capture(req, res); });
+    activeCapture = &sniffer;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    int rc = 0;
+    try
+    {
+        std::cout << "Capturing from " << (capture.pcapPath.empty() ? capture.interface : capture.pcapPath)
+                  << " with " << capture.workers << " worker(s)" << std::endl;
+        sniffer.run();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Capture failed: " << e.what() << std::endl;
+        rc = 1;
+    }
+    activeCapture = nullptr;
+
+    std::cout << "Capture stats: " << sniffer.stats().dump() << std::endl;
+    ShutdownReport report = sdk.shutdown();
+    std::cout << "Shutdown report: " << report.toJson().dump() << std::endl;
+    return rc;
+}